@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "mutils/utils.h"
+
+// Pairwise binary_gcd against batch_gcd on random 64 bit values without
+// factors below 1000, a few of which share a planted factor, across set
+// sizes and thread counts.
+//
+// Usage: bench_batch_gcd [largest n] [max threads]
+int main(int argc, char* argv[])
+{
+  const size_t largest = argc > 1 ? static_cast<size_t>(std::atoll(argv[1])) : 100000;
+  unsigned int maxThreads = argc > 2
+    ? static_cast<unsigned int>(std::atoi(argv[2]))
+    : mutils::ThreadPool::default_threads();
+  const size_t pairwiseMax = 10000;
+
+  std::printf("%-12s %8s %8s %12s %10s\n", "algorithm", "n", "threads", "seconds", "shared");
+  std::mt19937_64 rng(7);
+  const std::vector<int> small = mutils::prime_table(1000);
+  auto rough = [&](int bits) {
+    while (true) {
+      unsigned long long value = (rng() >> (64 - bits)) | 1;
+      if (std::none_of(small.begin(), small.end(), [value](int p) { return value % (unsigned long long)p == 0; })) { return value; }
+    }
+  };
+
+  for (size_t n = 1000; n <= largest; n *= 10) {
+    std::vector<unsigned long long> values(n);
+    for (auto& value : values) { value = rough(64); }
+    for (size_t i = 0; i + 1 < n; i += n / 10) {
+      const unsigned long long planted = rough(24);
+      values[i] = planted * rough(40);
+      values[i + 1] = planted * rough(40);
+    }
+
+    if (n <= pairwiseMax) {
+      auto start = std::chrono::steady_clock::now();
+      size_t shared = 0;
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          if (i != j && mutils::binary_gcd(values[i], values[j]) > 1) { ++shared; break; }
+        }
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::printf("%-12s %8zu %8d %12.3f %10zu\n", "pairwise", n, 1, elapsed.count(), shared);
+    }
+
+    // Powers of two, then maxThreads itself
+    for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+      auto start = std::chrono::steady_clock::now();
+      std::vector<unsigned long long> gcds = mutils::batch_gcd(values, threads);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      size_t shared = static_cast<size_t>(std::count_if(gcds.begin(), gcds.end(),
+                                                        [](unsigned long long g) { return g > 1; }));
+      std::printf("%-12s %8zu %8u %12.3f %10zu\n", "batch_gcd", n, threads, elapsed.count(), shared);
+      if (threads >= maxThreads) { break; }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mutils/utils.h"
+
+// Serial Bell triangle against the parallel Bell triangle and Stirling rows
+// across thread counts.
+//
+// Usage: bench_bell [n] [max threads]
+int main(int argc, char* argv[])
+{
+  int n = argc > 1 ? std::atoi(argv[1]) : 2000;
+  unsigned int maxThreads = argc > 2
+    ? static_cast<unsigned int>(std::atoi(argv[2]))
+    : mutils::ThreadPool::default_threads();
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<BigInt> serial = mutils::bell_numbers(n);
+  std::chrono::duration<double> baseline = std::chrono::steady_clock::now() - start;
+
+  std::printf("Bell numbers B(0..%d), B(n) has %zu digits\n\n", n, serial.back().digit_count());
+  std::printf("%-22s %8s %12s %10s\n", "algorithm", "threads", "seconds", "speedup");
+  std::printf("%-22s %8d %12.3f %10.2f\n", "bell_numbers", 1, baseline.count(), 1.0);
+
+  // Powers of two, then maxThreads itself
+  for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+    start = std::chrono::steady_clock::now();
+    std::vector<BigInt> bells = mutils::bell_numbers_parallel(n, threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-22s %8u %12.3f %10.2f%s\n", "bell_numbers_parallel", threads, elapsed.count(),
+                baseline.count() / elapsed.count(), bells == serial ? "" : "  MISMATCH");
+
+    start = std::chrono::steady_clock::now();
+    std::vector<BigInt> row = mutils::stirling2_row(n, threads);
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-22s %8u %12.3f %10.2f\n", "stirling2_row", threads, elapsed.count(),
+                baseline.count() / elapsed.count());
+
+    if (threads >= maxThreads) { break; }
+  }
+
+  return 0;
+}
@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mutils/utils.h"
+
+// Serial prime swing factorial against the parallel factorial and the
+// parallel product tree over [2, n] across thread counts.
+//
+// Usage: bench_factorial [n] [max threads]
+int main(int argc, char* argv[])
+{
+  int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  unsigned int maxThreads = argc > 2
+    ? static_cast<unsigned int>(std::atoi(argv[2]))
+    : std::max(mutils::ThreadPool::default_threads(), 16u);
+
+  auto start = std::chrono::steady_clock::now();
+  BigInt serial = mutils::factorial_prime_swing(n);
+  std::chrono::duration<double> baseline = std::chrono::steady_clock::now() - start;
+
+  std::printf("%d! has %zu digits, %u hardware threads\n\n", n, serial.digit_count(),
+              mutils::ThreadPool::default_threads());
+  std::printf("%-24s %8s %12s %10s\n", "algorithm", "threads", "seconds", "speedup");
+  std::printf("%-24s %8d %12.3f %10.2f\n", "factorial_prime_swing", 1, baseline.count(), 1.0);
+
+  // Powers of two, then maxThreads itself
+  for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+    start = std::chrono::steady_clock::now();
+    BigInt res = mutils::factorial_parallel(n, threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-24s %8u %12.3f %10.2f%s\n", "factorial_parallel", threads, elapsed.count(),
+                baseline.count() / elapsed.count(), res == serial ? "" : "  MISMATCH");
+
+    start = std::chrono::steady_clock::now();
+    res = mutils::parallel_product_range(2, static_cast<unsigned long long>(n), threads);
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-24s %8u %12.3f %10.2f%s\n", "parallel_product_range", threads, elapsed.count(),
+                baseline.count() / elapsed.count(), res == serial ? "" : "  MISMATCH");
+
+    if (threads >= maxThreads) { break; }
+  }
+
+  return 0;
+}
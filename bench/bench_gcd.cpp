@@ -0,0 +1,95 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mutils/utils.h"
+
+namespace {
+  // The recursive gcd this library shipped before, kept as the baseline
+  int recursive_gcd(int a, int b)
+  {
+    int big = a > b ? a : b;
+    int small = a > b ? b : a;
+    int remainder = big % small;
+    if (remainder == 0) { return small; }
+    return recursive_gcd(small, remainder);
+  }
+
+  BigInt euclid_gcd(BigInt a, BigInt b)
+  {
+    BigInt q, r;
+    while (!b.is_zero()) {
+      BigInt::divmod(a, b, q, r);
+      a = std::move(b);
+      b = std::move(r);
+    }
+    return a;
+  }
+
+  BigInt random_bigint(std::mt19937_64& rng, int digits)
+  {
+    std::string str(1, static_cast<char>('1' + rng() % 9));
+    for (int i = 1; i < digits; ++i) { str += static_cast<char>('0' + rng() % 10); }
+    return BigInt(str);
+  }
+
+  template<typename F>
+    double seconds(F body)
+    {
+      auto start = std::chrono::steady_clock::now();
+      body();
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+// Native gcds over random pairs and BigInt gcds over random operands of
+// growing size.
+//
+// Usage: bench_gcd [pairs]
+int main(int argc, char* argv[])
+{
+  const int pairs = argc > 1 ? std::atoi(argv[1]) : 2000000;
+  std::mt19937_64 rng(42);
+
+  std::vector<int> small(2 * (size_t)pairs);
+  for (auto& value : small) { value = static_cast<int>(rng() % 2147483647u) + 1; }
+  std::vector<unsigned long long> wide(2 * (size_t)pairs);
+  for (auto& value : wide) { value = rng() | 1; }
+
+  std::printf("%d random pairs\n\n", pairs);
+  std::printf("%-26s %12s %14s\n", "algorithm", "seconds", "ns per gcd");
+
+  unsigned long long check = 0;
+  double t = seconds([&] {
+    for (size_t i = 0; i < (size_t)pairs; ++i) { check += (unsigned long long)recursive_gcd(small[2 * i], small[2 * i + 1]); }
+  });
+  std::printf("%-26s %12.3f %14.1f\n", "recursive gcd (31 bit)", t, 1e9 * t / pairs);
+
+  t = seconds([&] {
+    for (size_t i = 0; i < (size_t)pairs; ++i) { check -= (unsigned long long)mutils::gcd(small[2 * i], small[2 * i + 1], false); }
+  });
+  std::printf("%-26s %12.3f %14.1f\n", "gcd (31 bit)", t, 1e9 * t / pairs);
+
+  t = seconds([&] {
+    for (size_t i = 0; i < (size_t)pairs; ++i) { check += mutils::binary_gcd(wide[2 * i], wide[2 * i + 1]); }
+  });
+  std::printf("%-26s %12.3f %14.1f\n", "binary_gcd (64 bit)", t, 1e9 * t / pairs);
+
+  std::printf("\n%-26s %8s %12s %10s\n", "algorithm", "digits", "seconds", "speedup");
+  for (int digits : {100, 1000, 10000, 50000}) {
+    BigInt a = random_bigint(rng, digits);
+    BigInt b = random_bigint(rng, digits);
+    BigInt expected, res;
+    double baseline = seconds([&] { expected = euclid_gcd(a, b); });
+    std::printf("%-26s %8d %12.3f %10.2f\n", "Euclid (divmod)", digits, baseline, 1.0);
+    t = seconds([&] { res = mutils::lehmer_gcd(a, b); });
+    std::printf("%-26s %8d %12.3f %10.2f%s\n", "lehmer_gcd", digits, t, baseline / t,
+                res == expected ? "" : "  MISMATCH");
+  }
+
+  // Keeps the native loops from being optimized away
+  return check == 42 ? 1 : 0;
+}
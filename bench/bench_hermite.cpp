@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "mutils/utils.h"
+
+namespace {
+  // Whether matrix * x equals expected
+  bool multiplies_to(const std::vector<std::vector<long long>>& matrix, const std::vector<BigInt>& x,
+                     const std::vector<long long>& expected)
+  {
+    for (size_t i = 0; i < matrix.size(); ++i) {
+      BigInt sum(0);
+      for (size_t j = 0; j < x.size(); ++j) {
+        if (matrix[i][j] != 0) { sum += x[j] * BigInt(matrix[i][j]); }
+      }
+      if (sum != BigInt(expected[i])) { return false; }
+    }
+    return true;
+  }
+}
+
+// HermiteNormalForm on random dense (entries in [-9, 9]) and sparse (about
+// four non-zero entries per row) m x 5m/4 systems with a planted solution,
+// timing the reduction and one solve, with the largest entry of x and of
+// the kernel basis in digits. Checks Ax = b and Ak = 0 for every kernel
+// vector k, exits with 1 on the first system that fails.
+//
+// Usage: bench_hermite [largest m]
+int main(int argc, char* argv[])
+{
+  const size_t largest = argc > 1 ? static_cast<size_t>(std::atoll(argv[1])) : 400;
+
+  std::printf("%-8s %6s %6s %6s %12s %12s %10s %10s\n",
+              "matrix", "rows", "cols", "rank", "reduce", "solve", "x digits", "ker digits");
+  std::mt19937_64 rng(11);
+  auto entry = [&]() { return static_cast<long long>(rng() % 19) - 9; };
+
+  for (size_t rows = 25; rows <= largest; rows *= 2) {
+    const size_t cols = rows + rows / 4;
+    for (bool dense : {true, false}) {
+      std::vector<std::vector<long long>> matrix(rows, std::vector<long long>(cols));
+      for (auto& row : matrix) {
+        if (dense) {
+          for (auto& value : row) { value = entry(); }
+        } else {
+          for (int k = 0; k < 4; ++k) {
+            const size_t col = rng() % cols;
+            row[col] = entry();
+          }
+        }
+      }
+
+      // b = A x for a small x, so the system is solvable
+      std::vector<long long> planted(cols), rhs(rows);
+      for (auto& value : planted) { value = entry(); }
+      for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) { rhs[i] += matrix[i][j] * planted[j]; }
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      mutils::HermiteNormalForm hnf(matrix);
+      std::chrono::duration<double> reduced = std::chrono::steady_clock::now() - start;
+
+      start = std::chrono::steady_clock::now();
+      std::vector<BigInt> solution;
+      bool solved = hnf.solve(rhs, solution);
+      std::chrono::duration<double> solving = std::chrono::steady_clock::now() - start;
+
+      const std::vector<std::vector<BigInt>> kernel = hnf.kernel();
+      size_t xDigits = 0, kernelDigits = 0;
+      for (const BigInt& value : solution) { xDigits = std::max(xDigits, value.digit_count()); }
+      for (const auto& vec : kernel) {
+        for (const BigInt& value : vec) { kernelDigits = std::max(kernelDigits, value.digit_count()); }
+      }
+
+      std::printf("%-8s %6zu %6zu %6zu %12.3f %12.3f %10zu %10zu\n",
+                  dense ? "dense" : "sparse", rows, cols, hnf.rank(), reduced.count(),
+                  solving.count(), xDigits, kernelDigits);
+
+      const char* failure = nullptr;
+      if (!solved) {
+        failure = "no solution found for a solvable system";
+      } else if (!multiplies_to(matrix, solution, rhs)) {
+        failure = "A x != b";
+      } else if (kernel.size() != cols - hnf.rank()) {
+        failure = "kernel basis of the wrong size";
+      }
+      for (const auto& vec : kernel) {
+        if (failure == nullptr && !multiplies_to(matrix, vec, std::vector<long long>(rows))) {
+          failure = "A k != 0 for a kernel vector k";
+        }
+      }
+      if (failure != nullptr) {
+        std::printf("\n%s\n", failure);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mutils/utils.h"
+
+// Scaling of the parallel partition enumeration across thread counts, each
+// count checked against partitions_count, then partitions_hrr checked against
+// the pentagonal recurrence for every m up to hrr bound (0 skips it). Exits
+// with 1 on the first disagreement.
+//
+// Usage: bench_partitions [n] [max threads] [hrr bound]
+int main(int argc, char* argv[])
+{
+  int n = argc > 1 ? std::atoi(argv[1]) : 100;
+  unsigned int maxThreads = argc > 2
+    ? static_cast<unsigned int>(std::atoi(argv[2]))
+    : mutils::ThreadPool::default_threads();
+  int hrrBound = argc > 3 ? std::atoi(argv[3]) : 20000;
+
+  const BigInt expected = mutils::partitions_count(n);
+  std::printf("Parallel partition enumeration, n = %d, p(n) = %s\n\n",
+              n, expected.to_string().c_str());
+  std::printf("%8s %12s %10s %16s\n", "threads", "seconds", "speedup", "partitions/s");
+
+  double baseline = 0.0;
+  // Powers of two, then maxThreads itself
+  for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+    auto start = std::chrono::steady_clock::now();
+    unsigned long long count = mutils::partitions_parallel_count(n, threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (threads == 1) { baseline = elapsed.count(); }
+    std::printf("%8u %12.3f %10.2f %16.3e\n", threads, elapsed.count(),
+                baseline / elapsed.count(), static_cast<double>(count) / elapsed.count());
+    if (BigInt(count) != expected) {
+      std::printf("\n%u threads counted %llu partitions, p(%d) = %s\n",
+                  threads, count, n, expected.to_string().c_str());
+      return 1;
+    }
+
+    if (threads >= maxThreads) { break; }
+  }
+
+  if (hrrBound > 0) {
+    auto start = std::chrono::steady_clock::now();
+    int mismatch = mutils::verify_partitions_hrr(hrrBound, maxThreads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (mismatch >= 0) {
+      std::printf("\npartitions_hrr(%d) disagrees with the recurrence\n", mismatch);
+      return 1;
+    }
+    std::printf("\npartitions_hrr agrees with the recurrence up to n = %d (%.3f s)\n",
+                hrrBound, elapsed.count());
+  }
+
+  return 0;
+}
@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mutils/bigint_view.h"
+#include "mutils/utils.h"
+
+// Every allocation of the process is counted, the suite reports the counts
+// per operation next to the time
+namespace {
+  std::atomic<unsigned long long> allocations{0};
+  std::atomic<unsigned long long> allocated{0};
+}
+
+void* operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated.fetch_add(size, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) { return p; }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+
+namespace {
+  struct Result {
+    std::string group;
+    std::string name;
+    long long param;
+    unsigned long long iterations;
+    double ns;       // per operation
+    double allocs;   // per operation
+    double bytes;    // allocated per operation
+    double items;    // per operation, numbers sieved or values in a batch, 0 if none
+  };
+
+  /**
+   * Suite class that times operations and keeps the results for the report.
+   * An operation runs once to warm up and, unless that took minTime already,
+   * then as many times as fit in minTime.
+   */
+  class Suite {
+    private:
+      double _minTime;
+      const char* _filter;
+      std::vector<Result> _results;
+
+      static double now()
+      {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+    public:
+      Suite(double minTime, const char* filter) : _minTime(minTime), _filter(filter), _results() {}
+      Suite(const Suite&) = delete;
+      Suite& operator=(const Suite&) = delete;
+
+      bool wants(const char* group, const std::string& name) const
+      {
+        return _filter == nullptr || std::strstr(group, _filter) != nullptr ||
+          name.find(_filter) != std::string::npos;
+      }
+
+      // body() does ops operations of items items each
+      template<typename Body>
+        void run(const char* group, const std::string& name, long long param, Body body,
+                 size_t ops = 1, double items = 0)
+        {
+          if (!wants(group, name)) { return; }
+          std::fprintf(stderr, "%s/%s/%lld\n", group, name.c_str(), param);
+
+          unsigned long long calls = 1;
+          unsigned long long allocs = allocations.load();
+          unsigned long long bytes = allocated.load();
+          double start = now();
+          body();
+          double elapsed = now() - start;
+
+          if (elapsed < _minTime) {
+            calls = std::max(1ull, (unsigned long long)(_minTime / std::max(elapsed, 1e-9)));
+            calls = std::min(calls, 10000000ull);
+            allocs = allocations.load();
+            bytes = allocated.load();
+            start = now();
+            for (unsigned long long i = 0; i < calls; ++i) { body(); }
+            elapsed = now() - start;
+          }
+
+          const double count = (double)calls * (double)ops;
+          _results.push_back(Result{group, name, param, calls * ops, 1e9 * elapsed / count,
+                                    (double)(allocations.load() - allocs) / count,
+                                    (double)(allocated.load() - bytes) / count, items});
+        }
+
+      void report(std::FILE* out) const
+      {
+        std::fprintf(out, "{\"suite\":\"bench_suite\",\"min_time\":%g,\"results\":[", _minTime);
+        for (size_t i = 0; i < _results.size(); ++i) {
+          const Result& r = _results[i];
+          std::fprintf(out, "%s\n  {\"group\":\"%s\",\"name\":\"%s\",\"param\":%lld,\"iterations\":%llu,"
+                       "\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f",
+                       i == 0 ? "" : ",", r.group.c_str(), r.name.c_str(), r.param, r.iterations,
+                       r.ns, r.allocs, r.bytes);
+          if (r.items > 0) { std::fprintf(out, ",\"items_per_op\":%.0f", r.items); }
+          std::fputc('}', out);
+        }
+        std::fprintf(out, "\n]}\n");
+      }
+  };
+
+  // Results are folded in here so no call is optimized away
+  volatile size_t sink = 0;
+
+  void keep(const BigInt& value) { sink = sink + value.limbs().size(); }
+  void keep(size_t value) { sink = sink + value; }
+
+  BigInt random_bigint(std::mt19937_64& rng, size_t digits)
+  {
+    std::string str(1, static_cast<char>('1' + rng() % 9));
+    for (size_t i = 1; i < digits; ++i) { str += static_cast<char>('0' + rng() % 10); }
+    return BigInt(str);
+  }
+
+  bool is_prime(unsigned long long n)
+  {
+    return n > 1 && mutils::prime_factors(n).size() == 1;
+  }
+
+  unsigned long long random_prime(std::mt19937_64& rng, int bits)
+  {
+    while (true) {
+      unsigned long long candidate = (rng() >> (64 - bits)) | (1ull << (bits - 1)) | 1;
+      if (is_prime(candidate)) { return candidate; }
+    }
+  }
+
+  // Every operator of BigInt on operands of digits digits, the divisions
+  // divide 2 digits digits by digits digits and the power raises a digits / 16
+  // digit base to the 16th
+  void bench_bigint(Suite& suite, std::mt19937_64& rng, size_t digits)
+  {
+    const long long d = (long long)digits;
+    const BigInt a = random_bigint(rng, digits);
+    const BigInt b = random_bigint(rng, digits);
+    const BigInt wide = random_bigint(rng, 2 * digits);
+    const BigInt base = random_bigint(rng, std::max(digits / 16, (size_t)1));
+    const BigInt copy(a);
+    const std::string decimal = a.to_string();
+    std::string serialized;
+    a.serialize(serialized);
+
+    suite.run("bigint", "add", d, [&] { keep(a + b); });
+    suite.run("bigint", "subtract", d, [&] { keep(a - b); });
+    suite.run("bigint", "multiply", d, [&] { keep(a * b); });
+    suite.run("bigint", "square", d, [&] { keep(a * a); });
+    suite.run("bigint", "divide", d, [&] { keep(wide / a); });
+    suite.run("bigint", "modulo", d, [&] { keep(wide % a); });
+    suite.run("bigint", "divmod", d, [&] {
+      BigInt q, r;
+      BigInt::divmod(wide, a, q, r);
+      keep(q);
+    });
+    suite.run("bigint", "pow", d, [&] { keep(base ^ BigInt(16)); });
+    suite.run("bigint", "add_mul", d, [&] {
+      BigInt x(a);
+      keep(x.add_mul(b, 123456789));
+    });
+    suite.run("bigint", "mul_pow10", d, [&] {
+      BigInt x(a);
+      keep(x.mul_pow10(10));
+    });
+    suite.run("bigint", "div_pow10", d, [&] {
+      BigInt x(a);
+      keep(x.div_pow10(10));
+    });
+
+    BigInt counter(a);
+    suite.run("bigint", "increment", d, [&] { keep(++counter); });
+    suite.run("bigint", "decrement", d, [&] { keep(--counter); });
+    suite.run("bigint", "copy", d, [&] { keep(BigInt(a)); });
+    suite.run("bigint", "equal", d, [&] { keep((size_t)(a == copy)); });
+    suite.run("bigint", "less", d, [&] { keep((size_t)(a < b)); });
+    suite.run("bigint", "to_string", d, [&] { keep(a.to_string().size()); });
+    suite.run("bigint", "from_string", d, [&] { keep(BigInt(decimal)); });
+    suite.run("bigint", "serialize", d, [&] {
+      std::string out;
+      a.serialize(out);
+      keep(out.size());
+    });
+    suite.run("bigint", "deserialize", d, [&] {
+      BigInt x;
+      const char* data = serialized.data();
+      BigInt::deserialize(data, data + serialized.size(), x);
+      keep(x);
+    });
+
+    // The view reads serialized values in place, from a 4 byte aligned copy
+    // as SequenceCache::load() does
+    std::vector<uint32_t> aligned(serialized.size() / 4);
+    std::memcpy(aligned.data(), serialized.data(), serialized.size());
+    const char* const viewData = (const char*)aligned.data();
+    const BigIntView viewB(b);
+    suite.run("bigint_view", "view", d, [&] {
+      BigIntView view;
+      const char* data = viewData;
+      BigIntView::view(data, viewData + serialized.size(), view);
+      keep(view.size());
+    });
+    suite.run("bigint_view", "to_bigint", d, [&] {
+      BigIntView view;
+      const char* data = viewData;
+      BigIntView::view(data, viewData + serialized.size(), view);
+      keep(view.to_bigint());
+    });
+    suite.run("bigint_view", "less", d, [&] { keep((size_t)(BigIntView(a) < viewB)); });
+    suite.run("bigint_view", "add_into", d, [&] {
+      BigInt x(a);
+      viewB.add_into(x);
+      keep(x);
+    });
+    suite.run("bigint_view", "multiply_into", d, [&] {
+      BigInt x;
+      BigIntView::multiply_into(BigIntView(a), viewB, x);
+      keep(x);
+    });
+  }
+
+  void bench_sieve(Suite& suite, int maxSieve)
+  {
+    for (long long n = 1000; n <= maxSieve; n *= 10) {
+      suite.run("sieve", "prime_generator", n, [n] {
+        size_t count = 0;
+        mutils::PrimeGenerator((int)n).for_each([&count](int) { ++count; });
+        keep(count);
+      }, 1, (double)n);
+      suite.run("sieve", "prime_table", n, [n] { keep(mutils::prime_table((int)n).size()); }, 1, (double)n);
+      // Trial division by the primes so far, 10^6 alone takes seconds
+      if (n <= 100000) {
+        suite.run("sieve", "sieve_of_eratosthenes", n, [n] {
+          std::set<int> primes;
+          mutils::sieve_of_eratosthenes((int)n, primes, false);
+          keep(primes.size());
+        }, 1, (double)n);
+      }
+    }
+  }
+
+  // prime_factors over 256 inputs of each class, per input
+  void bench_factor(Suite& suite, std::mt19937_64& rng)
+  {
+    const size_t count = 256;
+    const unsigned long long smallPrimes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47};
+    std::vector<std::pair<const char*, std::vector<unsigned long long>>> classes;
+
+    std::vector<unsigned long long> inputs;
+    for (size_t i = 0; i < count; ++i) { inputs.push_back(rng() % (1u << 20) + 2); }
+    classes.emplace_back("small", inputs);
+
+    inputs.clear();
+    for (size_t i = 0; i < count; ++i) {
+      unsigned long long n = 1;
+      for (unsigned long long p = smallPrimes[rng() % 15]; n <= (1ull << 62) / p; p = smallPrimes[rng() % 15]) { n *= p; }
+      inputs.push_back(n);
+    }
+    classes.emplace_back("smooth", inputs);
+
+    inputs.clear();
+    for (size_t i = 0; i < count; ++i) { inputs.push_back(random_prime(rng, 63)); }
+    classes.emplace_back("prime", inputs);
+
+    inputs.clear();
+    for (size_t i = 0; i < count; ++i) { inputs.push_back(random_prime(rng, 31) * random_prime(rng, 31)); }
+    classes.emplace_back("semiprime", inputs);
+
+    inputs.clear();
+    for (size_t i = 0; i < count; ++i) { inputs.push_back(rng() | 1ull << 63); }
+    classes.emplace_back("random", inputs);
+
+    for (const auto& inputClass : classes) {
+      const std::vector<unsigned long long>& values = inputClass.second;
+      suite.run("factor", inputClass.first, (long long)values.size(), [&values] {
+        for (unsigned long long n : values) { keep(mutils::prime_factors(n).size()); }
+      }, values.size());
+    }
+  }
+
+  void bench_sequences(Suite& suite, int maxSequence)
+  {
+    for (int n = 100; n <= std::min(maxSequence, 1600); n *= 2) {
+      suite.run("sequence", "bell", n, [n] { keep(mutils::bell(n)); });
+      suite.run("sequence", "stirling2_row", n, [n] { keep(mutils::stirling2_row(n, 1).size()); });
+    }
+    for (int n = 100; n <= maxSequence; n *= 10) {
+      suite.run("sequence", "partitions_count", n, [n] { keep(mutils::partitions_count(n)); });
+      if (n <= 10000) {
+        suite.run("sequence", "partitions_table", n, [n] { keep(mutils::partitions_table(n).size()); });
+      }
+      suite.run("sequence", "factorial_prime_swing", n, [n] { keep(mutils::factorial_prime_swing(n)); });
+      suite.run("sequence", "factorial_product_tree", n, [n] { keep(mutils::factorial_product_tree(n)); });
+    }
+  }
+
+  void bench_gcd(Suite& suite, std::mt19937_64& rng, size_t maxDigits)
+  {
+    for (size_t count = 100; count <= 100000; count *= 10) {
+      std::vector<int> values(count);
+      for (int& value : values) { value = (int)(rng() % 1000000) + 1; }
+      std::vector<unsigned long long> wide(count);
+      for (auto& value : wide) { value = rng() | 1; }
+
+      const long long c = (long long)count;
+      suite.run("gcd", "gcd_of", c, [&values] { keep(mutils::gcd_of(values)); }, 1, (double)count);
+      suite.run("gcd", "lcm_of", c, [&values] { keep(mutils::lcm_of(values)); }, 1, (double)count);
+      suite.run("gcd", "binary_gcd", c, [&wide] {
+        unsigned long long g = 0;
+        for (size_t i = 0; i + 1 < wide.size(); i += 2) { g += mutils::binary_gcd(wide[i], wide[i + 1]); }
+        keep((size_t)g);
+      }, 1, (double)count);
+      // The product and remainder trees hold every value, 10^5 of them take half a minute
+      if (count <= 10000) {
+        suite.run("gcd", "batch_gcd", c, [&wide] { keep(mutils::batch_gcd(wide, 1).size()); }, 1, (double)count);
+      }
+    }
+
+    // Lehmer gcd is quadratic, 10^5 digits is already half a second
+    for (size_t digits = 10; digits <= std::min(maxDigits, (size_t)100000); digits *= 10) {
+      const BigInt a = random_bigint(rng, digits);
+      const BigInt b = random_bigint(rng, digits);
+      suite.run("gcd", "lehmer_gcd", (long long)digits, [&] { keep(mutils::lehmer_gcd(a, b)); });
+    }
+  }
+}
+
+// Microbenchmarks of every BigInt operator from 1 to 10^6 digits, the sieve
+// against n, factorization by input class, the Bell, partition and factorial
+// scaling and gcd/lcm batches, as JSON on stdout with the time, allocations
+// and bytes allocated per operation. Progress goes to stderr.
+//
+// Usage: bench_suite [--min-time seconds] [--max-digits d] [--max-sieve n]
+//                    [--max-sequence n] [--filter substring]
+int main(int argc, char* argv[])
+{
+  double minTime = 0.2;
+  size_t maxDigits = 1000000;
+  int maxSieve = 1000000000;
+  int maxSequence = 1000000;
+  const char* filter = nullptr;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--min-time") == 0) {
+      minTime = std::atof(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--max-digits") == 0) {
+      maxDigits = (size_t)std::atoll(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--max-sieve") == 0) {
+      maxSieve = std::atoi(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--max-sequence") == 0) {
+      maxSequence = std::atoi(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--filter") == 0) {
+      filter = argv[i + 1];
+    }
+  }
+
+  Suite suite(minTime, filter);
+  std::mt19937_64 rng(42);
+
+  for (size_t digits = 1; digits <= maxDigits; digits *= 10) { bench_bigint(suite, rng, digits); }
+  bench_sieve(suite, maxSieve);
+  bench_factor(suite, rng);
+  bench_sequences(suite, maxSequence);
+  bench_gcd(suite, rng, maxDigits);
+
+  suite.report(stdout);
+  return 0;
+}
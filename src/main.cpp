@@ -1,21 +1,31 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <map>
 #include <string>
 #include <vector>
 #include <set>
 #include <iostream>
 #include <iomanip>
-#include <windows.h>
 
 #include "mutils/utils.h"
+#include "mutils/batch.h"
+#include "mutils/console.h"
 #include "mutils/bigint.h"
+#include "mutils/instrument.h"
+#include "mutils/memory.h"
+#include "mutils/sequence_cache.h"
 
 
 void print_intro();
 void cls();
-void print_console_colors(); // For Windows
+void print_console_colors();
+int batch_mode(int argc, char* argv[]);
 
-int main()
+int main(int argc, char* argv[])
 {
+  if (argc > 1) { return batch_mode(argc, argv); }
+
   print_intro();
   std::cout << "Press enter to continue";
   mutils::prompt_input();
@@ -30,6 +40,7 @@ int main()
     DIVISORS,
     PRIME_FACTORS,
     FACTORIAL,
+    CRT,
   };
 
   std::map<int, std::string> opsName;
@@ -44,6 +55,7 @@ int main()
   opsName[Operations::DIVISORS] = "Divisors";
   opsName[Operations::PRIME_FACTORS] = "Prime Factors";
   opsName[Operations::FACTORIAL] = "Factorial n!";
+  opsName[Operations::CRT] = "Chinese Remainder Theorem x = a (mod m)";
 
   // Initialize all operations to false
   for (auto ops : opsName) { opsToggle[ops.first] = false; }
@@ -100,12 +112,16 @@ int main()
 
       std::set<int> primes;
       std::vector<int> integers;
+      std::vector<int> moduli;
+      std::vector<std::pair<long long, long long>> congruences;
       int first, second, third;
-      int gcd;
-      int lcm;
-      int parts;
-      BigInt partsBell;
+      long long gcd;
+      long long lcm;
+      unsigned long long parts;
+      BigInt partsCount;
+      std::vector<BigInt> bells;
       BigInt factorial;
+      BigInt solution, modulus;
 
       std::printf("\n[%2d] %s\n\n", pair.first, opsName[pair.first].c_str());
 
@@ -118,7 +134,7 @@ int main()
           mutils::sieve_of_eratosthenes(first, primes, true);
           std::cout << "\n\nAll primes:" << std::endl;
           mutils::print_set_by_column(primes, 10);
-          std::printf("\nTotal number of primes between (1, %d): %llu\n", first, primes.size());
+          std::printf("\nTotal number of primes between (1, %d): %llu\n", first, (unsigned long long)primes.size());
           break;
 
         case Operations::DIOPHANTINE:
@@ -133,37 +149,48 @@ int main()
         case Operations::PARTITIONS:
 
           first = mutils::prompt_int_input("Enter integer value of n: ");
-          std::cout << std::endl;
-          parts = mutils::partitions(first);
-          std::printf("\np(%d) = %d\n", first, parts);
+          if (mutils::prompt_confirm("List every partition? (y/N): ")) {
+            std::cout << std::endl;
+            parts = mutils::partitions(first);
+            std::printf("\np(%d) = %llu\n", first, parts);
+          } else {
+            partsCount = mutils::SequenceCache::global().partitions_count(first);
+            std::printf("\np(%d) = %s\n", first, partsCount.to_string().c_str());
+          }
           break;
 
         case Operations::PARTITIONS_BELL:
 
           first = mutils::prompt_int_input("Enter integer value of n: ");
           std::cout << std::endl;
+          bells = mutils::SequenceCache::global().bell_numbers(first);
           for (int i = 1; i <= first; ++i) {
-            partsBell = mutils::partitions_bell(i);
-            std::printf("p(%2d) = %s\n", i, partsBell.to_string().c_str());
+            std::printf("p(%2d) = %s\n", i, bells[(size_t)i].to_string().c_str());
           }
           break;
 
         case Operations::GCD:
 
-          first = mutils::prompt_int_input("Enter first integer: ");
-          second = mutils::prompt_int_input("Enter second integer: ");
+          integers = mutils::prompt_array_int_input("Enter integers separated by spaces: ");
           std::cout << std::endl;
-          gcd = mutils::gcd(first, second, true);
-          std::printf("\nGCD(%d, %d) = %d\n", first, second, gcd);
+          if (integers.size() == 2) {
+            gcd = mutils::gcd(integers[0], integers[1], true);
+            std::printf("\nGCD(%d, %d) = %lld\n", integers[0], integers[1], gcd);
+          } else {
+            std::printf("GCD = %llu\n", mutils::gcd_of(integers));
+          }
           break;
 
         case Operations::LCM:
 
-          first = mutils::prompt_int_input("Enter first integer: ");
-          second = mutils::prompt_int_input("Enter second integer: ");
+          integers = mutils::prompt_array_int_input("Enter integers separated by spaces: ");
           std::cout << std::endl;
-          lcm = mutils::lcm(first, second, true);
-          std::printf("\nLCM(%d, %d) = %d\n", first, second, lcm);
+          if (integers.size() == 2) {
+            lcm = mutils::lcm(integers[0], integers[1], true);
+            std::printf("\nLCM(%d, %d) = %lld\n", integers[0], integers[1], lcm);
+          } else {
+            std::printf("LCM = %s\n", mutils::lcm_of(integers).to_string().c_str());
+          }
           break;
 
         case Operations::DIVISORS:
@@ -187,9 +214,26 @@ int main()
         case Operations::FACTORIAL:
 
           first = mutils::prompt_int_input("Enter integer value of n: ");
-          factorial = mutils::factorial(first);
+          factorial = mutils::SequenceCache::global().factorial(first);
           std::cout << "Factorial of " << first << ": " << factorial << std::endl;
           break;
+
+        case Operations::CRT:
+
+          integers = mutils::prompt_array_int_input("Enter residues a separated by spaces: ");
+          moduli = mutils::prompt_array_int_input("Enter moduli m separated by spaces: ");
+          std::cout << std::endl;
+          if (integers.size() != moduli.size()) {
+            std::cout << "Expected one modulus per residue" << std::endl;
+            break;
+          }
+          for (size_t i = 0; i < integers.size(); ++i) { congruences.emplace_back(integers[i], moduli[i]); }
+          if (mutils::crt(congruences, solution, modulus)) {
+            std::printf("x = %s (mod %s)\n", solution.to_string().c_str(), modulus.to_string().c_str());
+          } else {
+            std::cout << "The congruences have NO SOLUTION" << std::endl;
+          }
+          break;
       }
     }
 
@@ -218,59 +262,124 @@ void print_intro()
 }
 
 
-// Clear screen, works for Windows and Unix
-// Ref: https://docs.microsoft.com/en-us/windows/console/clearing-the-screen
-void cls()
+// Non-interactive mode, answers the queries in a file or stdin a line each:
+//   pos_int_algo_sols --batch [--format text|json|binary] [--threads N] [--latency]
+//                     [--cache path] [--instrument text|json] [--memory-budget size]
+//                     [file]
+// --threads 0 uses every core, --latency logs "line seconds bytes" per query
+// and a summary to stderr. --cache loads the sequence cache from path if it
+// exists and saves it back at the end. --instrument writes the
+// mutils::instrument report to stderr at the end. --memory-budget limits the
+// BigInt memory of each query, e.g. 512M. See mutils::ResultWriter for the
+// formats.
+int batch_mode(int argc, char* argv[])
 {
-  HANDLE hConsole;
-  hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-
-  CONSOLE_SCREEN_BUFFER_INFO csbi;
-  SMALL_RECT scrollRect;
-  COORD scrollTarget;
-  CHAR_INFO fill;
+  mutils::BatchOptions options;
+  const char* path = nullptr;
+  const char* cachePath = nullptr;
+  const char* instrumentFormat = nullptr;
+  bool usage = std::strcmp(argv[1], "--batch") != 0;
+
+  for (int i = 2; i < argc && !usage; ++i) {
+    if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      char* end;
+      const long threads = std::strtol(argv[++i], &end, 10);
+      usage = *end != '\0' || threads < 0 || threads > 1024;
+      options.threads = (unsigned int)threads;
+    } else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      const char* format = argv[++i];
+      if (std::strcmp(format, "text") == 0) {
+        options.format = mutils::FORMAT_TEXT;
+      } else if (std::strcmp(format, "json") == 0) {
+        options.format = mutils::FORMAT_JSON_LINES;
+      } else if (std::strcmp(format, "binary") == 0) {
+        options.format = mutils::FORMAT_BINARY;
+      } else {
+        usage = true;
+      }
+    } else if (std::strcmp(argv[i], "--latency") == 0) {
+      options.latency = stderr;
+    } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      cachePath = argv[++i];
+    } else if (std::strcmp(argv[i], "--instrument") == 0 && i + 1 < argc) {
+      instrumentFormat = argv[++i];
+      usage = std::strcmp(instrumentFormat, "text") != 0 && std::strcmp(instrumentFormat, "json") != 0;
+    } else if (std::strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) {
+      usage = !mutils::memory::parse_size(argv[++i], options.memoryBudget);
+    } else if (!path) {
+      path = argv[i];
+    } else {
+      usage = true;
+    }
+  }
 
-  // Get the number of character cells in the current buffer.
-  if (!GetConsoleScreenBufferInfo(hConsole, &csbi)) {
-    return;
+  if (usage) {
+    std::fprintf(stderr, "Usage: %s [--batch [--format text|json|binary] [--threads N] [--latency]\n"
+                 "          [--cache path] [--instrument text|json] [--memory-budget size] [file]]\n\n"
+                 "Queries, one per line:\n%s",
+                 argv[0], mutils::batch_usage().c_str());
+    return 2;
   }
 
-  // Scroll the rectangle of the entire buffer.
-  scrollRect.Left = 0;
-  scrollRect.Top = 0;
-  scrollRect.Right = csbi.dwSize.X;
-  scrollRect.Bottom = csbi.dwSize.Y;
+  std::FILE* input = stdin;
+  if (path && std::strcmp(path, "-") != 0) {
+    input = std::fopen(path, "rb");
+    if (!input) {
+      std::perror(path);
+      return 1;
+    }
+  }
 
-  // Scroll it upwards off the top of the buffer with a magnitude of the entire height.
-  scrollTarget.X = 0;
-  scrollTarget.Y = (SHORT)(0 - csbi.dwSize.Y);
+  mutils::SequenceCache& cache = mutils::SequenceCache::global();
+  if (cachePath) {
+    std::FILE* existing = std::fopen(cachePath, "rb");
+    if (existing) {
+      std::fclose(existing);
+      if (!cache.load(cachePath)) { std::fprintf(stderr, "%s: not a sequence cache, ignored\n", cachePath); }
+    }
+  }
 
-  // Fill with empty spaces with the buffer's default text attribute.
-  fill.Char.UnicodeChar = TEXT(' ');
-  fill.Attributes = csbi.wAttributes;
+  const mutils::BatchStats stats = mutils::run_batch(input, stdout, options);
+  if (stats.readFailed) { std::fprintf(stderr, "%s: read error, the queries after it are unanswered\n", path ? path : "stdin"); }
+  if (input != stdin) { std::fclose(input); }
+
+  if (cachePath && !cache.save(cachePath)) { std::perror(cachePath); }
+
+  if (options.latency) {
+    std::fprintf(stderr, "%llu queries, %llu errors, %.6f s busy, mean %.9f s, slowest %.9f s\n",
+                 (unsigned long long)stats.queries, (unsigned long long)stats.errors, stats.busy,
+                 stats.queries ? stats.busy / (double)stats.queries : 0.0, stats.slowest);
+    const mutils::SequenceCache::Stats cached = cache.stats();
+    std::fprintf(stderr, "cache: %llu hits, %llu resumed, %llu misses, %llu bytes\n",
+                 (unsigned long long)cached.hits, (unsigned long long)cached.resumed,
+                 (unsigned long long)cached.misses, (unsigned long long)cache.bytes());
+    std::fprintf(stderr, "memory: peak query %llu bytes, peak RSS %llu bytes\n",
+                 (unsigned long long)stats.peak, (unsigned long long)mutils::memory::peak_rss());
+  }
 
-  // Do the scroll
-  ScrollConsoleScreenBuffer(hConsole, &scrollRect, NULL, scrollTarget, &fill);
+  if (instrumentFormat) {
+    std::string report;
+    mutils::instrument::report(report, std::strcmp(instrumentFormat, "json") == 0
+                               ? mutils::instrument::REPORT_JSON : mutils::instrument::REPORT_TEXT);
+    std::fwrite(report.data(), 1, report.size(), stderr);
+  }
+  return stats.errors == 0 && !stats.readFailed ? 0 : 1;
+}
 
-  // Move the cursor to the top left corner too.
-  csbi.dwCursorPosition.X = 0;
-  csbi.dwCursorPosition.Y = 0;
 
-  SetConsoleCursorPosition(hConsole, csbi.dwCursorPosition);
+// Clear screen, works for Windows and Unix
+void cls()
+{
+  mutils::console::clear();
 }
 
 
 void print_console_colors()
 {
-  HANDLE handle;
-  handle = GetStdHandle(STD_OUTPUT_HANDLE);
-
-  for (short unsigned int k = 0; k <= 255; ++k) {
+  for (unsigned int k = 0; k <= 255; ++k) {
     if (k % 10 == 1) { std::cout << std::endl; }
-    SetConsoleTextAttribute(handle, k);
+    mutils::console::set_color((unsigned char)k);
     std::cout << std::setw(10) << k;
   }
-  // Reset color to white
-  SetConsoleTextAttribute(handle, 15);
+  mutils::console::reset_color();
 }
-
@@ -0,0 +1,522 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "memory.h"
+#include "output.h"
+#include "sequence_cache.h"
+#include "utils.h"
+
+bool mutils::Token::equals(const char* word) const
+{
+  return std::strlen(word) == size && std::memcmp(word, data, size) == 0;
+}
+
+
+void mutils::tokenize(const char* begin, const char* end, std::vector<Token>& tokens)
+{
+  while (begin != end) {
+    while (begin != end && (*begin == ' ' || *begin == '\t')) { ++begin; }
+    const char* word = begin;
+    while (begin != end && *begin != ' ' && *begin != '\t') { ++begin; }
+    if (begin != word) { tokens.push_back(Token{word, (size_t)(begin - word)}); }
+  }
+}
+
+
+mutils::BatchReader::BatchReader(std::FILE* file)
+  : _file(file), _buffer(BLOCK)
+{
+}
+
+
+bool mutils::BatchReader::next(const char*& begin, const char*& end)
+{
+  while (true) {
+    const char* data = _buffer.data();
+    const char* newline = (const char*)std::memchr(data + _begin, '\n', _end - _begin);
+    if (newline || (_eof && _begin != _end)) {
+      begin = data + _begin;
+      end = newline ? newline : data + _end;
+      _begin = newline ? (size_t)(newline - data) + 1 : _end;
+      if (end != begin && end[-1] == '\r') { --end; }
+      return true;
+    }
+    if (_eof) { return false; }
+
+    // Keep the partial line, then fill the rest of the buffer
+    std::memmove(_buffer.data(), data + _begin, _end - _begin);
+    _end -= _begin;
+    _begin = 0;
+    if (_end == _buffer.size()) { _buffer.resize(_end + BLOCK); }
+
+    const size_t wanted = _buffer.size() - _end;
+    const size_t got = std::fread(_buffer.data() + _end, 1, wanted, _file);
+    _end += got;
+    if (got < wanted) {
+      _eof = true;
+      _failed = std::ferror(_file) != 0;
+    }
+  }
+}
+
+
+namespace {
+  using mutils::Token;
+
+  // Optionally signed decimal, false if malformed or its magnitude does not
+  // fit 64 bits
+  bool parse_magnitude(const Token& token, bool& negative, unsigned long long& magnitude)
+  {
+    const char* it = token.data;
+    const char* end = it + token.size;
+    negative = it != end && *it == '-';
+    if (it != end && (*it == '-' || *it == '+')) { ++it; }
+    if (it == end) { return false; }
+
+    magnitude = 0;
+    for (; it != end; ++it) {
+      if (*it < '0' || *it > '9') { return false; }
+      const unsigned long long digit = (unsigned long long)(*it - '0');
+      if (magnitude > (ULLONG_MAX - digit) / 10) { return false; }
+      magnitude = magnitude * 10 + digit;
+    }
+    return true;
+  }
+
+  // False if malformed or out of [lo, hi]
+  bool parse(const Token& token, long long lo, long long hi, long long& value)
+  {
+    bool negative;
+    unsigned long long magnitude;
+    if (!parse_magnitude(token, negative, magnitude)) { return false; }
+
+    if (negative) {
+      if (magnitude > (unsigned long long)LLONG_MAX + 1) { return false; }
+      value = magnitude == 0 ? 0 : -(long long)(magnitude - 1) - 1;
+    } else {
+      if (magnitude > (unsigned long long)LLONG_MAX) { return false; }
+      value = (long long)magnitude;
+    }
+    return lo <= value && value <= hi;
+  }
+
+  bool parse(const Token& token, unsigned long long lo, unsigned long long& value)
+  {
+    bool negative;
+    return parse_magnitude(token, negative, value) && (!negative || value == 0) && value >= lo;
+  }
+
+  bool parse(const Token& token, int lo, int& value)
+  {
+    long long wide;
+    if (!parse(token, lo, INT_MAX, wide)) { return false; }
+    value = (int)wide;
+    return true;
+  }
+
+  bool parse_all(const Token* args, size_t count, std::vector<long long>& values)
+  {
+    values.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      if (!parse(args[i], LLONG_MIN, LLONG_MAX, values[i])) { return false; }
+    }
+    return true;
+  }
+
+  bool query_gcd(const Token* args, size_t count, mutils::ResultWriter& out)
+  {
+    std::vector<long long> values;
+    if (!parse_all(args, count, values)) { return false; }
+    out.number(mutils::gcd_of(values.data(), count));
+    return true;
+  }
+
+  bool query_lcm(const Token* args, size_t count, mutils::ResultWriter& out)
+  {
+    std::vector<long long> values;
+    if (!parse_all(args, count, values)) { return false; }
+    out.number(mutils::lcm_of(values.data(), count));
+    return true;
+  }
+
+  bool query_factor(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    unsigned long long n;
+    if (!parse(args[0], 1, n)) { return false; }
+    out.list(mutils::prime_factors(n));
+    return true;
+  }
+
+  bool query_divisors(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n;
+    if (!parse(args[0], 1, n)) { return false; }
+    std::vector<int> divisors;
+    mutils::divisors(n, divisors);
+    out.list(divisors);
+    return true;
+  }
+
+  bool query_primes(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n;
+    if (!parse(args[0], 0, n)) { return false; }
+    out.begin_list();
+    mutils::PrimeGenerator(n).for_each([&out](int p) { out.item((unsigned long long)p); });
+    out.end_list();
+    return true;
+  }
+
+  // cached() from the sequence cache, or lean() if that does not fit the
+  // memory budget of the query
+  template<typename Cached, typename Lean>
+    BigInt within_budget(Cached cached, Lean lean)
+    {
+      try {
+        return cached();
+      } catch (const mutils::memory::BudgetExceeded&) {
+        return lean();
+      }
+    }
+
+  bool query_partitions(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n;
+    if (!parse(args[0], 0, n)) { return false; }
+    // The Rademacher series holds a few numbers instead of p(0..n), on one
+    // thread as the pool already answers a query per core
+    out.number(within_budget([n] { return mutils::SequenceCache::global().partitions_count(n); },
+                             [n] { return mutils::partitions_hrr(n, 1); }));
+    return true;
+  }
+
+  bool query_bell(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n;
+    if (!parse(args[0], 0, n)) { return false; }
+    // One triangle row instead of the row and B(0..n)
+    out.number(within_budget([n] { return mutils::SequenceCache::global().bell(n); },
+                             [n] { return mutils::bell(n); }));
+    return true;
+  }
+
+  bool query_stirling2(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n, k;
+    if (!parse(args[0], 0, n) || !parse(args[1], 0, k)) { return false; }
+    // Columns 0..k instead of the whole row
+    out.number(within_budget([n, k] { return mutils::SequenceCache::global().stirling2(n, k); },
+                             [n, k] { return mutils::stirling2(n, k); }));
+    return true;
+  }
+
+  bool query_factorial(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n;
+    if (!parse(args[0], 0, n)) { return false; }
+    // Without the copies the cache keeps of n! and m!
+    out.number(within_budget([n] { return mutils::SequenceCache::global().factorial(n); },
+                             [n] { return mutils::factorial_prime_swing(n); }));
+    return true;
+  }
+
+  bool query_binomial(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n, k;
+    if (!parse(args[0], 0, n) || !parse(args[1], INT_MIN, k)) { return false; }
+    out.number(mutils::binomial(n, k));
+    return true;
+  }
+
+  bool query_catalan(const Token* args, size_t, mutils::ResultWriter& out)
+  {
+    int n;
+    if (!parse(args[0], 0, n)) { return false; }
+    out.number(mutils::catalan(n));
+    return true;
+  }
+
+  // Residue and modulus pairs, "no solution" if inconsistent
+  bool query_crt(const Token* args, size_t count, mutils::ResultWriter& out)
+  {
+    std::vector<long long> values;
+    if (count % 2 != 0 || !parse_all(args, count, values)) { return false; }
+
+    std::vector<std::pair<long long, long long>> congruences;
+    for (size_t i = 0; i < count; i += 2) {
+      if (values[i + 1] <= 0) { return false; }
+      congruences.emplace_back(values[i], values[i + 1]);
+    }
+
+    BigInt solution, modulus;
+    if (mutils::crt(congruences, solution, modulus)) {
+      out.congruence(solution, modulus);
+    } else {
+      out.none();
+    }
+    return true;
+  }
+
+  struct Command {
+    const char* name;
+    size_t minArgs;
+    size_t maxArgs;
+    const char* usage;
+    bool (*run)(const Token* args, size_t count, mutils::ResultWriter& out);
+  };
+
+  const Command COMMANDS[] = {
+    {"gcd",        1, SIZE_MAX, "gcd a b ...",           query_gcd},
+    {"lcm",        1, SIZE_MAX, "lcm a b ...",           query_lcm},
+    {"factor",     1, 1,        "factor n",              query_factor},
+    {"divisors",   1, 1,        "divisors n",            query_divisors},
+    {"primes",     1, 1,        "primes n",              query_primes},
+    {"partitions", 1, 1,        "partitions n",          query_partitions},
+    {"bell",       1, 1,        "bell n",                query_bell},
+    {"stirling2",  2, 2,        "stirling2 n k",         query_stirling2},
+    {"factorial",  1, 1,        "factorial n",           query_factorial},
+    {"binomial",   2, 2,        "binomial n k",          query_binomial},
+    {"catalan",    1, 1,        "catalan n",             query_catalan},
+    {"crt",        2, SIZE_MAX, "crt a1 m1 a2 m2 ...",   query_crt},
+  };
+}
+
+
+bool mutils::run_query(const Token* tokens, size_t count, ResultWriter& out)
+{
+  if (count == 0) { return false; }
+
+  for (const Command& command : COMMANDS) {
+    if (!tokens[0].equals(command.name)) { continue; }
+
+    const size_t args = count - 1;
+    if (args >= command.minArgs && args <= command.maxArgs && command.run(tokens + 1, args, out)) {
+      return true;
+    }
+    out.discard();
+    out.error(std::string("usage: ") + command.usage);
+    return false;
+  }
+
+  out.error("unknown query '" + std::string(tokens[0].data, tokens[0].size) + "'");
+  return false;
+}
+
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  bool is_query(const char* begin, const char* end)
+  {
+    while (begin != end && (*begin == ' ' || *begin == '\t')) { ++begin; }
+    return begin != end && *begin != '#';
+  }
+
+  // run_query on one line as one record of out, timed and within budget
+  // bytes of BigInt memory, with the most it held in bytes. Anything thrown
+  // is answered as an error.
+  bool answer(const char* begin, const char* end, size_t line, size_t budget, std::vector<Token>& tokens,
+              mutils::ResultWriter& out, double& seconds, size_t& bytes)
+  {
+    const Clock::time_point start = Clock::now();
+    tokens.clear();
+    mutils::tokenize(begin, end, tokens);
+
+    bool ok;
+    mutils::memory::Scope scope(budget);
+    out.begin(line, tokens.data(), tokens.size());
+    try {
+      ok = mutils::run_query(tokens.data(), tokens.size(), out);
+    } catch (const std::exception& e) {
+      out.discard();
+      out.error(e.what());
+      ok = false;
+    }
+    out.end();
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    bytes = scope.peak();
+    return ok;
+  }
+
+  void account(mutils::BatchStats& stats, mutils::OutputSink* latency,
+               size_t line, bool ok, double seconds, size_t bytes)
+  {
+    ++stats.queries;
+    if (!ok) { ++stats.errors; }
+    stats.busy += seconds;
+    stats.slowest = std::max(stats.slowest, seconds);
+    stats.peak = std::max(stats.peak, bytes);
+
+    if (latency) {
+      char entry[96];
+      const int size = std::snprintf(entry, sizeof(entry), "%llu %.9f %llu\n", (unsigned long long)line, seconds,
+                                     (unsigned long long)bytes);
+      latency->text(entry, (size_t)size);
+    }
+  }
+
+  // Thrown out of a slot's answer once it outgrows the slot away from the
+  // head of the window, the query is answered again in order
+  struct Abandoned {};
+
+  // A query in flight, and its answer once done. The answer is buffered in
+  // answer up to OutputSink::BLOCK bytes, past that it goes straight to the
+  // output if the slot is at the head of the window and is abandoned if not.
+  struct Slot {
+    std::string query;
+    std::unique_ptr<mutils::OutputSink> answer;
+    size_t index;
+    size_t line;
+    double seconds;
+    size_t bytes;
+    bool ok;
+    bool done;
+    bool abandoned;
+
+    Slot() : query(), answer(), index(0), line(0), seconds(0), bytes(0), ok(false), done(false), abandoned(false) {}
+  };
+}
+
+
+auto mutils::run_batch(std::FILE* input, std::FILE* output, const BatchOptions& options) -> BatchStats
+{
+  BatchReader reader(input);
+  OutputSink writer(output, BatchReader::BLOCK);
+  std::unique_ptr<OutputSink> latency(options.latency ? new OutputSink(options.latency) : nullptr);
+  BatchStats stats{0, 0, 0.0, 0.0, 0, false};
+
+  const char* begin;
+  const char* end;
+  size_t line = 0;
+
+#ifdef _WIN32
+  // Keep binary records from getting their line feeds translated
+  if (options.format == FORMAT_BINARY) { _setmode(_fileno(output), _O_BINARY); }
+#endif
+  ResultWriter::header(options.format, writer.buffer());
+
+  const unsigned int threads = options.threads == 0 ? ThreadPool::default_threads() : options.threads;
+  if (threads == 1) {
+    std::vector<Token> tokens;
+    ResultWriter out(options.format, writer.buffer(), &writer);
+    while (reader.next(begin, end)) {
+      ++line;
+      if (!is_query(begin, end)) { continue; }
+
+      double seconds;
+      size_t bytes;
+      const bool ok = answer(begin, end, line, options.memoryBudget, tokens, out, seconds, bytes);
+      account(stats, latency.get(), line, ok, seconds, bytes);
+    }
+    writer.flush();
+    stats.readFailed = reader.failed();
+    return stats;
+  }
+
+  // Query i lives in slots[i % window] from its submission until its answer
+  // is written. The pool is declared last so its workers are joined before
+  // anything they touch is destroyed.
+  const size_t window = options.window != 0 ? options.window : BatchOptions::WINDOW_PER_THREAD * threads;
+  std::vector<Slot> slots(window);
+  std::vector<std::vector<Token>> tokens(threads);
+  std::vector<Token> ownTokens;
+  std::mutex mutex;
+  std::condition_variable finished;
+  size_t submitted = 0;
+  size_t written = 0;  // under mutex
+
+  // Only the slot at the head writes out, the calling thread does not touch
+  // writer until that slot is done
+  for (Slot& slot : slots) {
+    slot.answer.reset(new OutputSink([&slot, &writer, &mutex, &written](const char* data, size_t size) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (written != slot.index) { throw Abandoned(); }
+      }
+      writer.text(data, size);
+    }));
+  }
+  ThreadPool pool(threads);
+
+  // Writes out the finished answers at the head of the window, waiting on
+  // the head while more than inFlight queries are outstanding. An abandoned
+  // query is answered again here, straight into writer.
+  auto drain = [&](size_t inFlight) {
+    while (written < submitted) {
+      Slot& slot = slots[written % window];
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!slot.done) {
+          if (submitted - written <= inFlight) { return; }
+          finished.wait(lock, [&slot] { return slot.done; });
+        }
+        slot.done = false;
+      }
+      if (slot.abandoned) {
+        const char* query = slot.query.data();
+        ResultWriter out(options.format, writer.buffer(), &writer);
+        slot.ok = answer(query, query + slot.query.size(), slot.line, options.memoryBudget, ownTokens, out,
+                         slot.seconds, slot.bytes);
+      } else {
+        writer.text(slot.answer->buffer());
+      }
+      slot.answer->buffer().clear();
+      account(stats, latency.get(), slot.line, slot.ok, slot.seconds, slot.bytes);
+      std::lock_guard<std::mutex> lock(mutex);
+      ++written;
+    }
+  };
+
+  while (reader.next(begin, end)) {
+    ++line;
+    if (!is_query(begin, end)) { continue; }
+
+    drain(window - 1);
+    Slot& slot = slots[submitted % window];
+    slot.query.assign(begin, end);
+    slot.index = submitted;
+    slot.line = line;
+    slot.abandoned = false;
+    pool.submit([&slot, &tokens, &mutex, &finished, &options](unsigned int worker) {
+      const char* query = slot.query.data();
+      ResultWriter out(options.format, slot.answer->buffer(), slot.answer.get());
+      try {
+        slot.ok = answer(query, query + slot.query.size(), slot.line, options.memoryBudget, tokens[worker], out,
+                         slot.seconds, slot.bytes);
+      } catch (const Abandoned&) {
+        slot.abandoned = true;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      slot.done = true;
+      finished.notify_one();
+    });
+    ++submitted;
+  }
+  drain(0);
+  writer.flush();
+  stats.readFailed = reader.failed();
+  return stats;
+}
+
+
+auto mutils::batch_usage() -> std::string
+{
+  std::string usage;
+  for (const Command& command : COMMANDS) {
+    usage.append("  ").append(command.usage).append("\n");
+  }
+  return usage;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "result_writer.h"
+
+namespace mutils {
+
+  // A word of a batch query, a view into the reader's buffer
+  struct Token {
+    const char* data;
+    size_t size;
+
+    bool equals(const char* word) const;
+  };
+
+  // Appends the blank separated words of [begin, end) to tokens
+  void tokenize(const char* begin, const char* end, std::vector<Token>& tokens);
+
+  /**
+   * BatchReader class that hands out the lines of a stream as views into one
+   * block buffer, so a query is never copied out of the input.
+   *
+   * Input is read up to BLOCK bytes at a time with fread. A line cut by the
+   * end of a block is moved to the front of the buffer and the rest of the
+   * buffer filled after it, the buffer only grows when one line fills it. A
+   * read error ends the input like end of file, failed() tells them apart.
+   */
+  class BatchReader {
+    private:
+      std::FILE* _file;
+      std::vector<char> _buffer;
+      size_t _begin = 0;  // first unread byte
+      size_t _end = 0;    // end of the bytes read
+      bool _eof = false;
+      bool _failed = false;
+
+    public:
+      static const size_t BLOCK = 1 << 20;
+
+      explicit BatchReader(std::FILE* file);
+      BatchReader(const BatchReader&) = delete;
+      BatchReader& operator=(const BatchReader&) = delete;
+
+      // The next line without its line break, false at the end of the input.
+      // The view is valid until the next call.
+      bool next(const char*& begin, const char*& end);
+      // Whether the input ended on a read error
+      bool failed() const noexcept { return _failed; }
+  };
+
+  struct BatchOptions {
+    ResultFormat format = FORMAT_TEXT;
+    unsigned int threads = 1;      // 0 for all cores
+    size_t window = 0;             // queries in flight, 0 for WINDOW_PER_THREAD a thread
+    std::FILE* latency = nullptr;  // if set, a "line seconds bytes" entry per query
+    size_t memoryBudget = 0;       // BigInt bytes a query may hold, 0 for no limit
+
+    static const size_t WINDOW_PER_THREAD = 256;
+  };
+
+  struct BatchStats {
+    size_t queries;
+    size_t errors;
+    double busy;     // seconds spent answering, summed over the queries
+    double slowest;  // seconds of the slowest query
+    size_t peak;     // most BigInt bytes a query held, see memory::Scope
+    bool readFailed; // the input ended on a read error, the rest is unanswered
+  };
+
+  /**
+   * Answers one query, a command and its arguments, e.g.
+   *
+   *   gcd 12 18          factor 600851475143     bell 500
+   *
+   * as the result of out's current record. An unknown command or bad
+   * arguments give an error instead and return false.
+   *
+   * Under a memory::Scope budget, queries whose cached algorithm holds more
+   * than the budget (the whole Bell, Stirling or p(n) table) retry with one
+   * that keeps less, and throw memory::BudgetExceeded if that fails too.
+   */
+  bool run_query(const Token* tokens, size_t count, ResultWriter& out);
+
+  /**
+   * Answers every query of input on output, a record each in
+   * options.format and in input order. Blank lines and lines starting with
+   * '#' are skipped.
+   *
+   * With more than one thread the queries run on a work-stealing ThreadPool,
+   * so a cheap query never queues behind an expensive one, and their answers
+   * go through a reorder window of options.window slots. Reading stops while
+   * the window is full, so at most that many queries and answers are held
+   * however long the input is, and one slow query stalls the reader only
+   * after the window behind it is full. A slot buffers up to
+   * OutputSink::BLOCK bytes of its answer. The query at the head of the
+   * window streams the rest to output, one further back is abandoned and
+   * answered again in order once it reaches the head, so no answer is ever
+   * held whole.
+   *
+   * Every query runs in a memory::Scope of options.memoryBudget, one over
+   * it is answered with an error.
+   */
+  auto run_batch(std::FILE* input, std::FILE* output,
+                 const BatchOptions& options = BatchOptions()) -> BatchStats;
+
+  // The commands run_query knows, a usage line each
+  auto batch_usage() -> std::string;
+}
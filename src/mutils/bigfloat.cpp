@@ -0,0 +1,349 @@
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include "bigfloat.h"
+
+namespace {
+  // Floor of the square root by Newton's method, started from above with the
+  // leading digits so only O(log P) iterations are needed.
+  BigInt isqrt(const BigInt& num)
+  {
+    if (num.is_zero()) { return BigInt(0); }
+
+    size_t digits = num.digit_count();
+    size_t shift = digits > 18 ? digits - 18 : 0;
+    if (shift % 2 == 1) { ++shift; }
+
+    BigInt lead(num);
+    lead.div_pow10(shift);
+    double root = std::sqrt(std::strtod(lead.to_string().c_str(), nullptr));
+
+    BigInt x(static_cast<unsigned long long>(root) + 2);
+    x.mul_pow10(shift / 2);
+
+    BigInt q, r;
+    while (true) {
+      BigInt::divmod(num, x, q, r);
+      q += x;
+      BigInt::divmod(q, BigInt(2), q, r);
+      if (q >= x) { break; }
+      x = q;
+    }
+    return x;
+  }
+
+  // arctan(1/x) scaled by 10^digits
+  BigInt arctan_inv(unsigned int x, size_t digits)
+  {
+    BigInt power(1);
+    power.mul_pow10(digits);
+    BigInt rem;
+    BigInt::divmod(power, BigInt(x), power, rem);
+
+    const BigInt xSquared(x * x);
+    BigInt sum(power);
+    BigInt term;
+    for (unsigned int i = 1; !power.is_zero(); ++i) {
+      BigInt::divmod(power, xSquared, power, rem);
+      BigInt::divmod(power, BigInt(2 * i + 1), term, rem);
+      if (i % 2 == 1) { sum -= term; } else { sum += term; }
+    }
+    return sum;
+  }
+}
+
+
+BigFloat::BigFloat(const BigInt& mantissa, long exponent, size_t precision)
+  : _mantissa(mantissa), _exponent(exponent), _precision(precision)
+{
+  normalize();
+}
+
+
+/**
+ * Exact conversion, a double m * 2^e with e < 0 is m * 5^-e * 10^e.
+ */
+BigFloat::BigFloat(double value, size_t precision)
+  : _precision(precision)
+{
+  if (value == 0.0) { return; }
+
+  int exp2 = 0;
+  double frac = std::frexp(value, &exp2);
+  long long mantissa = static_cast<long long>(std::ldexp(frac, 53));
+  exp2 -= 53;
+
+  _mantissa = BigInt(mantissa);
+  if (exp2 >= 0) {
+    _mantissa *= BigInt(2) ^ BigInt(exp2);
+  } else {
+    _mantissa *= BigInt(5) ^ BigInt(-exp2);
+    _exponent = exp2;
+  }
+  normalize();
+}
+
+
+/**
+ *
+ * Addition Operator: BigFloat + BigFloat
+ *
+ * Digits of either operand more than two places below the result's precision
+ * are truncated before the operands are aligned.
+ *
+ */
+BigFloat &BigFloat::operator+=(const BigFloat &bfloat) {
+  if (bfloat.is_zero()) { return *this; }
+  if (is_zero()) {
+    _mantissa = bfloat._mantissa;
+    _exponent = bfloat._exponent;
+    normalize();
+    return *this;
+  }
+
+  long floor = std::max(top_digit(), bfloat.top_digit()) - static_cast<long>(_precision) - 2;
+
+  BigInt rhs(bfloat._mantissa);
+  long rhsExponent = bfloat._exponent;
+  if (_exponent < floor) {
+    _mantissa.div_pow10(static_cast<size_t>(floor - _exponent));
+    _exponent = floor;
+  }
+  if (rhsExponent < floor) {
+    rhs.div_pow10(static_cast<size_t>(floor - rhsExponent));
+    rhsExponent = floor;
+  }
+
+  if (_exponent > rhsExponent) {
+    _mantissa.mul_pow10(static_cast<size_t>(_exponent - rhsExponent));
+    _exponent = rhsExponent;
+  } else {
+    rhs.mul_pow10(static_cast<size_t>(rhsExponent - _exponent));
+  }
+
+  _mantissa += rhs;
+  normalize();
+  return *this;
+}
+
+
+/**
+ *
+ * Subtraction Operator: BigFloat - BigFloat
+ *
+ */
+BigFloat &BigFloat::operator-=(const BigFloat &bfloat) {
+  BigFloat negated(bfloat);
+  negated._mantissa *= -1;
+  return *this += negated;
+}
+
+
+/**
+ *
+ * Multiplication Operator: BigFloat * BigFloat
+ *
+ */
+BigFloat &BigFloat::operator*=(const BigFloat &bfloat) {
+  _mantissa *= bfloat._mantissa;
+  _exponent += bfloat._exponent;
+  normalize();
+  return *this;
+}
+
+
+/**
+ *
+ * Division Operator: BigFloat / BigFloat
+ *
+ * The dividend is scaled so the integer quotient has one digit more than the
+ * precision.
+ *
+ */
+BigFloat &BigFloat::operator/=(const BigFloat &bfloat) {
+  long shift = static_cast<long>(_precision + bfloat._mantissa.digit_count()) -
+    static_cast<long>(_mantissa.digit_count()) + 1;
+  if (shift < 0) { shift = 0; }
+
+  BigInt dividend(_mantissa);
+  dividend.mul_pow10(static_cast<size_t>(shift));
+
+  BigInt rem;
+  BigInt::divmod(dividend, bfloat._mantissa, _mantissa, rem);
+  _exponent -= shift + bfloat._exponent;
+  normalize();
+  return *this;
+}
+
+
+auto BigFloat::set_precision(size_t precision) -> BigFloat& {
+  _precision = precision;
+  normalize();
+  return *this;
+}
+
+
+/**
+ * Rounds half away from zero.
+ */
+auto BigFloat::to_bigint() const -> BigInt {
+  BigInt res(_mantissa);
+  if (_exponent >= 0) {
+    res.mul_pow10(static_cast<size_t>(_exponent));
+    return res;
+  }
+
+  bool positive = res.is_positive();
+  res = BigInt::abs(res);
+  res.div_pow10(static_cast<size_t>(-_exponent - 1));
+  res += 5;
+  res.div_pow10(1);
+  if (!positive) { res *= -1; }
+  return res;
+}
+
+
+auto BigFloat::to_double() const -> double {
+  return std::strtod(to_string().c_str(), nullptr);
+}
+
+
+auto BigFloat::to_string() const -> std::string {
+  return _mantissa.to_string() + "e" + std::to_string(_exponent);
+}
+
+
+/**
+ *
+ * Square root by integer square root of the mantissa scaled to an even
+ * exponent and at least twice the precision.
+ *
+ */
+BigFloat BigFloat::sqrt(const BigFloat& bfloat) {
+  if (bfloat.is_zero() || !bfloat.is_positive()) { return BigFloat(bfloat._precision); }
+
+  long shift = static_cast<long>(2 * bfloat._precision + 2) -
+    static_cast<long>(bfloat._mantissa.digit_count());
+  if (shift < 0) { shift = 0; }
+  if ((bfloat._exponent - shift) % 2 != 0) { ++shift; }
+
+  BigInt scaled(bfloat._mantissa);
+  scaled.mul_pow10(static_cast<size_t>(shift));
+  return BigFloat(isqrt(scaled), (bfloat._exponent - shift) / 2, bfloat._precision);
+}
+
+
+/**
+ *
+ * Exponential function
+ *
+ * The argument is halved s times until it is tiny, summed as a Taylor series
+ * and squared back s times. Each squaring doubles the relative error, which
+ * the extra working digits absorb.
+ *
+ */
+BigFloat BigFloat::exp(const BigFloat& bfloat) {
+  const size_t precision = bfloat._precision;
+  if (bfloat.is_zero()) { return BigFloat(BigInt(1), 0, precision); }
+
+  double magnitude = std::fabs(bfloat.to_double());
+  size_t halvings = 8 + static_cast<size_t>(std::sqrt(static_cast<double>(precision)));
+  if (magnitude > 1.0) { halvings += static_cast<size_t>(std::ceil(std::log2(magnitude))); }
+  const size_t working = precision + static_cast<size_t>(std::ceil(0.302 * static_cast<double>(halvings))) + 5;
+
+  BigFloat x(bfloat);
+  x.set_precision(working);
+  x /= BigFloat(BigInt(2) ^ BigInt(static_cast<unsigned long>(halvings)), 0, working);
+
+  BigFloat sum(BigInt(1), 0, working);
+  BigFloat term(BigInt(1), 0, working);
+  for (unsigned long i = 1; ; ++i) {
+    term *= x;
+    term /= BigFloat(BigInt(i), 0, working);
+    if (term.is_zero() || term.top_digit() < -static_cast<long>(working) - 1) { break; }
+    sum += term;
+  }
+
+  for (size_t i = 0; i < halvings; ++i) {
+    sum *= sum;
+  }
+  return sum.set_precision(precision);
+}
+
+
+/**
+ *
+ * Cosine function
+ *
+ * Same halving scheme as exp, recovered with cos(2y) = 2cos(y)^2 - 1. Meant
+ * for arguments within a few multiples of pi.
+ *
+ */
+BigFloat BigFloat::cos(const BigFloat& bfloat) {
+  const size_t precision = bfloat._precision;
+  if (bfloat.is_zero()) { return BigFloat(BigInt(1), 0, precision); }
+
+  const size_t halvings = 4 + static_cast<size_t>(std::sqrt(static_cast<double>(precision))) / 2;
+  const size_t working = precision + static_cast<size_t>(std::ceil(0.61 * static_cast<double>(halvings))) + 5;
+
+  BigFloat x(bfloat);
+  x.set_precision(working);
+  x /= BigFloat(BigInt(2) ^ BigInt(static_cast<unsigned long>(halvings)), 0, working);
+  BigFloat xSquared = x * x;
+
+  BigFloat sum(BigInt(1), 0, working);
+  BigFloat term(BigInt(1), 0, working);
+  for (unsigned long i = 1; ; ++i) {
+    term *= xSquared;
+    term /= BigFloat(BigInt((2 * i - 1) * (2 * i)), 0, working);
+    if (term.is_zero() || term.top_digit() < -static_cast<long>(working) - 1) { break; }
+    if (i % 2 == 1) { sum -= term; } else { sum += term; }
+  }
+
+  const BigFloat one(BigInt(1), 0, working);
+  const BigFloat two(BigInt(2), 0, working);
+  for (size_t i = 0; i < halvings; ++i) {
+    sum = two * sum * sum - one;
+  }
+  return sum.set_precision(precision);
+}
+
+
+/**
+ *
+ * Pi using Machin's formula pi = 16 arctan(1/5) - 4 arctan(1/239) in fixed
+ * point, where every series term only needs single limb divisions.
+ *
+ */
+BigFloat BigFloat::pi(size_t precision) {
+  const size_t digits = precision + 10;
+  BigInt res = arctan_inv(5, digits) * BigInt(16) - arctan_inv(239, digits) * BigInt(4);
+  return BigFloat(res, -static_cast<long>(digits), precision);
+}
+
+
+/*
+ *
+ * Helper functions
+ *
+ */
+
+void BigFloat::normalize() {
+  if (_mantissa.is_zero()) { _exponent = 0; return; }
+
+  size_t digits = _mantissa.digit_count();
+  if (digits > _precision) {
+    _mantissa.div_pow10(digits - _precision);
+    _exponent += static_cast<long>(digits - _precision);
+  }
+}
+
+
+/**
+ * Decimal position one past the most significant digit, so the value lies in
+ * [10^(top - 1), 10^top).
+ */
+auto BigFloat::top_digit() const -> long {
+  return _exponent + static_cast<long>(_mantissa.digit_count());
+}
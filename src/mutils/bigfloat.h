@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+
+#include "bigint.h"
+
+/**
+ * BigFloat class that stores an arbitrary precision decimal floating point
+ * number on top of BigInt.
+ *
+ * The value is _mantissa * 10^_exponent where the mantissa is kept to at most
+ * _precision significant decimal digits. Every operation truncates toward
+ * zero, so a result is off by at most one unit in its last place. Binary
+ * operators take the precision of their lhs.
+ *
+ * Addition       (+) - Time O(P)
+ * Multiplication (*) - Time O(P^2)
+ * Division       (/) - Time O(P^2)
+ * Square root        - Time O(P^2 log P)
+ * Exponential, cos   - Time O(P^2.5)
+ *
+ * where P is the precision in limbs of the operands.
+ */
+class BigFloat {
+  private:
+    BigInt _mantissa{0};
+    long _exponent = 0;
+    size_t _precision = 32;
+
+    void normalize();
+    auto top_digit() const -> long;
+
+  public:
+    // Constructors
+    BigFloat() = default;
+    BigFloat(const BigFloat&) = default;
+    BigFloat(BigFloat&&) = default;
+    ~BigFloat() = default;
+    explicit BigFloat(size_t precision) : _precision(precision) {}
+    BigFloat(const BigInt& mantissa, long exponent, size_t precision);
+    BigFloat(double value, size_t precision);
+
+    BigFloat& operator=(const BigFloat& bfloat) = default;
+    BigFloat& operator=(BigFloat&& bfloat) noexcept = default;
+
+    // Arithmetic operators
+    BigFloat& operator+=(const BigFloat& bfloat);
+    BigFloat& operator-=(const BigFloat& bfloat);
+    BigFloat& operator*=(const BigFloat& bfloat);
+    BigFloat& operator/=(const BigFloat& bfloat);
+
+    // Member functions
+    auto set_precision(size_t precision) -> BigFloat&;
+
+    // Const member functions
+    auto precision() const noexcept -> size_t { return _precision; }
+    bool is_zero() const noexcept { return _mantissa.is_zero(); }
+    bool is_positive() const noexcept { return _mantissa.is_positive(); }
+    auto to_bigint() const -> BigInt;
+    auto to_double() const -> double;
+    auto to_string() const -> std::string;
+
+    // Static member functions
+    static BigFloat sqrt(const BigFloat& bfloat);
+    static BigFloat exp(const BigFloat& bfloat);
+    static BigFloat cos(const BigFloat& bfloat);
+    static BigFloat pi(size_t precision);
+
+}; // end of BigFloat
+
+// Non-member function
+
+inline
+std::ostream &operator<<(std::ostream &os, const BigFloat& num) {
+  os << num.to_string();
+  return os;
+}
+
+// Arithmetic operations
+
+inline
+BigFloat operator+(BigFloat lhs, const BigFloat& rhs) {
+  lhs += rhs;
+  return lhs;
+}
+
+inline
+BigFloat operator-(BigFloat lhs, const BigFloat& rhs) {
+  lhs -= rhs;
+  return lhs;
+}
+
+inline
+BigFloat operator*(BigFloat lhs, const BigFloat& rhs) {
+  lhs *= rhs;
+  return lhs;
+}
+
+inline
+BigFloat operator/(BigFloat lhs, const BigFloat& rhs) {
+  lhs /= rhs;
+  return lhs;
+}
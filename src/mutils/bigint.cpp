@@ -1,8 +1,12 @@
-#include <sstream>
+#include <algorithm>
+#include <cstddef>
 #include <vector>
 
 #include "bigint.h"
 
+namespace instrument = mutils::instrument;
+namespace memory = mutils::memory;
+
 /**
  *
  * Pre-increment/decrement operators
@@ -49,23 +53,7 @@ auto BigInt::operator--(int) -> BigInt {
  *
  */
 BigInt &BigInt::operator+=(const BigInt &bint) {
-  if (bint == 0)  { return *this; }
-  if (*this == 0) { *this = bint; return *this; }
-
-  if (abs(bint) > abs(*this) && _positive != bint._positive) {
-    _positive = !_positive;
-    *this = bint - *this;
-    return *this;
-  }
-
-  if (_positive == bint._positive) {
-    add_reversed_vector_digits(_digits, bint._digits);
-  } else {
-    subtract_reverse_vector_digits(_digits, bint._digits);
-  }
-
-  _has_changes = true;
-  update_value();
+  add_signed(bint, false);
   return *this;
 }
 
@@ -78,24 +66,7 @@ BigInt &BigInt::operator+=(const BigInt &bint) {
  *
  */
 BigInt &BigInt::operator-=(const BigInt &bint) {
-  if (bint == 0)  { return *this; }
-  if (*this == 0) { *this = bint; _positive = !_positive; return *this; }
-
-  if (abs(bint) > abs(*this)) {
-    _positive = !_positive;
-    *this = bint + *this;
-    _positive = !_positive;
-    return *this;
-  }
-
-  if (_positive == bint._positive) {
-    subtract_reverse_vector_digits(_digits, bint._digits);
-  } else {
-    add_reversed_vector_digits(_digits, bint._digits);
-  }
-
-  _has_changes = true;
-  update_value();
+  add_signed(bint, true);
   return *this;
 }
 
@@ -104,81 +75,29 @@ BigInt &BigInt::operator-=(const BigInt &bint) {
  *
  * Multiplication Operator: BigInt * BigInt
  *
- * Mimics multiplication by hand. Uses the concept of dynamic programming.
+ * Mimics multiplication by hand.
  *
  */
 BigInt &BigInt::operator*=(const BigInt &bint) {
-  if (_value == "0")      { return *this; }
-  if (bint._value == "0") { *this = bint; return *this; }
+  if (is_zero())      { return *this; }
+  if (bint.is_zero()) { *this = BigInt(0); return *this; }
 
   _positive = bint._positive == _positive;
-
-  if (bint._value == "1") { return *this; }
-  if (_value == "1") {
-    *this = bint;
-    if (_positive == bint._positive) { _positive = true; }
-    return *this;
-  }
-
-  // Uses lhs as the multiplier, which therefore the slow ptr.
-  auto lhsPtr = _digits.begin(); auto rhsPtr = bint._digits.begin();
-  std::vector<int> buffer{};
-
-  // Init buffer for addition of products
-  for (size_t i = 0; i < _digits.size() + bint._digits.size(); ++i) {
-    buffer.push_back(0);
-  }
-
-  auto bufPtrFast = buffer.begin(); auto bufPtrSlow = buffer.begin();
-  int addOffset = 1; int prod = 1;
-  int prodCarry = 0; int sumCarry = 0;
-
-  // Multiply
-  while (lhsPtr != _digits.end()) {
-    if (rhsPtr != bint._digits.end()) {
-      prod = *lhsPtr;
-      prod *= *rhsPtr;
-      ++rhsPtr;
-    } else {
-      // Append remaining carries to be included in next round
-      if (bufPtrFast == buffer.end()) {
-        buffer.push_back(prodCarry + sumCarry);
-      } else {
-        *bufPtrFast = prodCarry + sumCarry;
-      }
-      *lhsPtr = *bufPtrSlow;
-      // Reset rhs
-      rhsPtr = bint._digits.begin();
-      // Reset buffer ptr with offset, just like adding the products by hand
-      bufPtrFast = buffer.begin() + addOffset;
-
-      ++lhsPtr; ++bufPtrSlow; ++addOffset;
-      prodCarry = 0; sumCarry = 0;
-      continue;
-    }
-    prod += prodCarry;
-
-    // Dynamic addition subprocess
-    if (bufPtrFast != buffer.end()) {
-      int tmp = *bufPtrFast + (prod % BASE) + sumCarry;
-      *bufPtrFast = tmp % BASE;
-      sumCarry = tmp / BASE;
-      ++bufPtrFast;
-    }
-
-    prodCarry = prod / BASE;
-  }
-
-  remove_lead_zeros(buffer);
-
-  // Store the rest in the buffer to lhs
-  while (bufPtrSlow != buffer.end()) {
-    _digits.push_back(*bufPtrSlow);
-    ++bufPtrSlow;
+  instrument::record(instrument::HISTOGRAM_MUL_LIMBS, std::max(_limbs.size(), bint._limbs.size()));
+
+  if (bint._limbs.size() == 1) {
+    multiply_magnitude_small(_limbs, bint._limbs[0]);
+  } else if (_limbs.size() == 1) {
+    uint32_t small = _limbs[0];
+    _limbs = bint._limbs;
+    multiply_magnitude_small(_limbs, small);
+  } else if (_limbs == bint._limbs) {
+    _limbs = square_magnitude(_limbs);
+  } else {
+    _limbs = multiply_magnitude(_limbs, bint._limbs);
   }
 
-  _has_changes = true;
-  update_value();
+  trim();
   return *this;
 }
 
@@ -189,104 +108,60 @@ BigInt &BigInt::operator*=(const BigInt &bint) {
  */
 BigInt &BigInt::operator^=(const BigInt &bint) {
   if (!bint._positive) { *this = BigInt(0); return *this; }  // Improve to consider rounding off
-  if (bint._value == "0") { *this = BigInt(1); return *this; }
-  if (bint._value == "1" || _value == "1" || _value == "0") { return *this; }
-
-  BigInt lhsCopy{*this};
-  std::vector<int> rhsCopy(bint._digits);
-  auto rhsPtr = rhsCopy.begin();
-
-  bool offsetOne = true;
-  while (fill_nth_place(rhsPtr, rhsCopy.end())) {
-    if (offsetOne) { --(*rhsPtr); offsetOne = false; }
-    for (int i = 0; i < *rhsPtr; ++i) {
-      *this *= lhsCopy;
-    }
-    *rhsPtr = 0;
-  }
+  if (bint.is_zero()) { *this = BigInt(1); return *this; }
+  if (bint == 1 || *this == 1 || is_zero()) { return *this; }
 
-  _has_changes = true;
-  update_value();
+  *this = fast_pow(*this, bint);
   return *this;
 }
 
 
-// /*
-//  * TODO: This algorithm is still slower than brute force multipication if the
-//  * division operator is slow. Unless division operator is optimized, this
-//  * algorithm is useless.
-//  *
-//  * Uses Exponentiation by Squaring or Binary Exponentiation method.
-//  */
-// BigInt BigInt::fast_pow(BigInt base, BigInt pow) {
-//   BigInt res = 1;
-//   while (pow > 0) {
-//     if (pow % 2 == 0) {
-//       pow /= 2;
-//       base *= base;
-//     } else {
-//       --pow;
-//       res *= base;
-//       pow /= 2;
-//       base *= base;
-//     }
-//   }
-//   return res;
-// }
-//
-// /**
-//  *
-//  * Exponentiation Operator: BigInt - BigInt
-//  *
-//  */
-// BigInt &BigInt::operator^=(const BigInt &bint) {
-//   *this = fast_pow(*this, bint);
-//   return *this;
-// }
+/*
+ * Uses Exponentiation by Squaring or Binary Exponentiation method.
+ */
+BigInt BigInt::fast_pow(BigInt base, BigInt pow) {
+  BigInt res = 1;
+  while (!pow.is_zero()) {
+    if (divide_magnitude_small(pow._limbs, 2) == 1) {
+      res *= base;
+    }
+    pow.trim();
+    if (!pow.is_zero()) { base *= base; }
+  }
+  return res;
+}
 
 
 /**
  *
  * Division Operator: BigInt / BigInt
  *
- * Division by subtraction. Rounds up quotient if remainder is atleast half of
- * the divisor.
+ * Long division. Rounds up quotient if remainder is atleast half of the
+ * divisor.
  *
  */
-// TODO: Extremely slow even with digits less than 10. Look for better solution.
 BigInt &BigInt::operator/=(const BigInt &bint) {
-  if (bint._value == "0") {
-    *this = bint;
-    _value = "#DIV/0";
+  if (bint.is_zero()) {
+    *this = BigInt(0);
     _errors |= ERROR_DIV_ZERO;
     return *this;
   }
-  if (_value == "0") { return *this; }
+  if (is_zero()) { return *this; }
 
-  _positive = _positive == bint._positive;
+  bool positive = _positive == bint._positive;
 
-  if (bint._value == "1") { return *this; }
+  Limbs quotient;
+  Limbs remainder;
+  divide_magnitude(_limbs, bint._limbs, quotient, remainder);
 
-  BigInt lhsCopy = abs(*this);
-  BigInt rhsCopy = abs(bint);
-
-  BigInt quotient(0);
-  while (lhsCopy > 0) {
-    lhsCopy -= rhsCopy;
-    if (lhsCopy._positive) {
-      ++quotient;
-    }
-  }
-
-  if (!lhsCopy._positive) {
-    if ((lhsCopy + rhsCopy) * BigInt(2) >= rhsCopy) {
-      ++quotient;
-    }
+  add_magnitude(remainder, Limbs(remainder));
+  if (compare_magnitude(remainder, bint._limbs) >= 0) {
+    add_magnitude(quotient, Limbs{1});
   }
 
-  if (!_positive) { quotient *= -1; }
-
-  *this = quotient;
+  _limbs.swap(quotient);
+  _positive = positive;
+  trim();
   return *this;
 }
 
@@ -294,210 +169,717 @@ BigInt &BigInt::operator/=(const BigInt &bint) {
  *
  * Modulo Operator: BigInt % BigInt
  *
- * Utilizes division by subtraction.
+ * Utilizes long division.
  *
  */
-// TODO: Extremely slow even with digits less than 10. Look for better solution.
 BigInt &BigInt::operator%=(const BigInt &bint) {
   if (!_positive || !bint._positive) {
     *this = BigInt(0);
-    _value = "#DOMAIN";
     _errors |= ERROR_DOMAIN;
     return *this;
   }
-  if (bint._value == "0") {
-    *this = bint;
-    _value = "#DIV/0";
+  if (bint.is_zero()) {
+    *this = BigInt(0);
     _errors |= ERROR_DIV_ZERO;
     return *this;
   }
-  if (_value == "0")      { return *this; }
-  if (bint._value == "1") {
-    *this = BigInt(0);
+  if (is_zero() || compare_magnitude(_limbs, bint._limbs) < 0) {
     return *this;
   }
-  if (*this < bint) {
-    return *this;
+
+  Limbs quotient;
+  Limbs remainder;
+  divide_magnitude(_limbs, bint._limbs, quotient, remainder);
+
+  _limbs.swap(remainder);
+  trim();
+  return *this;
+}
+
+
+/**
+ *
+ * Truncating division: quotient rounds toward zero and remainder takes the
+ * sign of lhs, same as the built-in integer operators.
+ *
+ */
+void BigInt::divmod(const BigInt& lhs, const BigInt& rhs, BigInt& quotient, BigInt& remainder) {
+  if (rhs.is_zero()) {
+    quotient = BigInt(0);
+    quotient._errors |= ERROR_DIV_ZERO;
+    remainder = quotient;
+    return;
   }
 
+  // Signs are read first as quotient or remainder may alias lhs or rhs
+  bool quotientPositive = lhs._positive == rhs._positive;
+  bool remainderPositive = lhs._positive;
+
+  Limbs q;
+  Limbs r;
+  divide_magnitude(lhs._limbs, rhs._limbs, q, r);
+
+  quotient._limbs.swap(q);
+  quotient._positive = quotientPositive;
+  quotient._errors = 0;
+  quotient.trim();
+
+  remainder._limbs.swap(r);
+  remainder._positive = remainderPositive;
+  remainder._errors = 0;
+  remainder.trim();
+}
+
 
-  _positive = _positive == bint._positive;
+/**
+ *
+ * Decimal shifts
+ *
+ * Whole limbs are inserted or dropped, the rest is a single limb multiply or
+ * divide by a power of ten below BASE.
+ *
+ */
+BigInt &BigInt::mul_pow10(size_t exp) {
+  if (is_zero() || exp == 0) { return *this; }
+
+  uint32_t small = 1;
+  for (size_t i = 0; i < exp % BASE_DIGITS; ++i) { small *= 10; }
+  multiply_magnitude_small(_limbs, small);
+  _limbs.insert(_limbs.begin(), exp / BASE_DIGITS, 0);
+  return *this;
+}
+
+
+auto BigInt::domain_error() -> BigInt {
+  BigInt res;
+  res._errors = ERROR_DOMAIN;
+  return res;
+}
+
+
+BigInt &BigInt::div_pow10(size_t exp) {
+  if (is_zero() || exp == 0) { return *this; }
+
+  size_t whole = exp / BASE_DIGITS;
+  if (whole >= _limbs.size()) { *this = BigInt(0); return *this; }
+  _limbs.erase(_limbs.begin(), _limbs.begin() + static_cast<std::ptrdiff_t>(whole));
+
+  uint32_t small = 1;
+  for (size_t i = 0; i < exp % BASE_DIGITS; ++i) { small *= 10; }
+  divide_magnitude_small(_limbs, small);
+  trim();
+  return *this;
+}
 
-  BigInt lhsCopy = abs(*this);
 
-  while (lhsCopy >= bint) {
-    lhsCopy -= bint;
+/**
+ * *this += rhs * factor in one pass over the limbs, without the temporary
+ * product. Factors of BASE or more in magnitude take the plain operators.
+ */
+BigInt &BigInt::add_mul(const BigInt& rhs, long long factor) {
+  if (factor == 0 || rhs.is_zero()) { return *this; }
+
+  unsigned long long small = factor < 0 ? 0ULL - (unsigned long long)factor : (unsigned long long)factor;
+  if (small >= BASE || &rhs == this) {
+    *this += rhs * BigInt(factor);
+    return *this;
   }
 
-  if (!_positive) {lhsCopy *= -1; }
-  *this = lhsCopy;
+  const size_t n = rhs._limbs.size();
+  if (_limbs.size() < n) { _limbs.resize(n, 0); }
 
+  if (_positive == (rhs._positive == (factor > 0))) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n || carry; ++i) {
+      if (i == _limbs.size()) { _limbs.push_back(0); }
+      uint64_t cur = _limbs[i] + carry + (i < n ? (uint64_t)rhs._limbs[i] * small : 0);
+      _limbs[i] = (uint32_t)(cur % BASE);
+      carry = cur / BASE;
+    }
+    return *this;
+  }
+
+  // Subtract the product limb by limb, a borrow out of the top means the
+  // product was larger and the limbs hold BASE^size - |result|
+  uint64_t borrow = 0;
+  size_t i = 0;
+  for (; i < n || (borrow && i < _limbs.size()); ++i) {
+    uint64_t sub = borrow + (i < n ? (uint64_t)rhs._limbs[i] * small : 0);
+    uint64_t limb = _limbs[i];
+    if (limb >= sub) {
+      _limbs[i] = (uint32_t)(limb - sub);
+      borrow = 0;
+    } else {
+      uint64_t deficit = sub - limb;
+      borrow = (deficit + BASE - 1) / BASE;
+      _limbs[i] = (uint32_t)(borrow * BASE - deficit);
+    }
+  }
+
+  if (borrow) {
+    // |result| = borrow BASE^size - limbs
+    size_t first = 0;
+    while (first < _limbs.size() && _limbs[first] == 0) { ++first; }
+    if (first < _limbs.size()) {
+      _limbs[first] = BASE - _limbs[first];
+      for (size_t k = first + 1; k < _limbs.size(); ++k) { _limbs[k] = BASE - 1 - _limbs[k]; }
+      --borrow;
+    }
+    if (borrow) { _limbs.push_back((uint32_t)borrow); }
+    _positive = !_positive;
+  }
+  trim();
   return *this;
 }
 
 
+auto BigInt::digit_count() const noexcept -> size_t {
+  size_t count = (_limbs.size() - 1) * BASE_DIGITS;
+  for (uint32_t top = _limbs.back(); top != 0; top /= 10) { ++count; }
+  return count == 0 ? 1 : count;
+}
+
+
 /*
  *
  * Helper functions
  *
  */
 
-void BigInt::update_value() {
-  if (_digits.back() == 0 && !_positive) {
-    _positive = true;
+void BigInt::assign_signed(long long num) {
+  _positive = num >= 0;
+  // Negate in unsigned arithmetic so LLONG_MIN does not overflow
+  unsigned long long magnitude = static_cast<unsigned long long>(num);
+  if (!_positive) { magnitude = 0 - magnitude; }
+  assign_unsigned(magnitude);
+  _positive = num >= 0;
+}
+
+
+void BigInt::assign_unsigned(unsigned long long num) {
+  _positive = true;
+  _limbs.clear();
+  do {
+    _limbs.push_back(static_cast<uint32_t>(num % BASE));
+    num /= BASE;
+  } while (num != 0);
+}
+
+
+/**
+ * Adds (or subtracts if negate) bint into this by comparing magnitudes first so
+ * the larger magnitude is always the minuend.
+ */
+void BigInt::add_signed(const BigInt& bint, bool negate) {
+  if (&bint == this) {
+    BigInt copy(bint);
+    add_signed(copy, negate);
+    return;
   }
 
-  if (_has_changes) {
-    auto it = _digits.rbegin();
-    std::stringstream ss;
+  add_signed(bint._limbs.data(), bint._limbs.size(), negate ? !bint._positive : bint._positive);
+}
 
-    while (it != _digits.rend()) {
-      ss << *it;
-      ++it;
-    }
 
-    _value.replace(0, _value.length(), ss.str());
-    _has_changes = false;
+/**
+ * Adds the value with the given normalized magnitude and sign into this. The
+ * limbs must not be this' own.
+ */
+void BigInt::add_signed(const uint32_t* limbs, size_t size, bool positive) {
+  if (_positive == positive) {
+    add_magnitude(_limbs, limbs, size);
+  } else if (compare_magnitude(_limbs.data(), _limbs.size(), limbs, size) >= 0) {
+    subtract_magnitude(_limbs, limbs, size);
+  } else {
+    Limbs diff;
+    memory::assign(diff, limbs, limbs + size);
+    subtract_magnitude(diff, _limbs);
+    _limbs.swap(diff);
+    _positive = positive;
   }
+
+  trim();
 }
 
 
-void BigInt::remove_lead_zeros(std::vector<int> &vec) {
-  while (vec.size() > 1 && vec[vec.size() - 1] == 0) {
-    vec.pop_back();
+/**
+ * Removes leading zero limbs and normalizes the sign of zero.
+ */
+void BigInt::trim() {
+  trim_magnitude(_limbs);
+  if (is_zero()) { _positive = true; }
+}
+
+
+int BigInt::compare_magnitude(const Limbs& lhs, const Limbs& rhs) {
+  return compare_magnitude(lhs.data(), lhs.size(), rhs.data(), rhs.size());
+}
+
+
+int BigInt::compare_magnitude(const uint32_t* lhs, size_t lhsSize, const uint32_t* rhs, size_t rhsSize) {
+  if (lhsSize != rhsSize) { return lhsSize < rhsSize ? -1 : 1; }
+
+  for (size_t i = lhsSize; i-- > 0;) {
+    if (lhs[i] != rhs[i]) { return lhs[i] < rhs[i] ? -1 : 1; }
   }
+  return 0;
 }
 
 
 /**
- * WARNING: This functions assumes all values are positive and single digits.
+ * WARNING: This functions assumes all values are positive and normalized.
  */
-void BigInt::add_reversed_vector_digits(std::vector<int>& lhs, const std::vector<int>& rhs) {
-  auto lhsPtr = lhs.begin();
-  auto rhsPtr = rhs.begin();
-
-  int sum = 0;
-  while (lhsPtr != lhs.end() || rhsPtr != rhs.end()) {
-    if (lhsPtr != lhs.end()) {
-      sum += *lhsPtr;
-    } else {  // Extend vector if rhs length > lhs length
-      lhs.push_back(0);
-      lhsPtr = lhs.end() - 1;
+void BigInt::add_magnitude(Limbs& lhs, const Limbs& rhs) {
+  add_magnitude(lhs, rhs.data(), rhs.size());
+}
+
+
+void BigInt::add_magnitude(Limbs& lhs, const uint32_t* rhs, size_t rhsSize) {
+  if (lhs.size() < rhsSize) { lhs.resize(rhsSize, 0); }
+
+  uint32_t carry = 0;
+  size_t i = 0;
+  for (; i < rhsSize; ++i) {
+    uint32_t sum = lhs[i] + rhs[i] + carry;   // Fits as 2 * BASE < 2^32
+    carry = sum >= BASE;
+    lhs[i] = carry ? sum - BASE : sum;
+  }
+  for (; carry != 0 && i < lhs.size(); ++i) {
+    uint32_t sum = lhs[i] + carry;
+    carry = sum >= BASE;
+    lhs[i] = carry ? sum - BASE : sum;
+  }
+  if (carry != 0) { lhs.push_back(carry); }
+}
+
+
+/**
+ * WARNING: This functions assumes all values are positive and normalized.
+ * Additionally, lhs should be greater than rhs.
+ */
+void BigInt::subtract_magnitude(Limbs& lhs, const Limbs& rhs) {
+  subtract_magnitude(lhs, rhs.data(), rhs.size());
+}
+
+
+void BigInt::subtract_magnitude(Limbs& lhs, const uint32_t* rhs, size_t rhsSize) {
+  uint32_t borrow = 0;
+  size_t i = 0;
+  for (; i < rhsSize; ++i) {
+    uint32_t sub = rhs[i] + borrow;
+    borrow = lhs[i] < sub;
+    lhs[i] = borrow ? lhs[i] + BASE - sub : lhs[i] - sub;
+  }
+  for (; borrow != 0 && i < lhs.size(); ++i) {
+    borrow = lhs[i] == 0;
+    lhs[i] = borrow ? BASE - 1 : lhs[i] - 1;
+  }
+
+  trim_magnitude(lhs);
+}
+
+
+void BigInt::multiply_magnitude_small(Limbs& lhs, uint32_t rhs) {
+  instrument::count(instrument::COUNTER_MUL_SMALL);
+  uint64_t carry = 0;
+  for (auto& limb : lhs) {
+    uint64_t cur = static_cast<uint64_t>(limb) * rhs + carry;
+    limb = static_cast<uint32_t>(cur % BASE);
+    carry = cur / BASE;
+  }
+  while (carry != 0) {
+    lhs.push_back(static_cast<uint32_t>(carry % BASE));
+    carry /= BASE;
+  }
+}
+
+
+/**
+ * Divides lhs in place by a single limb and returns the remainder.
+ */
+auto BigInt::divide_magnitude_small(Limbs& lhs, uint32_t rhs) -> uint32_t {
+  uint64_t rem = 0;
+  for (size_t i = lhs.size(); i-- > 0;) {
+    uint64_t cur = lhs[i] + rem * BASE;
+    lhs[i] = static_cast<uint32_t>(cur / rhs);
+    rem = cur % rhs;
+  }
+  return static_cast<uint32_t>(rem);
+}
+
+
+/**
+ * Multiplication dispatch. Short operands use schoolbook multiplication,
+ * balanced long ones Karatsuba, and a long operand against a much shorter one
+ * is cut into pieces the size of the shorter so every piece is balanced.
+ */
+auto BigInt::multiply_magnitude(const Limbs& lhs, const Limbs& rhs) -> Limbs {
+  return multiply_magnitude(lhs.data(), lhs.size(), rhs.data(), rhs.size());
+}
+
+
+auto BigInt::multiply_magnitude(const uint32_t* lhs, size_t lhsSize,
+                                const uint32_t* rhs, size_t rhsSize) -> Limbs {
+  if (lhsSize < rhsSize) { return multiply_magnitude(rhs, rhsSize, lhs, lhsSize); }
+  if (rhsSize < KARATSUBA_THRESHOLD) { return multiply_schoolbook(lhs, lhsSize, rhs, rhsSize); }
+  if (lhsSize < 2 * rhsSize) { return multiply_karatsuba(lhs, lhsSize, rhs, rhsSize); }
+
+  Limbs res(lhsSize + rhsSize + 1, 0);
+  for (size_t offset = 0; offset < lhsSize; offset += rhsSize) {
+    size_t size = std::min(rhsSize, lhsSize - offset);
+    // Drop the leading zero limbs of the piece
+    while (size > 1 && lhs[offset + size - 1] == 0) { --size; }
+    add_magnitude_shifted(res, multiply_magnitude(lhs + offset, size, rhs, rhsSize), offset);
+  }
+  trim_magnitude(res);
+  return res;
+}
+
+
+/**
+ * Schoolbook multiplication where every row of partial products is
+ * accumulated with a 64-bit carry.
+ */
+auto BigInt::multiply_schoolbook(const uint32_t* lhs, size_t lhsSize,
+                                 const uint32_t* rhs, size_t rhsSize) -> Limbs {
+  instrument::count(instrument::COUNTER_MUL_SCHOOLBOOK);
+  Limbs res(lhsSize + rhsSize, 0);
+
+  for (size_t i = 0; i < lhsSize; ++i) {
+    if (lhs[i] == 0) { continue; }
+    uint64_t carry = 0;
+    for (size_t j = 0; j < rhsSize; ++j) {
+      uint64_t cur = res[i + j] + static_cast<uint64_t>(lhs[i]) * rhs[j] + carry;
+      res[i + j] = static_cast<uint32_t>(cur % BASE);
+      carry = cur / BASE;
     }
-    if (rhsPtr != rhs.end()) {
-      sum += *rhsPtr;
-      ++rhsPtr;
+    res[i + rhsSize] = static_cast<uint32_t>(carry);
+  }
+
+  trim_magnitude(res);
+  return res;
+}
+
+
+/**
+ * Karatsuba multiplication, lhsSize >= rhsSize > lhsSize / 2.
+ *
+ * With a = a1 B^m + a0 and b = b1 B^m + b0, three half size products
+ * z0 = a0 b0, z2 = a1 b1 and z1 = (a0 + a1)(b0 + b1) - z0 - z2 give
+ * a b = z2 B^2m + z1 B^m + z0.
+ */
+auto BigInt::multiply_karatsuba(const uint32_t* lhs, size_t lhsSize,
+                                const uint32_t* rhs, size_t rhsSize) -> Limbs {
+  const size_t m = lhsSize / 2;
+  instrument::count(instrument::COUNTER_MUL_KARATSUBA);
+
+  Limbs a0, a1, b0, b1;
+  memory::assign(a0, lhs, lhs + m);
+  memory::assign(a1, lhs + m, lhs + lhsSize);
+  memory::assign(b0, rhs, rhs + m);
+  memory::assign(b1, rhs + m, rhs + rhsSize);
+  trim_magnitude(a0);
+  trim_magnitude(b0);
+
+  Limbs z0 = multiply_magnitude(a0, b0);
+  Limbs z2 = multiply_magnitude(a1, b1);
+
+  add_magnitude(a0, a1);
+  add_magnitude(b0, b1);
+  Limbs z1 = multiply_magnitude(a0, b0);
+  subtract_magnitude(z1, z0);
+  subtract_magnitude(z1, z2);
+
+  Limbs res(lhsSize + rhsSize + 1, 0);
+  add_magnitude_shifted(res, z0, 0);
+  add_magnitude_shifted(res, z1, m);
+  add_magnitude_shifted(res, z2, 2 * m);
+  trim_magnitude(res);
+  return res;
+}
+
+
+/**
+ * Squaring, the same tiers as multiply_magnitude with every product
+ * computed once: schoolbook squaring sums each cross product a_i a_j once
+ * and doubles, Karatsuba recurses on three squares.
+ */
+auto BigInt::square_magnitude(const Limbs& vec) -> Limbs {
+  const size_t n = vec.size();
+  if (n >= KARATSUBA_THRESHOLD) {
+    instrument::count(instrument::COUNTER_SQUARE_KARATSUBA);
+    const size_t m = n / 2;
+    Limbs low, high;
+    memory::assign(low, vec.data(), vec.data() + m);
+    memory::assign(high, vec.data() + m, vec.data() + n);
+    trim_magnitude(low);
+
+    Limbs z0 = square_magnitude(low);
+    Limbs z2 = square_magnitude(high);
+    add_magnitude(low, high);
+    Limbs z1 = square_magnitude(low);
+    subtract_magnitude(z1, z0);
+    subtract_magnitude(z1, z2);
+
+    Limbs res(2 * n + 1, 0);
+    add_magnitude_shifted(res, z0, 0);
+    add_magnitude_shifted(res, z1, m);
+    add_magnitude_shifted(res, z2, 2 * m);
+    trim_magnitude(res);
+    return res;
+  }
+
+  instrument::count(instrument::COUNTER_SQUARE_SCHOOLBOOK);
+  Limbs res(2 * n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    if (vec[i] == 0) { continue; }
+    uint64_t carry = 0;
+    for (size_t j = i + 1; j < n; ++j) {
+      uint64_t cur = res[i + j] + static_cast<uint64_t>(vec[i]) * vec[j] + carry;
+      res[i + j] = static_cast<uint32_t>(cur % BASE);
+      carry = cur / BASE;
     }
-    *lhsPtr = sum % BASE;   // Bring down
-    sum /= BASE;            // Carry
-    ++lhsPtr;
+    res[i + n] = static_cast<uint32_t>(carry);
   }
-  if (sum != 0) { _digits.push_back(sum); }
 
-  remove_lead_zeros(this->_digits);
+  uint64_t carry = 0;
+  for (size_t i = 0; i < 2 * n; ++i) {
+    uint64_t cur = 2 * static_cast<uint64_t>(res[i]) + carry;
+    if (i % 2 == 0) { cur += static_cast<uint64_t>(vec[i / 2]) * vec[i / 2]; }
+    res[i] = static_cast<uint32_t>(cur % BASE);
+    carry = cur / BASE;
+  }
+
+  trim_magnitude(res);
+  return res;
+}
+
+
+/**
+ * Adds rhs * BASE^shift into lhs, which must be long enough for the result.
+ */
+void BigInt::add_magnitude_shifted(Limbs& lhs, const Limbs& rhs, size_t shift) {
+  uint32_t carry = 0;
+  size_t i = shift;
+  for (size_t j = 0; j < rhs.size(); ++i, ++j) {
+    uint32_t sum = lhs[i] + rhs[j] + carry;
+    carry = sum >= BASE;
+    lhs[i] = carry ? sum - BASE : sum;
+  }
+  for (; carry != 0; ++i) {
+    uint32_t sum = lhs[i] + carry;
+    carry = sum >= BASE;
+    lhs[i] = carry ? sum - BASE : sum;
+  }
 }
 
 
+void BigInt::trim_magnitude(Limbs& vec) {
+  while (vec.size() > 1 && vec.back() == 0) {
+    vec.pop_back();
+  }
+  if (vec.empty()) { vec.push_back(0); }
+}
+
 
 /**
- * WARNING: This functions assumes all values are positive and single digits.
- * Additionally, lhs should be greater than rhs.
+ * Division of magnitudes. Single limb divisors take one pass, long divisors
+ * with long quotients go through a Newton reciprocal, the rest is long
+ * division.
  */
-void BigInt::subtract_reverse_vector_digits(std::vector<int>& lhs, const std::vector<int>& rhs) {
-  auto lhsPtr = lhs.begin();
-  auto rhsPtr = rhs.begin();
-
-  int diff = 0;
-  while (lhsPtr != lhs.end() || rhsPtr != rhs.end()) {
-    if (lhsPtr != lhs.end()) {
-      diff = *lhsPtr;
+void BigInt::divide_magnitude(const Limbs& lhs, const Limbs& rhs,
+                              Limbs& quotient, Limbs& remainder) {
+  if (compare_magnitude(lhs, rhs) < 0) {
+    quotient.assign(1, 0);
+    memory::assign(remainder, lhs.data(), lhs.data() + lhs.size());
+    return;
+  }
+  if (rhs.size() == 1) {
+    memory::assign(quotient, lhs.data(), lhs.data() + lhs.size());
+    remainder.assign(1, divide_magnitude_small(quotient, rhs[0]));
+    trim_magnitude(quotient);
+    return;
+  }
+  if (rhs.size() >= NEWTON_THRESHOLD && lhs.size() - rhs.size() >= NEWTON_THRESHOLD) {
+    divide_newton(lhs, rhs, quotient, remainder);
+    return;
+  }
+  divide_knuth(lhs, rhs, quotient, remainder);
+}
+
+
+/**
+ * Long division (Knuth's Algorithm D) of normalized magnitudes. Both operands
+ * are scaled so the divisor's leading limb is at least BASE / 2, which keeps
+ * every estimated quotient limb within two of the true one.
+ */
+void BigInt::divide_knuth(const Limbs& lhs, const Limbs& rhs,
+                          Limbs& quotient, Limbs& remainder) {
+  uint32_t norm = static_cast<uint32_t>(BASE / (static_cast<uint64_t>(rhs.back()) + 1));
+  Limbs u, v;
+  memory::assign(u, lhs.data(), lhs.data() + lhs.size());
+  memory::assign(v, rhs.data(), rhs.data() + rhs.size());
+  multiply_magnitude_small(u, norm);
+  multiply_magnitude_small(v, norm);
+  if (u.size() == lhs.size()) { u.push_back(0); }
+
+  const size_t n = v.size();
+  const size_t m = u.size() - n;
+  quotient.assign(m, 0);
+
+  for (size_t j = m; j-- > 0;) {
+    uint64_t num = static_cast<uint64_t>(u[j + n]) * BASE + u[j + n - 1];
+    uint64_t qhat = num / v[n - 1];
+    uint64_t rhat = num % v[n - 1];
+    while (qhat >= BASE || qhat * v[n - 2] > rhat * BASE + u[j + n - 2]) {
+      --qhat;
+      rhat += v[n - 1];
+      if (rhat >= BASE) { break; }
     }
-    if (rhsPtr != rhs.end()) {
-      diff -= *rhsPtr;
-      ++rhsPtr;
+
+    // Multiply and subtract qhat * v from the current window of u
+    uint64_t carry = 0;
+    int64_t borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t prod = qhat * v[i] + carry;
+      carry = prod / BASE;
+      int64_t diff = static_cast<int64_t>(u[i + j]) - static_cast<int64_t>(prod % BASE) - borrow;
+      borrow = diff < 0;
+      u[i + j] = static_cast<uint32_t>(diff < 0 ? diff + BASE : diff);
     }
-    *lhsPtr = diff % BASE;   // Bring down
-    if (*lhsPtr < 0) {
-      take_away_one(lhsPtr, lhs.end());
+    int64_t top = static_cast<int64_t>(u[j + n]) - static_cast<int64_t>(carry) - borrow;
+
+    // qhat was one too large, add the divisor back
+    if (top < 0) {
+      --qhat;
+      uint32_t addCarry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        uint32_t sum = u[i + j] + v[i] + addCarry;
+        addCarry = sum >= BASE;
+        u[i + j] = addCarry ? sum - BASE : sum;
+      }
+      top += addCarry;
     }
-    ++lhsPtr;
+    u[j + n] = static_cast<uint32_t>(top);
+    quotient[j] = static_cast<uint32_t>(qhat);
   }
 
-  remove_lead_zeros(this->_digits);
+  trim_magnitude(quotient);
+
+  u.resize(n);
+  divide_magnitude_small(u, norm);
+  trim_magnitude(u);
+  remainder.swap(u);
 }
 
 
 /**
- * Recursively look for the immediate non-zero nth place to take away one to be
- * carried down into nth place with appropriate base conversion.
+ * Division through a Newton reciprocal, so the cost is a few multiplications
+ * instead of the quadratic long division.
  *
- *      from     end
- *        v       v
- * e.g. { 0, 0, 3 } -> { 0, 10, 2 } -> { 10, 9, 2 } -> return true
- *
- *      from     end
- *        v       v
- * e.g. { 9, 9, 9 } -> return true;
- *
- *      from     end
- *        v       v
- * e.g. { 0, 0, 0 } -> return false;
- *
- *         from  end
- *           v    v
- * e.g. { 8, 0, 9 } -> { 8, 10, 8 } -> return true
+ * Only the top len = q + 3 limbs of the divisor and of the dividend matter
+ * for a q limb quotient, so the reciprocal is taken of those, multiplied by
+ * the matching top of the dividend, and the estimate is corrected against
+ * the exact remainder.
  */
-bool BigInt::fill_nth_place(std::vector<int>::iterator nth, const std::vector<int>::iterator& end) {
-  if (nth != end && *nth > 0) { return true; }
-
-  while (nth != end) {
-    if (fill_nth_place(++nth, end)) {
-      --(*nth);
-      --nth;
-      *nth = BASE;
-      return true;
-    };
+void BigInt::divide_newton(const Limbs& lhs, const Limbs& rhs,
+                           Limbs& quotient, Limbs& remainder) {
+  BigInt dividend;
+  BigInt divisor;
+  memory::assign(dividend._limbs, lhs.data(), lhs.data() + lhs.size());
+  memory::assign(divisor._limbs, rhs.data(), rhs.data() + rhs.size());
+
+  const size_t len = std::min(rhs.size(), lhs.size() - rhs.size() + 3);
+  const size_t drop = rhs.size() - len;
+  const BigInt inverse = reciprocal(shift_limbs(divisor, drop, false));
+
+  const size_t top = lhs.size() - drop;
+  const size_t extra = top > len + 3 ? std::min(top - len - 3, 2 * len) : 0;
+  BigInt q = shift_limbs(shift_limbs(dividend, drop + extra, false) * inverse, 2 * len - extra, false);
+  BigInt r = dividend - q * divisor;
+
+  BigInt steps, rest;
+  if (!r._positive) {
+    divmod(abs(r), divisor, steps, rest);
+    if (!rest.is_zero()) { steps += 1; }
+    q -= steps;
+    r += steps * divisor;
   }
-  return false;
+  if (r >= divisor) {
+    divmod(r, divisor, steps, rest);
+    q += steps;
+    r = rest;
+  }
+
+  quotient.swap(q._limbs);
+  remainder.swap(r._limbs);
 }
 
+
 /**
- * Recursively look for the immediate non-zero nth place to take away one over
- * into `from` element converted into appropriate place value.
- *
- *      from     end
- *        v       v
- * e.g. { 1, 0, 3 } -> { 1, 10, 2 } -> { 11, 9, 2 } -> return true
- *
- *      from     end
- *        v       v
- * e.g. { 9, 9, 9 } -> { 19, 8, 9 } return true;
- *
- *      from     end
- *        v       v
- * e.g. { 0, 0, 0 } -> return false;
- *
- *         from  end
- *           v    v
- * e.g. { 1, 9, 3 } -> { 1, 19, 2 } -> return true
+ * Approximately BASE^2n / num for an n limb num, by Newton's iteration
+ * x + x (BASE^2n - num x) / BASE^2n started from the reciprocal of the top
+ * half of num, so every step doubles the precision. The correction term
+ * only has to be right to about half the limbs, so both of its factors are
+ * cut to that before multiplying.
  */
-bool BigInt::take_away_one(std::vector<int>::iterator from, const std::vector<int>::iterator& end) {
-  if (fill_nth_place(++from, end)) {
-    --(*from);
-    --from;
-    *from += BASE;
-    return true;
+auto BigInt::reciprocal(const BigInt& num) -> BigInt {
+  const size_t n = num._limbs.size();
+  const BigInt scale = shift_limbs(BigInt(1), 2 * n, true);
+  if (n < NEWTON_THRESHOLD) {
+    BigInt q, r;
+    divmod(scale, num, q, r);
+    return q;
   }
-  return false;
+
+  const size_t low = n / 2;
+  BigInt x = shift_limbs(reciprocal(shift_limbs(num, low, false)), low, true);
+  const BigInt error = scale - num * x;
+
+  const size_t keep = low + 3;
+  const size_t xDrop = x._limbs.size() > keep ? x._limbs.size() - keep : 0;
+  const size_t errorDrop = std::min(error._limbs.size() > keep ? error._limbs.size() - keep : 0,
+                                    2 * n - xDrop);
+  x += shift_limbs(shift_limbs(x, xDrop, false) * shift_limbs(error, errorDrop, false),
+                   2 * n - xDrop - errorDrop, false);
+  return x;
 }
 
 
-auto BigInt::truncate_string(const std::string& str, size_t width, bool show_ellipsis) -> std::string {
-  if (width > 0 && str.length() > width) {
-    if (show_ellipsis) {
-      return str.substr(0, width) + "...";
+// num * BASE^limbs, or num / BASE^limbs truncated
+auto BigInt::shift_limbs(const BigInt& num, size_t limbs, bool left) -> BigInt {
+  BigInt res(num);
+  if (limbs == 0 || res.is_zero()) { return res; }
+  if (left) {
+    res._limbs.insert(res._limbs.begin(), limbs, 0);
+  } else if (limbs >= res._limbs.size()) {
+    return BigInt(0);
+  } else {
+    res._limbs.erase(res._limbs.begin(), res._limbs.begin() + static_cast<std::ptrdiff_t>(limbs));
+  }
+  res.trim();
+  return res;
+}
+
+
+auto BigInt::magnitude_string() const -> std::string {
+  if (_errors & ERROR_DIV_ZERO) { return "#DIV/0"; }
+  if (_errors & ERROR_DOMAIN)   { return "#DOMAIN"; }
+
+  std::string str = std::to_string(_limbs.back());
+  const size_t digits = str.size() + (_limbs.size() - 1) * BASE_DIGITS;
+  str.reserve(digits);
+  instrument::count(instrument::COUNTER_TO_STRING);
+  instrument::record(instrument::HISTOGRAM_STRING_DIGITS, digits);
+
+  char buf[BASE_DIGITS];
+  for (size_t i = _limbs.size() - 1; i-- > 0;) {
+    uint32_t limb = _limbs[i];
+    for (int d = BASE_DIGITS - 1; d >= 0; --d) {
+      buf[d] = static_cast<char>('0' + limb % 10);
+      limb /= 10;
     }
-    return str.substr(0, width);
+    str.append(buf, BASE_DIGITS);
   }
   return str;
 }
@@ -513,3 +895,95 @@ auto BigInt::truncate_string(const std::string& str, size_t width, bool show_ell
   return str;
 }
 
+
+/**
+ *
+ * Serialization
+ *
+ * A value is a 4 byte little-endian limb count, 4 bytes of flags (bit 0 the
+ * sign, the next two the error flags) and the limbs as 4 byte little-endian
+ * words, least significant first. Every part is a multiple of 4 bytes so
+ * values written back to back stay aligned for BigIntView.
+ *
+ */
+
+namespace {
+  void append_word(std::string& out, uint32_t word) {
+    const char bytes[4] = {
+      static_cast<char>(word & 0xFF),
+      static_cast<char>((word >> 8) & 0xFF),
+      static_cast<char>((word >> 16) & 0xFF),
+      static_cast<char>(word >> 24),
+    };
+    out.append(bytes, 4);
+  }
+
+  uint32_t read_word(const char* data) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+      static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+  }
+}
+
+
+auto BigInt::serialized_size() const noexcept -> size_t {
+  return SERIAL_HEADER + 4 * _limbs.size();
+}
+
+
+void BigInt::serialize(std::string& out) const {
+  out.reserve(out.size() + serialized_size());
+  append_word(out, static_cast<uint32_t>(_limbs.size()));
+  append_word(out, (_positive ? 0 : SERIAL_NEGATIVE) |
+                   static_cast<uint32_t>(_errors) << SERIAL_ERROR_SHIFT);
+  for (uint32_t limb : _limbs) { append_word(out, limb); }
+}
+
+
+bool BigInt::deserialize(const char*& data, const char* end, BigInt& out) {
+  uint32_t flags = 0;
+  const size_t size = serial_limbs(data, end, flags);
+  if (size == 0) { return false; }
+
+  Limbs limbs(size);
+  const char* cur = data + SERIAL_HEADER;
+  for (size_t i = 0; i < size; ++i, cur += 4) { limbs[i] = read_word(cur); }
+  if (!serial_valid(limbs.data(), size, flags)) { return false; }
+
+  out._limbs.swap(limbs);
+  out._positive = (flags & SERIAL_NEGATIVE) == 0;
+  out._errors = static_cast<unsigned char>(flags >> SERIAL_ERROR_SHIFT);
+  data = cur;
+  return true;
+}
+
+
+/**
+ * The limb count of the serialized value at data with its flags, or 0 if
+ * [data, end) is too short for it.
+ */
+auto BigInt::serial_limbs(const char* data, const char* end, uint32_t& flags) -> size_t {
+  if (end - data < static_cast<std::ptrdiff_t>(SERIAL_HEADER)) { return 0; }
+  const size_t size = read_word(data);
+  flags = read_word(data + 4);
+  if (static_cast<size_t>(end - data - static_cast<std::ptrdiff_t>(SERIAL_HEADER)) / 4 < size) { return 0; }
+  return size;
+}
+
+
+/**
+ * True if the limbs and flags are what serialize() writes: known flags and a
+ * normalized magnitude, without leading zero limbs or a negative zero.
+ */
+bool BigInt::serial_valid(const uint32_t* limbs, size_t size, uint32_t flags) {
+  const uint32_t known = SERIAL_NEGATIVE |
+    static_cast<uint32_t>(ERROR_DIV_ZERO | ERROR_DOMAIN) << SERIAL_ERROR_SHIFT;
+  if ((flags & ~known) != 0) { return false; }
+  if (size > 1 && limbs[size - 1] == 0) { return false; }
+  if (size == 1 && limbs[0] == 0 && (flags & SERIAL_NEGATIVE) != 0) { return false; }
+
+  for (size_t i = 0; i < size; ++i) {
+    if (limbs[i] >= BASE) { return false; }
+  }
+  return true;
+}
@@ -1,168 +1,152 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <iterator>
 #include <ostream>
 #include <string>
 #include <vector>
 
+#include "instrument.h"
+#include "memory.h"
+
 /**
  * BigInt class that stores arbitrary amout of integer that supports basic
  * arithmetic and comparison operators.
  *
- * Private vector _digits stores digits in reverse order for convenience as most
- * of the arithemic operators mimics by hand techniques when calculating two
- * arbitrary numbers.
+ * Private vector _limbs stores the magnitude in base 10^9 "limbs" in reverse
+ * order (least significant limb first). Most of the arithmetic operators still
+ * mimic by hand techniques, only nine decimal digits at a time. Because the
+ * base is a power of ten, conversion to and from decimal strings is linear.
  *
- * Exponent       (^) - Space O(n + m), Time O(nM)
- * Multiplication (*) - Space O(n + m), Time O(nm)
- * Division       (/) - Space O(2(n + m)), Time O(n^2)
- * Modulus        (%) - Space O(2(n + m)), Time O(n^2)
+ * Exponent       (^) - Space O(n + m), Time O(n^1.585 log M)
+ * Multiplication (*) - Space O(n + m), Time O(nm) below KARATSUBA_THRESHOLD
+ *                      limbs, O(n^1.585) Karatsuba above
+ * Division       (/) - Space O(n + m), Time O(nm) below NEWTON_THRESHOLD
+ *                      limbs, a few multiplications above
+ * Modulus        (%) - Space O(n + m), Time as division
  * Addition       (+) - Space O(1), Time O(max(n,m))
  * Subtraction    (-) - Space O(1), Time O(max(n,m))
  *
- * where n and m are the respective number of digits of lhs and rhs, and M as
+ * where n and m are the respective number of limbs of lhs and rhs, and M as
  * the arithmetic value of rhs.
  */
 class BigInt {
+  public:
+    // Storage of the magnitude, counted by mutils::memory
+    using Limbs = std::vector<uint32_t, mutils::memory::CountingAllocator<uint32_t>>;
+
   private:
-    const unsigned char ERROR_DIV_ZERO = 1;
-    const unsigned char ERROR_DOMAIN = 2;
+    static const unsigned char ERROR_DIV_ZERO = 1;
+    static const unsigned char ERROR_DOMAIN = 2;
+
+    static const uint32_t BASE = 1000000000;
+    static const int BASE_DIGITS = 9;
+    static const size_t KARATSUBA_THRESHOLD = 24;  // limbs
+    static const size_t NEWTON_THRESHOLD = 256;    // limbs
 
-    const int BASE = 10;
-    std::string _value{"0"};
-    std::vector<int> _digits{0};
+    Limbs _limbs{0};
     bool _positive = true;
-    bool _has_changes = false;
     unsigned char _errors = 0;
 
-    void update_value();
-    void add_reversed_vector_digits(std::vector<int>& lhs, const std::vector<int>& rhs);
-    void subtract_reverse_vector_digits(std::vector<int>& lhs, const std::vector<int>& rhs);
-    bool fill_nth_place(std::vector<int>::iterator nth, const std::vector<int>::iterator& end);
-    bool take_away_one(std::vector<int>::iterator from, const std::vector<int>::iterator& end);
-    void remove_lead_zeros(std::vector<int> &vec);
+    void assign_signed(long long num);
+    void assign_unsigned(unsigned long long num);
+    void add_signed(const BigInt& bint, bool negate);
+    void trim();
+    void add_signed(const uint32_t* limbs, size_t size, bool positive);
+    static int compare_magnitude(const Limbs& lhs, const Limbs& rhs);
+    static int compare_magnitude(const uint32_t* lhs, size_t lhsSize, const uint32_t* rhs, size_t rhsSize);
+    static void add_magnitude(Limbs& lhs, const Limbs& rhs);
+    static void add_magnitude(Limbs& lhs, const uint32_t* rhs, size_t rhsSize);
+    static void subtract_magnitude(Limbs& lhs, const Limbs& rhs);
+    static void subtract_magnitude(Limbs& lhs, const uint32_t* rhs, size_t rhsSize);
+    static void add_magnitude_shifted(Limbs& lhs, const Limbs& rhs, size_t shift);
+    static void trim_magnitude(Limbs& vec);
+    static void multiply_magnitude_small(Limbs& lhs, uint32_t rhs);
+    static auto divide_magnitude_small(Limbs& lhs, uint32_t rhs) -> uint32_t;
+    static auto multiply_magnitude(const Limbs& lhs, const Limbs& rhs) -> Limbs;
+    static auto multiply_magnitude(const uint32_t* lhs, size_t lhsSize,
+                                   const uint32_t* rhs, size_t rhsSize) -> Limbs;
+    static auto multiply_schoolbook(const uint32_t* lhs, size_t lhsSize,
+                                    const uint32_t* rhs, size_t rhsSize) -> Limbs;
+    static auto square_magnitude(const Limbs& vec) -> Limbs;
+    static auto multiply_karatsuba(const uint32_t* lhs, size_t lhsSize,
+                                   const uint32_t* rhs, size_t rhsSize) -> Limbs;
+    static void divide_magnitude(const Limbs& lhs, const Limbs& rhs,
+                                 Limbs& quotient, Limbs& remainder);
+    static void divide_knuth(const Limbs& lhs, const Limbs& rhs,
+                             Limbs& quotient, Limbs& remainder);
+    static void divide_newton(const Limbs& lhs, const Limbs& rhs,
+                              Limbs& quotient, Limbs& remainder);
+    static auto reciprocal(const BigInt& num) -> BigInt;
+    static auto shift_limbs(const BigInt& num, size_t limbs, bool left) -> BigInt;
     auto fast_pow(BigInt base, BigInt pow) -> BigInt;
-    auto truncate_string(const std::string& str, size_t width, bool show_ellipsis = false) -> std::string;
+    auto magnitude_string() const -> std::string;
     auto truncate_string(const std::string& str, size_t width, bool show_ellipsis = false) const -> std::string;
 
+    static const uint32_t SERIAL_NEGATIVE = 1;
+    static const uint32_t SERIAL_ERROR_SHIFT = 1;
+    static const size_t SERIAL_HEADER = 8;  // bytes
+
+    static auto serial_limbs(const char* data, const char* end, uint32_t& flags) -> size_t;
+    static bool serial_valid(const uint32_t* limbs, size_t size, uint32_t flags);
+
+    friend class BigIntView;
+
   public:
     // Constructors
     BigInt() = default;
-    BigInt(const BigInt&) = default;
+    // Copies by hand, a vector with CountingAllocator copies limb by limb
+    BigInt(const BigInt& bint) : _limbs(bint._limbs.size()), _positive(bint._positive), _errors(bint._errors) {
+      std::copy(bint._limbs.begin(), bint._limbs.end(), _limbs.begin());
+    }
     BigInt(BigInt&&) = default;
     ~BigInt() = default;
     BigInt(const std::string& num) {
-      if (num[0] == '-') {
+      std::string::const_iterator begin = num.begin();
+      if (!num.empty() && num[0] == '-') {
         if (num.size() <= 1) { return; }
-        if (!(num.size() == 2 && num[1] == '0')) {
-          _positive = false;
-        }
-        _value.assign(num.begin() + 1, num.end());
-      } else {
-        _value = num;
-      }
-      // Remove leading whitespace
-      _value.erase(0, std::min(_value.find_first_not_of('0'), _value.size()-1));
-
-      _digits.clear();
-      for (auto it = _value.crbegin(); it != _value.crend(); ++it) {
-        _digits.push_back(*it - '0');
-      }
-    }
-
-    BigInt(const int& num) {
-      int num_copy = static_cast<int>(num);
-      if (num < 0) { _positive = false; num_copy *= -1; }
-      _value = std::to_string(num_copy);
-
-      _digits.clear();
-      while (num_copy != 0) {
-        _digits.push_back(num_copy % BASE);
-        num_copy /= BASE;
-      }
-    }
-
-    BigInt(const long int& num) {
-      int num_copy = static_cast<int>(num);
-      if (num < 0) { _positive = false; num_copy *= -1; }
-      _value = std::to_string(num_copy);
-
-      _digits.clear();
-      while (num_copy != 0) {
-        _digits.push_back(num_copy % BASE);
-        num_copy /= BASE;
-      }
-    }
-
-    BigInt(const long long int& num) {
-      int num_copy = static_cast<int>(num);
-      if (num < 0) { _positive = false; num_copy *= -1; }
-      _value = std::to_string(num_copy);
-
-      _digits.clear();
-      while (num_copy != 0) {
-        _digits.push_back(num_copy % BASE);
-        num_copy /= BASE;
+        _positive = false;
+        ++begin;
       }
-    }
-
-    BigInt(int&& num) {
-      if (num < 0) { _positive = false; num *= -1; }
-      _value = std::to_string(num);
-
-      _digits.clear();
-      while (num != 0) {
-        _digits.push_back(num % BASE);
-        num /= BASE;
-      }
-    }
-
-    BigInt(long int&& num) {
-      if (num < 0) { _positive = false; num *= -1; }
-      _value = std::to_string(num);
-
-      _digits.clear();
-      while (num != 0) {
-        _digits.push_back(static_cast<int>(num % BASE));
-        num /= BASE;
+      // Remove leading zeros
+      while (begin + 1 < num.end() && *begin == '0') { ++begin; }
+      mutils::instrument::count(mutils::instrument::COUNTER_FROM_STRING);
+      mutils::instrument::record(mutils::instrument::HISTOGRAM_STRING_DIGITS, (unsigned long long)(num.end() - begin));
+
+      // Read nine digits at a time starting from the least significant end
+      _limbs.clear();
+      auto end = num.end();
+      while (end > begin) {
+        auto start = end - begin > BASE_DIGITS ? end - BASE_DIGITS : begin;
+        uint32_t limb = 0;
+        for (auto it = start; it != end; ++it) {
+          limb = limb * 10 + static_cast<uint32_t>(*it - '0');
+        }
+        _limbs.push_back(limb);
+        end = start;
       }
+      trim();
     }
 
-    BigInt(long long int&& num) {
-      if (num < 0) { _positive = false; num *= -1; }
-      _value = std::to_string(num);
-
-      _digits.clear();
-      while (num != 0) {
-        _digits.push_back(static_cast<int>(num % BASE));
-        num /= BASE;
-      }
-    }
+    BigInt(int num)                { assign_signed(num); }
+    BigInt(long int num)           { assign_signed(num); }
+    BigInt(long long int num)      { assign_signed(num); }
+    BigInt(unsigned int num)       { assign_unsigned(num); }
+    BigInt(unsigned long num)      { assign_unsigned(num); }
+    BigInt(unsigned long long num) { assign_unsigned(num); }
 
     // Copy assignment
     BigInt& operator=(const BigInt& bint) {
-      if (&bint != this) {
-        _value = bint._value;
-        _digits = bint._digits;
-        _positive = bint._positive;
-        _has_changes = bint._has_changes;
-        _errors = bint._errors;
-      }
+      mutils::memory::assign(_limbs, bint._limbs.data(), bint._limbs.data() + bint._limbs.size());
+      _positive = bint._positive;
+      _errors = bint._errors;
       return *this;
     }
 
     // Move assignment
-    BigInt& operator=(BigInt&& bint) noexcept {
-      if (&bint != this) {
-        _value = std::move(bint._value);
-        _digits = std::move(bint._digits);
-        _positive = bint._positive;
-        _has_changes = bint._has_changes;
-        _errors = bint._errors;
-      }
-      return *this;
-    }
+    BigInt& operator=(BigInt&& bint) noexcept = default;
 
     // Arithmetic operators
     BigInt& operator+=(const BigInt& bint);
@@ -176,44 +160,42 @@ class BigInt {
     BigInt operator++(int);
     BigInt operator--(int);
 
+    // Decimal shifts, multiply or truncating divide by 10^exp
+    BigInt& mul_pow10(size_t exp);
+    BigInt& div_pow10(size_t exp);
+
+    // Fused *this += rhs * factor
+    BigInt& add_mul(const BigInt& rhs, long long factor);
+
+    // 0 flagged as a domain error, for functions undefined at their input
+    static auto domain_error() -> BigInt;
+
+    friend
+    bool operator==(const BigInt& lhs, const BigInt& rhs);
     friend
     bool operator<(const BigInt& lhs, const BigInt& rhs);
 
-    // Member functions
-    auto abs() noexcept -> std::string { return _value; }
-    auto to_string() noexcept -> std::string {
-      if (_positive) { return _value; }
-      return "-" + _value;
-    }
-    auto to_scientific(const size_t& width) noexcept -> std::string {
-      size_t len = _value.length();
-      if (width > 0 && len > width) {
-        if (_positive) {
-          return truncate_string(_value, width) +
-            "e+" + std::to_string(len - width);
-        }
-        return "-" + truncate_string(_value, width) +
-          "e+" + std::to_string(len - width);
-      }
-      return to_string();
-    }
-
     // Const member functions
-    auto abs() const noexcept -> std::string { return _value; }
+    auto abs() const noexcept -> std::string { return magnitude_string(); }
     bool is_positive() const noexcept { return _positive; }
     bool is_valid() const noexcept { return _errors == 0; }
+    bool is_zero() const noexcept { return _limbs.size() == 1 && _limbs[0] == 0; }
+    // The magnitude in base 10^9, least significant limb first
+    auto limbs() const noexcept -> const Limbs& { return _limbs; }
+    auto digit_count() const noexcept -> size_t;
     auto to_string() const noexcept -> std::string {
-      if (_positive) { return _value; }
-      return "-" + _value;
+      if (_positive || !is_valid()) { return magnitude_string(); }
+      return "-" + magnitude_string();
     }
     auto to_scientific(const size_t& width) const noexcept -> std::string {
-      size_t len = _value.length();
+      std::string value = magnitude_string();
+      size_t len = value.length();
       if (width > 0 && len > width) {
         if (_positive) {
-          return truncate_string(_value, width) +
+          return truncate_string(value, width) +
             "e+" + std::to_string(len - width);
         }
-        return "-" + truncate_string(_value, width) +
+        return "-" + truncate_string(value, width) +
           "e+" + std::to_string(len - width);
       }
       return to_string();
@@ -224,6 +206,17 @@ class BigInt {
       bint._positive = true;
       return bint;
     }
+    static void divmod(const BigInt& lhs, const BigInt& rhs,
+                       BigInt& quotient, BigInt& remainder);
+
+    // Binary serialization, see BigIntView for the format
+    auto serialized_size() const noexcept -> size_t;
+    // Appends the serialized value to out
+    void serialize(std::string& out) const;
+    // Reads one serialized value at data into out and moves data past it.
+    // False, with data and out untouched, if [data, end) does not start with
+    // a well formed one
+    static bool deserialize(const char*& data, const char* end, BigInt& out);
 
 }; // end of BigInt
 
@@ -248,7 +241,8 @@ std::ostream &operator<<(std::ostream &os, const BigInt& num) {
 // Relational operators
 inline
 bool operator==(const BigInt& lhs, const BigInt& rhs) {
-  return lhs.to_string() == rhs.to_string();
+  return lhs._errors == rhs._errors && lhs._positive == rhs._positive &&
+    lhs._limbs == rhs._limbs;
 }
 
 inline
@@ -258,67 +252,45 @@ bool operator==(const BigInt& lhs, const std::string& rhs) {
 
 inline
 bool operator==(const BigInt& lhs, const int& rhs) {
-  return lhs.to_string() == std::to_string(rhs);
+  return lhs == BigInt(rhs);
 }
 
 inline
 bool operator==(const BigInt& lhs, const long int& rhs) {
-  return lhs.to_string() == std::to_string(rhs);
+  return lhs == BigInt(rhs);
 }
 
 inline
 bool operator==(const BigInt& lhs, const long long int& rhs) {
-  return lhs.to_string() == std::to_string(rhs);
+  return lhs == BigInt(rhs);
 }
 
 inline
 bool operator!=(const BigInt& lhs, const BigInt& rhs) {
-  return !(lhs.to_string() == rhs.to_string());
+  return !(lhs == rhs);
 }
 
 inline
 bool operator< (const BigInt& lhs, const BigInt& rhs) {
-  if (lhs._positive && rhs._positive) {
-    if (lhs._digits.size() < rhs._digits.size()) { return true; }
-    if (lhs._digits.size() > rhs._digits.size()) { return false; }
-  }
-  if (!lhs._positive && !rhs._positive) {
-    if (lhs._digits.size() < rhs._digits.size()) { return false; }
-    if (lhs._digits.size() > rhs._digits.size()) { return true; }
-  }
-  if (lhs._positive && !rhs._positive) { return false; }
-  if (!lhs._positive && rhs._positive) { return true; }
-
-  auto lhs_it = lhs._digits.rbegin(); auto rhs_it = rhs._digits.rbegin();
-  while (lhs_it != lhs._digits.rend() || rhs_it != rhs._digits.rend()) {
-    if (*lhs_it == *rhs_it) {
-      ++lhs_it; ++rhs_it; continue;
-    }
-    break;
-  }
-  if (lhs_it == lhs._digits.rend() || rhs_it == rhs._digits.rend()) {
-    return false;
-  }
-
-  if (!lhs._positive && !rhs._positive) {
-    return *lhs_it > *rhs_it;
-  }
-  return *lhs_it < *rhs_it;
+  if (lhs._positive != rhs._positive) { return !lhs._positive; }
+
+  int cmp = BigInt::compare_magnitude(lhs._limbs, rhs._limbs);
+  return lhs._positive ? cmp < 0 : cmp > 0;
 }
 
 inline
 bool operator<=(const BigInt& lhs, const BigInt& rhs) {
-  return lhs < rhs || lhs == rhs;
+  return !(rhs < lhs);
 }
 
 inline
 bool operator> (const BigInt& lhs, const BigInt& rhs) {
-  return !(lhs < rhs) && lhs != rhs;
+  return rhs < lhs;
 }
 
 inline
 bool operator>=(const BigInt& lhs, const BigInt& rhs) {
-  return lhs > rhs || lhs == rhs;
+  return !(lhs < rhs);
 }
 
 // Arithmetic operations
@@ -358,4 +330,3 @@ BigInt operator%(BigInt lhs, const BigInt& rhs) {
   lhs %= rhs;
   return lhs;
 }
-
@@ -0,0 +1,102 @@
+#include "bigint_view.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+  const uint32_t ZERO_LIMB = 0;
+
+  bool little_endian() {
+    const uint32_t probe = 1;
+    return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+  }
+}
+
+
+BigIntView::BigIntView() noexcept
+  : _limbs(&ZERO_LIMB), _size(1), _positive(true) {}
+
+
+bool BigIntView::view(const char*& data, const char* end, BigIntView& out) {
+  if (!little_endian() || reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) { return false; }
+
+  uint32_t flags = 0;
+  const size_t size = BigInt::serial_limbs(data, end, flags);
+  if (size == 0) { return false; }
+
+  // Error values have no magnitude to work with
+  const uint32_t* limbs = reinterpret_cast<const uint32_t*>(data + BigInt::SERIAL_HEADER);
+  if ((flags & ~BigInt::SERIAL_NEGATIVE) != 0 || !BigInt::serial_valid(limbs, size, flags)) {
+    return false;
+  }
+
+  out._limbs = limbs;
+  out._size = size;
+  out._positive = (flags & BigInt::SERIAL_NEGATIVE) == 0;
+  data += BigInt::SERIAL_HEADER + 4 * size;
+  return true;
+}
+
+
+auto BigIntView::to_bigint() const -> BigInt {
+  BigInt res;
+  mutils::memory::assign(res._limbs, _limbs, _limbs + _size);
+  res._positive = _positive;
+  return res;
+}
+
+
+int BigIntView::compare(const BigIntView& lhs, const BigIntView& rhs) noexcept {
+  if (lhs._positive != rhs._positive) { return lhs._positive ? 1 : -1; }
+
+  int cmp = BigInt::compare_magnitude(lhs._limbs, lhs._size, rhs._limbs, rhs._size);
+  return lhs._positive ? cmp : -cmp;
+}
+
+
+void BigIntView::add_into(BigInt& acc) const {
+  if (_limbs == acc._limbs.data()) {
+    acc += to_bigint();
+    return;
+  }
+  acc.add_signed(_limbs, _size, _positive);
+}
+
+
+void BigIntView::subtract_from(BigInt& acc) const {
+  if (_limbs == acc._limbs.data()) {
+    acc -= to_bigint();
+    return;
+  }
+  acc.add_signed(_limbs, _size, !_positive);
+}
+
+
+/**
+ * The same dispatch as BigInt::operator*=, with the product built in a new
+ * vector so out can be one of the operands.
+ */
+void BigIntView::multiply_into(const BigIntView& lhs, const BigIntView& rhs, BigInt& out) {
+  if (lhs.is_zero() || rhs.is_zero()) { out = BigInt(0); return; }
+
+  const bool positive = lhs._positive == rhs._positive;
+  mutils::instrument::record(mutils::instrument::HISTOGRAM_MUL_LIMBS, std::max(lhs._size, rhs._size));
+  BigInt::Limbs res;
+  if (lhs._size == 1 || rhs._size == 1) {
+    const BigIntView& small = lhs._size == 1 ? lhs : rhs;
+    const BigIntView& large = lhs._size == 1 ? rhs : lhs;
+    mutils::memory::assign(res, large._limbs, large._limbs + large._size);
+    BigInt::multiply_magnitude_small(res, small._limbs[0]);
+  } else if (lhs._limbs == rhs._limbs && lhs._size == rhs._size) {
+    BigInt::Limbs limbs;
+    mutils::memory::assign(limbs, lhs._limbs, lhs._limbs + lhs._size);
+    res = BigInt::square_magnitude(limbs);
+  } else {
+    res = BigInt::multiply_magnitude(lhs._limbs, lhs._size, rhs._limbs, rhs._size);
+  }
+
+  out._limbs.swap(res);
+  out._positive = positive;
+  out._errors = 0;
+  out.trim();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "bigint.h"
+
+/**
+ * BigIntView class, a read-only BigInt over limbs it does not own, such as a
+ * BigInt or a buffer of serialized values read or mapped from a file.
+ *
+ * BigInt::serialize() writes a value as
+ *
+ *   limb count   4 byte little-endian word
+ *   flags        4 byte little-endian word, bit 0 set if negative
+ *   limbs        limb count 4 byte little-endian words, base 10^9, least
+ *                significant first
+ *
+ * so a view of a serialized value points at its limbs in place and nothing
+ * is parsed or copied. The buffer must outlive the view and stay 4 byte
+ * aligned, which any sequence of serialized values starting on an aligned
+ * address is.
+ *
+ * Compare    - Time O(n)
+ * Add into   - Time O(max(n,m))
+ * Multiply   - Time as BigInt
+ *
+ * Usage:
+ *
+ *   const char* data = buffer;
+ *   BigIntView view;
+ *   while (BigIntView::view(data, buffer + size, view)) { view.add_into(sum); }
+ */
+class BigIntView {
+  private:
+    const uint32_t* _limbs;
+    size_t _size;
+    bool _positive;
+
+  public:
+    // A view of zero
+    BigIntView() noexcept;
+    BigIntView(const BigInt& bint) noexcept
+      : _limbs(bint._limbs.data()), _size(bint._limbs.size()), _positive(bint._positive) {}
+
+    // Points out at the serialized value at data and moves data past it.
+    // False, with data and out untouched, if [data, end) does not start with
+    // a well formed valid value, data is not 4 byte aligned or the host is
+    // not little-endian; BigInt::deserialize() reads those
+    static bool view(const char*& data, const char* end, BigIntView& out);
+
+    bool is_positive() const noexcept { return _positive; }
+    bool is_zero() const noexcept { return _size == 1 && _limbs[0] == 0; }
+    auto size() const noexcept -> size_t { return _size; }
+    auto limbs() const noexcept -> const uint32_t* { return _limbs; }
+    // An owning copy
+    auto to_bigint() const -> BigInt;
+
+    // Negative, zero or positive as lhs is less than, equal to or greater
+    // than rhs
+    static int compare(const BigIntView& lhs, const BigIntView& rhs) noexcept;
+
+    // acc += *this
+    void add_into(BigInt& acc) const;
+    // acc -= *this
+    void subtract_from(BigInt& acc) const;
+    // out = lhs * rhs, out may be viewed by either
+    static void multiply_into(const BigIntView& lhs, const BigIntView& rhs, BigInt& out);
+};
+
+inline
+bool operator==(const BigIntView& lhs, const BigIntView& rhs) {
+  return BigIntView::compare(lhs, rhs) == 0;
+}
+
+inline
+bool operator<(const BigIntView& lhs, const BigIntView& rhs) {
+  return BigIntView::compare(lhs, rhs) < 0;
+}
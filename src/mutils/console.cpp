@@ -0,0 +1,172 @@
+#include "console.h"
+
+#include <cstdio>
+#include <iostream>
+
+#include "output.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+  // Attributes last set, -1 after a reset, so repeating a color is free
+  int current = -1;
+}
+
+
+bool mutils::console::enabled()
+{
+#ifdef _WIN32
+  static const bool tty = _isatty(_fileno(stdout)) != 0;
+#else
+  static const bool tty = isatty(fileno(stdout)) != 0;
+#endif
+  return tty;
+}
+
+
+#ifdef _WIN32
+
+void mutils::console::set_color(unsigned char attributes)
+{
+  if (!enabled() || current == attributes) { return; }
+  current = attributes;
+  std::cout.flush();
+  SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), attributes);
+}
+
+
+void mutils::console::reset_color()
+{
+  set_color(WHITE);
+}
+
+
+void mutils::console::set_color(OutputSink& sink, unsigned char attributes)
+{
+  if (!enabled() || current == attributes) { return; }
+  sink.flush();
+  set_color(attributes);
+}
+
+
+void mutils::console::reset_color(OutputSink& sink)
+{
+  set_color(sink, WHITE);
+}
+
+
+// Ref: https://docs.microsoft.com/en-us/windows/console/clearing-the-screen
+void mutils::console::clear()
+{
+  if (!enabled()) { return; }
+  std::cout.flush();
+
+  HANDLE hConsole;
+  hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+
+  CONSOLE_SCREEN_BUFFER_INFO csbi;
+  SMALL_RECT scrollRect;
+  COORD scrollTarget;
+  CHAR_INFO fill;
+
+  // Get the number of character cells in the current buffer.
+  if (!GetConsoleScreenBufferInfo(hConsole, &csbi)) {
+    return;
+  }
+
+  // Scroll the rectangle of the entire buffer.
+  scrollRect.Left = 0;
+  scrollRect.Top = 0;
+  scrollRect.Right = csbi.dwSize.X;
+  scrollRect.Bottom = csbi.dwSize.Y;
+
+  // Scroll it upwards off the top of the buffer with a magnitude of the entire height.
+  scrollTarget.X = 0;
+  scrollTarget.Y = (SHORT)(0 - csbi.dwSize.Y);
+
+  // Fill with empty spaces with the buffer's default text attribute.
+  fill.Char.UnicodeChar = TEXT(' ');
+  fill.Attributes = csbi.wAttributes;
+
+  // Do the scroll
+  ScrollConsoleScreenBuffer(hConsole, &scrollRect, NULL, scrollTarget, &fill);
+
+  // Move the cursor to the top left corner too.
+  csbi.dwCursorPosition.X = 0;
+  csbi.dwCursorPosition.Y = 0;
+
+  SetConsoleCursorPosition(hConsole, csbi.dwCursorPosition);
+}
+
+#else
+
+namespace {
+  // Win32 orders the color bits blue, green, red and ANSI red, green, blue
+  int ansi_color(unsigned int nibble)
+  {
+    return (int)(((nibble & 1) << 2) | (nibble & 2) | ((nibble >> 2) & 1));
+  }
+
+  // The SGR sequence for attributes, returns its length
+  int sequence(unsigned char attributes, char* out, size_t size)
+  {
+    const unsigned int fg = attributes & 0xFu;
+    const unsigned int bg = attributes >> 4;
+    const int fgCode = (fg & 8 ? 90 : 30) + ansi_color(fg);
+    const int bgCode = bg == 0 ? 49 : (bg & 8 ? 100 : 40) + ansi_color(bg);
+    return std::snprintf(out, size, "\033[%d;%dm", fgCode, bgCode);
+  }
+
+  const char RESET[] = "\033[0m";
+}
+
+
+void mutils::console::set_color(unsigned char attributes)
+{
+  if (!enabled() || current == attributes) { return; }
+  current = attributes;
+
+  char code[16];
+  std::cout.write(code, sequence(attributes, code, sizeof(code)));
+}
+
+
+void mutils::console::reset_color()
+{
+  if (enabled() && current != -1) {
+    current = -1;
+    std::cout << RESET;
+  }
+}
+
+
+void mutils::console::set_color(OutputSink& sink, unsigned char attributes)
+{
+  if (!enabled() || current == attributes) { return; }
+  current = attributes;
+
+  char code[16];
+  sink.text(code, (size_t)sequence(attributes, code, sizeof(code)));
+}
+
+
+void mutils::console::reset_color(OutputSink& sink)
+{
+  if (enabled() && current != -1) {
+    current = -1;
+    sink.text(RESET, sizeof(RESET) - 1);
+  }
+}
+
+
+void mutils::console::clear()
+{
+  if (enabled()) { std::cout << "\033[2J\033[H" << std::flush; }
+}
+
+#endif
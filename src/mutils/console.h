@@ -0,0 +1,41 @@
+#pragma once
+
+namespace mutils {
+
+  class OutputSink;
+
+  /**
+   * Console colors and screen clearing, with a Win32 console API backend on
+   * Windows and ANSI escape sequences everywhere else.
+   *
+   * Colors are Win32 text attributes on both backends: the low four bits are
+   * the foreground and the high four the background, each as intensity, red,
+   * green and blue bits from high to low. The ANSI backend maps them to the
+   * 16 color SGR codes, with background 0 as the terminal's own background.
+   *
+   * Nothing is written unless stdout is a terminal, so redirected or piped
+   * output stays plain text and never pays for the color changes.
+   */
+  namespace console {
+
+    enum Color : unsigned char {
+      BLACK = 0,
+      GRAY = 8,
+      GREEN = 10,
+      WHITE = 15,
+    };
+
+    // True if stdout is a terminal, checked once
+    bool enabled();
+
+    // Colors the text printed through std::cout from here on
+    void set_color(unsigned char attributes);
+    // Back to the default colors
+    void reset_color();
+    // The same for text going through sink, in order with what it holds
+    void set_color(OutputSink& sink, unsigned char attributes);
+    void reset_color(OutputSink& sink);
+    // Clears the screen and moves the cursor to the top left corner
+    void clear();
+  }
+}
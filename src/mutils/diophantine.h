@@ -0,0 +1,239 @@
+#pragma once
+
+#include "bigint.h"
+
+namespace mutils {
+
+  namespace detail {
+    // Truncating division for built-in integers and BigInt alike (BigInt's
+    // operator/ rounds, BigInt::divmod truncates)
+    template<typename T>
+      void divmod(const T& lhs, const T& rhs, T& quotient, T& remainder)
+      {
+        quotient = lhs / rhs;
+        remainder = lhs % rhs;
+      }
+
+    inline
+    void divmod(const BigInt& lhs, const BigInt& rhs, BigInt& quotient, BigInt& remainder)
+    {
+      BigInt::divmod(lhs, rhs, quotient, remainder);
+    }
+
+    template<typename T>
+      T floor_div(const T& lhs, const T& rhs)
+      {
+        T quotient, remainder;
+        divmod(lhs, rhs, quotient, remainder);
+        if (!(remainder == T(0)) && ((remainder < T(0)) != (rhs < T(0)))) {
+          quotient = quotient - T(1);
+        }
+        return quotient;
+      }
+
+    template<typename T>
+      T ceil_div(const T& lhs, const T& rhs)
+      {
+        return T(0) - floor_div(T(0) - lhs, rhs);
+      }
+
+    // Iterative extended Euclid, g = gcd(a, b) >= 0 with ax + by = g
+    template<typename T>
+      void extended_gcd(const T& a, const T& b, T& g, T& x, T& y)
+      {
+        T r0 = a, r1 = b;
+        T x0 = T(1), x1 = T(0);
+        T y0 = T(0), y1 = T(1);
+        T quotient, remainder;
+
+        while (!(r1 == T(0))) {
+          divmod(r0, r1, quotient, remainder);
+          r0 = r1;
+          r1 = remainder;
+          T next = x0 - quotient * x1;
+          x0 = x1;
+          x1 = next;
+          next = y0 - quotient * y1;
+          y0 = y1;
+          y1 = next;
+        }
+
+        if (r0 < T(0)) {
+          r0 = T(0) - r0;
+          x0 = T(0) - x0;
+          y0 = T(0) - y0;
+        }
+        g = r0;
+        x = x0;
+        y = y0;
+      }
+  }
+
+  /**
+   * LinearDiophantine class that solves ax + by = c over the integers for T
+   * in long long, __int128 or BigInt.
+   *
+   * The equation has solutions iff g = gcd(a, b) divides c, and then every
+   * solution is (x0 + k step_x(), y0 + k step_y()) for an integer k, with
+   * step_x() = b/g >= 0 and step_y() = -a/g. The particular solution can
+   * be far larger than a, b and c, pick a wider T if it may not fit.
+   *
+   * k_range() gives the k for solutions inside a box, and the non-negative
+   * solutions (coin change counts for a, b > 0) are counted in O(1) or
+   * streamed in O(1) additions each.
+   *
+   * With a = b = 0 every pair solves 0 = 0, this is reported as solvable
+   * with both steps 0, infinitely many non-negative solutions and nothing
+   * to stream.
+   *
+   * Usage:
+   *
+   *   mutils::LinearDiophantine<long long> eq(3, 5, 100);
+   *   long long ways = eq.count_nonnegative();
+   *   eq.for_each_nonnegative([](long long x, long long y) { ...; return true; });
+   */
+  template<typename T>
+    class LinearDiophantine {
+      private:
+        T _gcd;
+        T _x0;
+        T _y0;
+        T _dx;
+        T _dy;
+        bool _solvable = false;
+
+        bool degenerate() const { return _dx == T(0) && _dy == T(0); }
+
+        // Intersects [kMin, kMax] with lo <= v0 + k step <= hi
+        static bool clamp(const T& v0, const T& step, const T& lo, const T& hi,
+                          T& kMin, T& kMax)
+        {
+          if (step == T(0)) { return !(v0 < lo) && !(hi < v0); }
+          T low = T(0) < step ? detail::ceil_div(lo - v0, step) : detail::ceil_div(hi - v0, step);
+          T high = T(0) < step ? detail::floor_div(hi - v0, step) : detail::floor_div(lo - v0, step);
+          if (kMin < low) { kMin = low; }
+          if (high < kMax) { kMax = high; }
+          return !(kMax < kMin);
+        }
+
+        // k with x, y >= 0. bounded is false if there is no upper limit on k.
+        bool nonnegative_range(T& kMin, T& kMax, bool& bounded) const
+        {
+          bounded = false;
+          kMin = T(0);
+          kMax = T(0);
+          if (!_solvable || degenerate()) { return _solvable; }
+
+          // After normalization step_x >= 0, and it is 0 only if b = 0
+          if (_dx == T(0)) {
+            if (_x0 < T(0)) { return false; }
+            kMin = detail::ceil_div(T(0) - _y0, _dy);
+            return true;
+          }
+
+          kMin = detail::ceil_div(T(0) - _x0, _dx);
+          if (T(0) < _dy) {
+            T yLow = detail::ceil_div(T(0) - _y0, _dy);
+            if (kMin < yLow) { kMin = yLow; }
+          } else if (_dy < T(0)) {
+            bounded = true;
+            kMax = detail::floor_div(T(0) - _y0, _dy);
+            return !(kMax < kMin);
+          } else if (_y0 < T(0)) {
+            return false;
+          }
+          return true;
+        }
+
+      public:
+        LinearDiophantine(const T& a, const T& b, const T& c)
+          : _gcd(0), _x0(0), _y0(0), _dx(0), _dy(0)
+        {
+          if (a == T(0) && b == T(0)) {
+            _solvable = c == T(0);
+            return;
+          }
+
+          T x, y, quotient, remainder;
+          detail::extended_gcd(a, b, _gcd, x, y);
+          detail::divmod(c, _gcd, quotient, remainder);
+          if (!(remainder == T(0))) { return; }
+
+          _solvable = true;
+          _x0 = x * quotient;
+          _y0 = y * quotient;
+          detail::divmod(b, _gcd, _dx, remainder);
+          detail::divmod(T(0) - a, _gcd, _dy, remainder);
+          if (_dx < T(0) || (_dx == T(0) && _dy < T(0))) {
+            _dx = T(0) - _dx;
+            _dy = T(0) - _dy;
+          }
+        }
+
+        bool solvable() const noexcept { return _solvable; }
+        auto gcd() const noexcept -> const T& { return _gcd; }
+        auto x0() const noexcept -> const T& { return _x0; }
+        auto y0() const noexcept -> const T& { return _y0; }
+        auto step_x() const noexcept -> const T& { return _dx; }
+        auto step_y() const noexcept -> const T& { return _dy; }
+
+        void solution(const T& k, T& x, T& y) const
+        {
+          x = _x0 + k * _dx;
+          y = _y0 + k * _dy;
+        }
+
+        /**
+         * The k whose solutions lie in xMin <= x <= xMax and yMin <= y <= yMax.
+         * Returns false if there are none.
+         */
+        bool k_range(const T& xMin, const T& xMax, const T& yMin, const T& yMax,
+                     T& kMin, T& kMax) const
+        {
+          if (!_solvable) { return false; }
+          if (degenerate()) {
+            // Any pair solves 0 = 0, report the box corner
+            kMin = kMax = T(0);
+            return !(xMax < xMin) && !(yMax < yMin);
+          }
+
+          // step_x > 0, or step_x = 0 and step_y > 0, gives both limits
+          kMin = _dx == T(0) ? detail::ceil_div(yMin - _y0, _dy) : detail::ceil_div(xMin - _x0, _dx);
+          kMax = _dx == T(0) ? detail::floor_div(yMax - _y0, _dy) : detail::floor_div(xMax - _x0, _dx);
+          return clamp(_x0, _dx, xMin, xMax, kMin, kMax) &&
+                 clamp(_y0, _dy, yMin, yMax, kMin, kMax);
+        }
+
+        // Number of solutions with x, y >= 0, or -1 if there are infinitely many
+        auto count_nonnegative() const -> T
+        {
+          T kMin, kMax;
+          bool bounded;
+          if (!nonnegative_range(kMin, kMax, bounded)) { return T(0); }
+          if (!bounded) { return T(-1); }
+          return kMax - kMin + T(1);
+        }
+
+        /**
+         * Calls visit(x, y) for the solutions with x, y >= 0 in increasing x
+         * (increasing y when b = 0) until visit returns false. Each step
+         * after the first is two additions.
+         */
+        template<typename Visit>
+          void for_each_nonnegative(Visit visit) const
+          {
+            T kMin, kMax;
+            bool bounded;
+            if (!nonnegative_range(kMin, kMax, bounded) || degenerate()) { return; }
+
+            T x, y;
+            solution(kMin, x, y);
+            for (T k = kMin; !bounded || !(kMax < k); k = k + T(1)) {
+              if (!visit(x, y)) { return; }
+              x = x + _dx;
+              y = y + _dy;
+            }
+          }
+    };
+
+}
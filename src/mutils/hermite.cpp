@@ -0,0 +1,938 @@
+#include "hermite.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "utils.h"
+
+namespace {
+  using mutils::CompactInt;
+  using Column = std::vector<CompactInt>;
+  using Matrix = std::vector<std::vector<long long>>;
+  __extension__ typedef __int128 Wide;
+  __extension__ typedef unsigned __int128 UnsignedWide;
+
+  // Primes stay below 10^9 so a residue is one BigInt limb and a product of
+  // two fits 64 bits with room for a sum
+  const uint64_t PRIME_LIMIT = 1000000000;
+
+  auto pow_mod(uint64_t base, uint64_t exp, uint64_t mod) -> uint64_t
+  {
+    uint64_t result = 1;
+    base %= mod;
+    while (exp > 0) {
+      if (exp & 1) { result = result * base % mod; }
+      base = base * base % mod;
+      exp >>= 1;
+    }
+    return result;
+  }
+
+  // Miller-Rabin with bases 2, 3, 5 and 7 is exact below 3.2 * 10^9
+  const uint64_t WITNESSES[] = {2, 3, 5, 7};
+
+  bool is_prime(uint64_t n)
+  {
+    if (n < 2) { return false; }
+    for (uint64_t p : WITNESSES) {
+      if (n % p == 0) { return n == p; }
+    }
+    uint64_t odd = n - 1;
+    int twos = 0;
+    while (odd % 2 == 0) { odd /= 2; ++twos; }
+    for (uint64_t base : WITNESSES) {
+      uint64_t x = pow_mod(base, odd, n);
+      if (x == 1 || x == n - 1) { continue; }
+      bool composite = true;
+      for (int i = 1; i < twos && composite; ++i) {
+        x = x * x % n;
+        if (x == n - 1) { composite = false; }
+      }
+      if (composite) { return false; }
+    }
+    return true;
+  }
+
+  auto prime_below(uint64_t n) -> uint64_t
+  {
+    do { --n; } while (!is_prime(n));
+    return n;
+  }
+
+  /**
+   * Arithmetic modulo a prime below 10^9. The elimination loops are mostly
+   * remainders, so they use Barrett reduction with a precomputed 2^64 / p
+   * instead of a division.
+   */
+  struct Modulus {
+    uint64_t p;
+    uint64_t barrett;
+
+    explicit Modulus(uint64_t prime) : p(prime), barrett(~0ULL / prime) {}
+
+    // x mod p, the quotient estimate is at most two short
+    auto reduce(uint64_t x) const -> uint64_t
+    {
+      uint64_t quotient = (uint64_t)(((UnsignedWide)x * barrett) >> 64);
+      uint64_t rest = x - quotient * p;
+      while (rest >= p) { rest -= p; }
+      return rest;
+    }
+    auto mul(uint64_t a, uint64_t b) const -> uint64_t { return reduce(a * b); }
+    auto inverse(uint64_t a) const -> uint64_t { return pow_mod(a, p - 2, p); }
+    auto residue(long long x) const -> uint64_t
+    {
+      long long rest = x % (long long)p;
+      return (uint64_t)(rest < 0 ? rest + (long long)p : rest);
+    }
+    auto residue(Wide x) const -> uint64_t
+    {
+      Wide rest = x % (Wide)p;
+      return (uint64_t)(rest < 0 ? rest + (Wide)p : rest);
+    }
+  };
+
+  auto residue(const BigInt& value, uint64_t p) -> uint64_t
+  {
+    BigInt quotient, remainder;
+    BigInt::divmod(value, BigInt(p), quotient, remainder);
+    long long rest = std::stoll(remainder.to_string());
+    return (uint64_t)(rest < 0 ? rest + (long long)p : rest);
+  }
+
+  struct Profile {
+    std::vector<size_t> rows;  // rows independent of the rows above them
+    std::vector<size_t> cols;  // a pivot column for each of them
+
+    Profile() : rows(), cols() {}
+  };
+
+  /**
+   * Row echelon form modulo p, one row at a time. Each row is reduced by the
+   * earlier independent rows, and if anything is left it pivots on its
+   * first (or last) non-zero column. The pivot columns of the rows make a
+   * square block that is invertible modulo p.
+   */
+  auto rank_profile(const Matrix& matrix, size_t cols, const Modulus& mod, bool lastColumn) -> Profile
+  {
+    Profile profile;
+    std::vector<std::vector<uint64_t>> echelon;
+    std::vector<uint64_t> row(cols);
+    for (size_t i = 0; i < matrix.size(); ++i) {
+      for (size_t j = 0; j < cols; ++j) { row[j] = mod.residue(matrix[i][j]); }
+      for (size_t k = 0; k < echelon.size(); ++k) {
+        const uint64_t factor = row[profile.cols[k]];
+        if (factor == 0) { continue; }
+        const uint64_t negated = mod.p - factor;
+        for (size_t j = 0; j < cols; ++j) {
+          if (echelon[k][j] != 0) { row[j] = mod.reduce(row[j] + negated * echelon[k][j]); }
+        }
+      }
+
+      size_t pivot = cols;
+      for (size_t j = 0; j < cols; ++j) {
+        if (row[j] != 0) {
+          pivot = j;
+          if (!lastColumn) { break; }
+        }
+      }
+      if (pivot == cols) { continue; }
+
+      const uint64_t inverse = mod.inverse(row[pivot]);
+      for (uint64_t& value : row) { value = mod.mul(value, inverse); }
+      echelon.push_back(row);
+      profile.rows.push_back(i);
+      profile.cols.push_back(pivot);
+    }
+    std::sort(profile.cols.begin(), profile.cols.end());
+    return profile;
+  }
+
+  auto submatrix(const Matrix& matrix, const std::vector<size_t>& rows,
+                 const std::vector<size_t>& cols) -> Matrix
+  {
+    Matrix result(rows.size(), std::vector<long long>(cols.size()));
+    for (size_t i = 0; i < rows.size(); ++i) {
+      for (size_t j = 0; j < cols.size(); ++j) { result[i][j] = matrix[rows[i]][cols[j]]; }
+    }
+    return result;
+  }
+
+  auto transpose(const Matrix& square) -> Matrix
+  {
+    Matrix result(square.size(), std::vector<long long>(square.size()));
+    for (size_t i = 0; i < square.size(); ++i) {
+      for (size_t j = 0; j < square.size(); ++j) { result[j][i] = square[i][j]; }
+    }
+    return result;
+  }
+
+  // log2 of the Euclidean norm, 0 for the zero vector
+  auto log2_norm(const std::vector<long long>& vec) -> double
+  {
+    long double sum = 0;
+    for (long long value : vec) { sum += (long double)value * (long double)value; }
+    return sum > 1 ? (double)(0.5L * std::log2(sum)) : 0.0;
+  }
+
+  // Bits of the Hadamard bound on det(square), the product of its column
+  // norms, and of its smallest column norm. A minor with one column replaced
+  // by y is below total - smallest + log2 |y| bits.
+  auto hadamard_bits(const Matrix& square, double& smallest) -> double
+  {
+    double total = 0;
+    smallest = 0;
+    const Matrix columns = transpose(square);
+    for (size_t j = 0; j < columns.size(); ++j) {
+      const double bits = log2_norm(columns[j]);
+      total += bits;
+      smallest = j == 0 ? bits : std::min(smallest, bits);
+    }
+    return total;
+  }
+
+  struct ModularLU {
+    std::vector<uint64_t> lu;        // row major, L below the unit diagonal
+    std::vector<uint64_t> inverses;  // of the diagonal of U
+    std::vector<size_t> order;       // row of the square at each position
+
+    ModularLU() : lu(), inverses(), order() {}
+  };
+
+  // Gaussian elimination modulo p, the determinant modulo p and optionally
+  // the LU factors of the row permuted square
+  auto eliminate(const Matrix& square, const Modulus& mod, ModularLU* factors) -> uint64_t
+  {
+    const size_t n = square.size();
+    std::vector<uint64_t> a(n * n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) { a[i * n + j] = mod.residue(square[i][j]); }
+    }
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<uint64_t> inverses(n);
+
+    uint64_t det = 1;
+    for (size_t k = 0; k < n; ++k) {
+      size_t pivot = k;
+      while (pivot < n && a[pivot * n + k] == 0) { ++pivot; }
+      if (pivot == n) { return 0; }
+      if (pivot != k) {
+        std::swap_ranges(a.begin() + (std::ptrdiff_t)(k * n), a.begin() + (std::ptrdiff_t)((k + 1) * n),
+                         a.begin() + (std::ptrdiff_t)(pivot * n));
+        std::swap(order[k], order[pivot]);
+        det = mod.p - det;
+      }
+      det = mod.mul(det, a[k * n + k]);
+      inverses[k] = mod.inverse(a[k * n + k]);
+
+      const uint64_t* top = &a[k * n];
+      for (size_t i = k + 1; i < n; ++i) {
+        uint64_t* current = &a[i * n];
+        if (current[k] == 0) { continue; }
+        current[k] = mod.mul(current[k], inverses[k]);
+        const uint64_t negated = mod.p - current[k];
+        for (size_t j = k + 1; j < n; ++j) {
+          current[j] = mod.reduce(current[j] + negated * top[j]);
+        }
+      }
+    }
+
+    if (factors) {
+      factors->lu = std::move(a);
+      factors->inverses = std::move(inverses);
+      factors->order = std::move(order);
+    }
+    return det;
+  }
+
+  // sum of a[j] b[j] modulo p, reduced every eight terms as each is below 2^60
+  auto dot_mod(const uint64_t* a, const uint64_t* b, size_t count, const Modulus& mod) -> uint64_t
+  {
+    uint64_t sum = 0;
+    for (size_t j = 0; j < count;) {
+      const size_t stop = std::min(count, j + 8);
+      for (; j < stop; ++j) { sum += a[j] * b[j]; }
+      sum = mod.reduce(sum);
+    }
+    return sum;
+  }
+
+  // Solves square x = rhs modulo p in place
+  void solve_mod(const ModularLU& factors, const Modulus& mod, std::vector<uint64_t>& rhs)
+  {
+    const size_t n = factors.order.size();
+    std::vector<uint64_t> x(n);
+    for (size_t i = 0; i < n; ++i) {
+      const uint64_t lower = dot_mod(&factors.lu[i * n], x.data(), i, mod);
+      x[i] = mod.reduce(rhs[factors.order[i]] + mod.p - lower);
+    }
+    for (size_t i = n; i-- > 0;) {
+      const uint64_t upper = dot_mod(&factors.lu[i * n + i + 1], &x[i + 1], n - i - 1, mod);
+      x[i] = mod.mul(mod.reduce(x[i] + mod.p - upper), factors.inverses[i]);
+    }
+    rhs = std::move(x);
+  }
+
+  // value mod product in (-product/2, product/2]
+  void symmetric(BigInt& value, const BigInt& product)
+  {
+    BigInt quotient, remainder;
+    BigInt::divmod(value, product, quotient, remainder);
+    if (!remainder.is_positive()) { remainder += product; }
+    BigInt twice = remainder;
+    twice += remainder;
+    if (product < twice) { remainder -= product; }
+    value = std::move(remainder);
+  }
+
+  // det(square) from its residues modulo primes whose product passes twice
+  // the Hadamard bound
+  auto determinant(const Matrix& square) -> BigInt
+  {
+    double smallest;
+    double bits = hadamard_bits(square, smallest) + 1;
+
+    BigInt value(0), product(1);
+    uint64_t p = PRIME_LIMIT;
+    do {
+      p = prime_below(p);
+      const Modulus mod(p);
+      const uint64_t target = eliminate(square, mod, nullptr);
+      const uint64_t current = residue(value, p);
+      const uint64_t step = mod.mul(mod.reduce(target + p - current), mod.inverse(residue(product, p)));
+      value.add_mul(product, (long long)step);
+      product *= BigInt(p);
+      bits -= std::log2((double)p);
+    } while (bits > -1);
+
+    symmetric(value, product);
+    return value;
+  }
+
+  // The p-adic digits of the solution of square z = residual, residual is
+  // (rhs - square z) / p^j after digit j
+  template<typename T>
+    void lift_digits(const Matrix& square, const ModularLU& factors, const Modulus& mod,
+                     std::vector<T> residual, std::vector<std::vector<uint64_t>>& digits)
+    {
+      const size_t n = square.size();
+      for (std::vector<uint64_t>& digit : digits) {
+        for (size_t i = 0; i < n; ++i) { digit[i] = mod.residue(residual[i]); }
+        solve_mod(factors, mod, digit);
+        for (size_t i = 0; i < n; ++i) {
+          T value = residual[i];
+          const long long* row = square[i].data();
+          for (size_t j = 0; j < n; ++j) { value -= (T)row[j] * (T)digit[j]; }
+          residual[i] = value / (T)mod.p;
+        }
+      }
+    }
+
+  /**
+   * adj(square) rhs by p-adic lifting. The digits of z with square z = rhs
+   * modulo p^k come one at a time from residuals that stay as small as
+   * square and rhs, so they usually fit 64 bits and otherwise 128. det z is
+   * adj(square) rhs modulo p^k, and k is taken so p^k passes twice 2^bits.
+   */
+  auto adjugate_times(const Matrix& square, const ModularLU& factors, const Modulus& mod,
+                      const BigInt& det, const std::vector<long long>& rhs, double bits) -> std::vector<BigInt>
+  {
+    const size_t n = square.size();
+    const size_t steps = (size_t)std::ceil((bits + 2) / std::log2((double)mod.p));
+    std::vector<std::vector<uint64_t>> digits(steps, std::vector<uint64_t>(n));
+
+    // |residual| stays below |rhs| + n max |square| p
+    long double largest = 0, largestRhs = 0;
+    for (const auto& row : square) {
+      for (long long value : row) { largest = std::max(largest, std::fabs((long double)value)); }
+    }
+    for (long long value : rhs) { largestRhs = std::max(largestRhs, std::fabs((long double)value)); }
+    if (largestRhs + largest * (long double)n * (long double)mod.p < 4e18L) {
+      lift_digits(square, factors, mod, rhs, digits);
+    } else {
+      lift_digits(square, factors, mod, std::vector<Wide>(rhs.begin(), rhs.end()), digits);
+    }
+
+    BigInt power(1);
+    for (size_t step = 0; step < steps; ++step) { power *= BigInt(mod.p); }
+
+    std::vector<BigInt> result(n);
+    for (size_t i = 0; i < n; ++i) {
+      BigInt z(0);
+      for (size_t step = steps; step-- > 0;) {
+        BigInt next(digits[step][i]);
+        next.add_mul(z, (long long)mod.p);
+        z = std::move(next);
+      }
+      result[i] = det * z;
+      symmetric(result[i], power);
+    }
+    return result;
+  }
+
+  auto equals_one(const CompactInt& value) -> bool
+  {
+    return value.is_small() && value.small_value() == 1;
+  }
+
+  // value mod modulus in [0, modulus)
+  void reduce_mod(CompactInt& value, const CompactInt& modulus)
+  {
+    if (value.sign() >= 0 && CompactInt::abs_less(value, modulus)) { return; }
+    CompactInt quotient, remainder;
+    CompactInt::divmod(value, modulus, quotient, remainder);
+    if (remainder.sign() < 0) { remainder.submul(CompactInt(-1), modulus); }
+    value = std::move(remainder);
+  }
+
+  // g = gcd(a, b) = sa + tb with g >= 0
+  void extended_gcd(const CompactInt& a, const CompactInt& b, CompactInt& g, CompactInt& s, CompactInt& t)
+  {
+    if (a.is_small() && b.is_small() && a.small_value() != LLONG_MIN && b.small_value() != LLONG_MIN) {
+      long long gcd, x, y;
+      mutils::detail::extended_gcd(a.small_value(), b.small_value(), gcd, x, y);
+      g = gcd;
+      s = x;
+      t = y;
+      return;
+    }
+    auto result = mutils::extended_lehmer_gcd(a.to_bigint(), b.to_bigint());
+    g = std::get<0>(result);
+    s = std::get<1>(result);
+    t = std::get<2>(result);
+  }
+
+  // q with r = lhs - q rhs in [0, rhs) for rhs > 0
+  auto floor_quotient(const CompactInt& lhs, const CompactInt& rhs) -> CompactInt
+  {
+    CompactInt quotient, remainder;
+    CompactInt::divmod(lhs, rhs, quotient, remainder);
+    if (remainder.sign() < 0) { quotient.submul(CompactInt(1), CompactInt(1)); }
+    return quotient;
+  }
+
+  // column -= factor * pivot from index from on, then modulo modulus unless
+  // it is zero
+  void subtract_multiple(Column& column, const CompactInt& factor, const Column& pivot, size_t from,
+                         const CompactInt& modulus)
+  {
+    for (size_t i = from; i < column.size(); ++i) {
+      if (pivot[i].is_zero()) { continue; }
+      column[i].submul(factor, pivot[i]);
+      if (!modulus.is_zero()) { reduce_mod(column[i], modulus); }
+    }
+  }
+
+  // column *= factor modulo modulus from index from on
+  void scale(Column& column, const CompactInt& factor, size_t from, const CompactInt& modulus)
+  {
+    CompactInt negated = factor;
+    negated.negate();
+    for (size_t i = from; i < column.size(); ++i) {
+      if (column[i].is_zero()) { continue; }
+      CompactInt product;
+      product.submul(negated, column[i]);
+      reduce_mod(product, modulus);
+      column[i] = std::move(product);
+    }
+  }
+
+  // (first, second) = (s first + t second, u second - v first) modulo
+  // modulus from index from on, unimodular when su + tv = 1
+  void combine(Column& first, Column& second, const CompactInt& s, const CompactInt& t,
+               const CompactInt& u, const CompactInt& v, size_t from, const CompactInt& modulus)
+  {
+    CompactInt negS = s, negT = t, negU = u;
+    negS.negate();
+    negT.negate();
+    negU.negate();
+    for (size_t i = from; i < first.size(); ++i) {
+      if (first[i].is_zero() && second[i].is_zero()) { continue; }
+      CompactInt left, right;
+      left.submul(negS, first[i]);
+      left.submul(negT, second[i]);
+      right.submul(negU, second[i]);
+      right.submul(v, first[i]);
+      reduce_mod(left, modulus);
+      reduce_mod(right, modulus);
+      first[i] = std::move(left);
+      second[i] = std::move(right);
+    }
+  }
+
+  /**
+   * Column echelon form modulo modulus of the lattice spanned by columns and
+   * modulus times each unit vector, over their first rows entries. Entries
+   * after those are carried along, also modulo modulus. pivots gets one
+   * column per row with a positive pivot dividing modulus, and what is left
+   * in columns is zero in those rows.
+   *
+   * A row's pivot takes in its own multiple of the unit vector first, so it
+   * is usually 1 and the other columns only lose a multiple of it.
+   */
+  void echelon_mod(std::vector<Column>& columns, size_t rows, size_t length,
+                   const CompactInt& modulus, std::vector<Column>& pivots)
+  {
+    for (size_t row = 0; row < rows; ++row) {
+      size_t best = columns.size();
+      for (size_t j = 0; j < columns.size(); ++j) {
+        const CompactInt& entry = columns[j][row];
+        if (!entry.is_zero() &&
+            (best == columns.size() || CompactInt::abs_less(entry, columns[best][row]))) {
+          best = j;
+        }
+      }
+      if (best == columns.size()) {
+        Column pivot(length);
+        pivot[row] = modulus;
+        pivots.push_back(std::move(pivot));
+        continue;
+      }
+      std::swap(columns[best], columns.back());
+      Column pivot = std::move(columns.back());
+      columns.pop_back();
+
+      // With g = gcd(entry, modulus) the pivot becomes g and the unit
+      // vector leaves (modulus / g) pivot behind, nothing when g is 1
+      CompactInt g, s, t;
+      extended_gcd(pivot[row], modulus, g, s, t);
+      if (!equals_one(g)) {
+        CompactInt multiple, remainder;
+        CompactInt::divmod(modulus, g, multiple, remainder);
+        Column rest = pivot;
+        rest[row] = CompactInt();
+        scale(rest, multiple, row + 1, modulus);
+        if (std::any_of(rest.begin(), rest.end(), [](const CompactInt& entry) { return !entry.is_zero(); })) {
+          columns.push_back(std::move(rest));
+        }
+      }
+      scale(pivot, s, row + 1, modulus);
+      pivot[row] = g;
+
+      for (Column& column : columns) {
+        if (column[row].is_zero()) { continue; }
+        CompactInt quotient, remainder;
+        CompactInt::divmod(column[row], pivot[row], quotient, remainder);
+        if (remainder.is_zero()) {
+          subtract_multiple(column, quotient, pivot, row + 1, modulus);
+        } else {
+          CompactInt u, v;
+          extended_gcd(pivot[row], column[row], g, s, t);
+          CompactInt::divmod(pivot[row], g, u, remainder);
+          CompactInt::divmod(column[row], g, v, remainder);
+          combine(pivot, column, s, t, u, v, row + 1, modulus);
+          pivot[row] = g;
+        }
+        column[row] = CompactInt();
+      }
+      pivots.push_back(std::move(pivot));
+    }
+  }
+
+  // Entries left of each pivot into [0, pivot), pivots[k] pivoting on row
+  // k. No modulus here, what this adds below a row the later rows reduce.
+  void reduce_left(std::vector<Column>& pivots)
+  {
+    for (size_t k = 0; k < pivots.size(); ++k) {
+      for (size_t j = 0; j < k; ++j) {
+        CompactInt factor = floor_quotient(pivots[j][k], pivots[k][k]);
+        if (!factor.is_zero()) { subtract_multiple(pivots[j], factor, pivots[k], k, CompactInt()); }
+      }
+    }
+  }
+}
+
+
+/*
+ *
+ * CompactInt
+ *
+ */
+
+mutils::CompactInt& mutils::CompactInt::operator=(const CompactInt& other)
+{
+  if (this != &other) {
+    _small = other._small;
+    _big.reset(other._big ? new BigInt(*other._big) : nullptr);
+  }
+  return *this;
+}
+
+
+// Values below 10^18 in magnitude always fit, larger ones stay BigInt
+void mutils::CompactInt::assign(BigInt&& value)
+{
+  if (value.digit_count() <= 18) {
+    _small = std::stoll(value.to_string());
+    _big.reset();
+  } else if (_big) {
+    *_big = std::move(value);
+  } else {
+    _big.reset(new BigInt(std::move(value)));
+  }
+}
+
+
+auto mutils::CompactInt::sign() const noexcept -> int
+{
+  if (_big) { return _big->is_positive() ? 1 : -1; }
+  return (_small > 0) - (_small < 0);
+}
+
+
+auto mutils::CompactInt::to_bigint() const -> BigInt
+{
+  return _big ? *_big : BigInt(_small);
+}
+
+
+void mutils::CompactInt::submul(const CompactInt& factor, const CompactInt& rhs)
+{
+  long long product = 0;
+  const bool smallProduct = !factor._big && !rhs._big &&
+    !__builtin_mul_overflow(factor._small, rhs._small, &product);
+  long long difference;
+  if (smallProduct && !_big && !__builtin_sub_overflow(_small, product, &difference)) {
+    _small = difference;
+    return;
+  }
+
+  // A big value times a factor below a limb is the common slow case, it is
+  // fused in place
+  const BigInt* big = nullptr;
+  long long scale = 0;
+  if (factor._big && !rhs._big && rhs._small > -1000000000LL && rhs._small < 1000000000LL) {
+    big = factor._big.get();
+    scale = rhs._small;
+  } else if (rhs._big && !factor._big && factor._small > -1000000000LL && factor._small < 1000000000LL) {
+    big = rhs._big.get();
+    scale = factor._small;
+  }
+
+  if (!_big) { _big.reset(new BigInt(_small)); }
+  if (big) {
+    _big->add_mul(*big, -scale);
+  } else if (smallProduct) {
+    *_big -= BigInt(product);
+  } else {
+    *_big -= factor.to_bigint() * rhs.to_bigint();
+  }
+  if (_big->digit_count() <= 18) { assign(std::move(*_big)); }
+}
+
+
+void mutils::CompactInt::negate()
+{
+  if (!_big && _small != LLONG_MIN) {
+    _small = -_small;
+    return;
+  }
+  assign(BigInt(0) - to_bigint());
+}
+
+
+void mutils::CompactInt::divmod(const CompactInt& lhs, const CompactInt& rhs,
+                                CompactInt& quotient, CompactInt& remainder)
+{
+  if (!lhs._big && !rhs._big && !(lhs._small == LLONG_MIN && rhs._small == -1)) {
+    long long q = lhs._small / rhs._small;
+    long long r = lhs._small % rhs._small;
+    quotient = q;
+    remainder = r;
+    return;
+  }
+
+  BigInt q, r;
+  BigInt::divmod(lhs.to_bigint(), rhs.to_bigint(), q, r);
+  quotient.assign(std::move(q));
+  remainder.assign(std::move(r));
+}
+
+
+bool mutils::CompactInt::abs_less(const CompactInt& lhs, const CompactInt& rhs)
+{
+  if (!lhs._big && !rhs._big) {
+    // Magnitudes as unsigned so LLONG_MIN is fine
+    unsigned long long left = lhs._small < 0 ? 0ULL - (unsigned long long)lhs._small : (unsigned long long)lhs._small;
+    unsigned long long right = rhs._small < 0 ? 0ULL - (unsigned long long)rhs._small : (unsigned long long)rhs._small;
+    return left < right;
+  }
+  return BigInt::abs(lhs.to_bigint()) < BigInt::abs(rhs.to_bigint());
+}
+
+
+/*
+ *
+ * HermiteNormalForm
+ *
+ */
+
+mutils::HermiteNormalForm::HermiteNormalForm(const std::vector<std::vector<long long>>& matrix)
+  : _matrix(matrix), _independent(), _basis(), _free(), _square(), _prime(0), _det(1),
+    _adjugateFree(), _congruence(), _lattice()
+{
+  // Short rows read as zero padded
+  size_t width = 0;
+  for (const auto& row : _matrix) { width = std::max(width, row.size()); }
+  for (auto& row : _matrix) { row.resize(width); }
+
+  const uint64_t first = prime_below(PRIME_LIMIT);
+  const uint64_t second = prime_below(first);
+  Profile profile = rank_profile(_matrix, width, Modulus(first), false);
+  Profile other = rank_profile(_matrix, width, Modulus(second), false);
+  _prime = first;
+  if (other.rows.size() > profile.rows.size()) {
+    profile = std::move(other);
+    _prime = second;
+  }
+
+  // A prime that divides every r x r minor gives too small a rank, which
+  // spanned() catches exactly. A row outside the span of A_I makes some
+  // (r + 1) x (r + 1) minor non-zero, and the primes below second are tried
+  // until one does not divide it.
+  uint64_t next = second;
+  while (true) {
+    _independent = std::move(profile.rows);
+    _basis = std::move(profile.cols);
+    _free.clear();
+    for (size_t j = 0, k = 0; j < width; ++j) {
+      if (k < _basis.size() && _basis[k] == j) {
+        ++k;
+      } else {
+        _free.push_back(j);
+      }
+    }
+    _square = submatrix(_matrix, _independent, _basis);
+    _det = determinant(_square);
+
+    const size_t r = rank();
+    const Modulus mod(_prime);
+    ModularLU factors;
+    eliminate(_square, mod, &factors);
+    double smallest;
+    const double bits = hadamard_bits(_square, smallest) - smallest;
+    _adjugateFree.clear();
+    for (size_t j : _free) {
+      std::vector<long long> column(r);
+      for (size_t i = 0; i < r; ++i) { column[i] = _matrix[_independent[i]][j]; }
+      _adjugateFree.push_back(adjugate_times(_square, factors, mod, _det, column, bits + log2_norm(column)));
+    }
+    if (spanned()) { break; }
+
+    do {
+      next = prime_below(next);
+      profile = rank_profile(_matrix, width, Modulus(next), false);
+    } while (profile.rows.size() <= r);
+    _prime = next;
+  }
+
+  const size_t r = rank(), q = _free.size();
+  // adj(B) N modulo |d| stacked on the identity, so the entries below
+  // follow x_N through the column operations
+  const CompactInt modulus(BigInt::abs(_det));
+  std::vector<Column> columns(q, Column(r + q));
+  for (size_t k = 0; k < q; ++k) {
+    for (size_t i = 0; i < r; ++i) {
+      columns[k][i] = CompactInt(_adjugateFree[k][i]);
+      reduce_mod(columns[k][i], modulus);
+    }
+    columns[k][r + k] = 1;
+    reduce_mod(columns[k][r + k], modulus);
+  }
+  echelon_mod(columns, r, r + q, modulus, _congruence);
+
+  // The columns left are zero above, their x_N together with |d| times the
+  // unit vectors span the x_N of the kernel
+  std::vector<Column> lattice;
+  for (Column& column : columns) {
+    lattice.emplace_back(std::make_move_iterator(column.begin() + (std::ptrdiff_t)r),
+                         std::make_move_iterator(column.end()));
+  }
+  echelon_mod(lattice, q, q, modulus, _lattice);
+  reduce_left(_lattice);
+}
+
+
+// Whether every row a outside I is a B^-1 A_I with a_B its entries in the
+// columns of B, that is d a_N = a_B adj(B) N. Then the rank is r exactly.
+bool mutils::HermiteNormalForm::spanned() const
+{
+  std::vector<bool> independent(rows(), false);
+  for (size_t i : _independent) { independent[i] = true; }
+  for (size_t row = 0; row < rows(); ++row) {
+    if (independent[row]) { continue; }
+    const std::vector<long long>& a = _matrix[row];
+    for (size_t k = 0; k < _free.size(); ++k) {
+      BigInt combination(0);
+      for (size_t i = 0; i < rank(); ++i) {
+        if (a[_basis[i]] != 0) { combination += _adjugateFree[k][i] * BigInt(a[_basis[i]]); }
+      }
+      if (combination != _det * BigInt(a[_free[k]])) { return false; }
+    }
+  }
+  return true;
+}
+
+
+// x with x_N = free and x_B = (adjugate - adj(B) N x_N) / d, false if that
+// division is not exact
+bool mutils::HermiteNormalForm::assemble(std::vector<BigInt> adjugate, const Column& free,
+                                         std::vector<BigInt>& x) const
+{
+  x.assign(cols(), BigInt(0));
+  for (size_t k = 0; k < _free.size(); ++k) { x[_free[k]] = free[k].to_bigint(); }
+  for (size_t i = 0; i < rank(); ++i) {
+    BigInt& sum = adjugate[i];
+    for (size_t k = 0; k < _free.size(); ++k) {
+      if (!free[k].is_zero()) { sum -= _adjugateFree[k][i] * x[_free[k]]; }
+    }
+    BigInt quotient, remainder;
+    BigInt::divmod(sum, _det, quotient, remainder);
+    if (!remainder.is_zero()) { return false; }
+    x[_basis[i]] = std::move(quotient);
+  }
+  return true;
+}
+
+
+/**
+ * H of the rows I modulo the gcd of det B and a second r x r minor, taken
+ * from the last pivot columns. Both are multiples of the determinant of
+ * the lattice the columns of A span, and their gcd is usually small.
+ *
+ * A row outside I is c A_I with c = a B^-1 for its entries a in the columns
+ * of B, so its entries of H are (adj(B^T) a)^T H_I / d.
+ */
+auto mutils::HermiteNormalForm::hermite() const -> std::vector<std::vector<BigInt>>
+{
+  const size_t r = rank();
+  std::vector<std::vector<BigInt>> result(rows(), std::vector<BigInt>(r));
+  if (r == 0) { return result; }
+
+  const Profile other = rank_profile(_matrix, cols(), Modulus(_prime), true);
+  const CompactInt modulus(mutils::lehmer_gcd(
+    BigInt::abs(_det), BigInt::abs(determinant(submatrix(_matrix, _independent, other.cols)))));
+
+  std::vector<Column> columns(cols(), Column(r));
+  for (size_t j = 0; j < cols(); ++j) {
+    for (size_t i = 0; i < r; ++i) {
+      columns[j][i] = _matrix[_independent[i]][j];
+      reduce_mod(columns[j][i], modulus);
+    }
+  }
+  std::vector<Column> pivots;
+  echelon_mod(columns, r, r, modulus, pivots);
+  reduce_left(pivots);
+  for (size_t i = 0; i < r; ++i) {
+    for (size_t k = 0; k <= i; ++k) { result[_independent[i]][k] = pivots[k][i].to_bigint(); }
+  }
+  if (rows() == r) { return result; }
+
+  const Matrix transposed = transpose(_square);
+  const Modulus mod(_prime);
+  ModularLU factors;
+  eliminate(transposed, mod, &factors);
+  double smallest;
+  const double bits = hadamard_bits(transposed, smallest) - smallest;
+  for (size_t row = 0, next = 0; row < rows(); ++row) {
+    if (next < r && _independent[next] == row) {
+      ++next;
+      continue;
+    }
+    std::vector<long long> entries(r);
+    for (size_t i = 0; i < r; ++i) { entries[i] = _matrix[row][_basis[i]]; }
+    const std::vector<BigInt> weights =
+      adjugate_times(transposed, factors, mod, _det, entries, bits + log2_norm(entries));
+    for (size_t k = 0; k < r; ++k) {
+      BigInt sum(0), remainder;
+      for (size_t i = k; i < r; ++i) {
+        if (!pivots[k][i].is_zero()) { sum += weights[i] * pivots[k][i].to_bigint(); }
+      }
+      BigInt::divmod(sum, _det, result[row][k], remainder);
+    }
+  }
+  return result;
+}
+
+
+auto mutils::HermiteNormalForm::kernel() const -> std::vector<std::vector<BigInt>>
+{
+  std::vector<std::vector<BigInt>> result(_lattice.size());
+  for (size_t k = 0; k < _lattice.size(); ++k) {
+    assemble(std::vector<BigInt>(rank(), BigInt(0)), _lattice[k], result[k]);
+  }
+  return result;
+}
+
+
+/**
+ * adj(B) b comes from p-adic lifting, the congruence is solved by forward
+ * substitution through its echelon form modulo |d|, and x_N is reduced by
+ * the kernel's Hermite basis into [0, pivot) before x_B is recovered.
+ */
+bool mutils::HermiteNormalForm::solve(const std::vector<long long>& rhs,
+                                      std::vector<BigInt>& solution) const
+{
+  if (rhs.size() != rows()) { return false; }
+  const size_t r = rank(), q = _free.size();
+
+  std::vector<long long> entries(r);
+  for (size_t i = 0; i < r; ++i) { entries[i] = rhs[_independent[i]]; }
+  const Modulus mod(_prime);
+  ModularLU factors;
+  eliminate(_square, mod, &factors);
+  double smallest;
+  const double bits = hadamard_bits(_square, smallest) - smallest + log2_norm(entries);
+  std::vector<BigInt> adjugate = adjugate_times(_square, factors, mod, _det, entries, bits);
+
+  // The entries below collect -x_N
+  const CompactInt modulus(BigInt::abs(_det));
+  Column state(r + q);
+  for (size_t i = 0; i < r; ++i) {
+    state[i] = CompactInt(adjugate[i]);
+    reduce_mod(state[i], modulus);
+  }
+  for (size_t row = 0; row < r; ++row) {
+    if (state[row].is_zero()) { continue; }
+    CompactInt quotient, remainder;
+    CompactInt::divmod(state[row], _congruence[row][row], quotient, remainder);
+    if (!remainder.is_zero()) { return false; }
+    subtract_multiple(state, quotient, _congruence[row], row, modulus);
+  }
+
+  Column free(state.begin() + (std::ptrdiff_t)r, state.end());
+  for (CompactInt& entry : free) {
+    entry.negate();
+    reduce_mod(entry, modulus);
+  }
+  for (size_t k = 0; k < q; ++k) {
+    CompactInt factor = floor_quotient(free[k], _lattice[k][k]);
+    if (!factor.is_zero()) { subtract_multiple(free, factor, _lattice[k], k, CompactInt()); }
+  }
+
+  std::vector<BigInt> x;
+  if (!assemble(std::move(adjugate), free, x)) { return false; }
+
+  // Rows outside I are rational combinations of the rows in I, they hold
+  // only if b agrees
+  for (size_t row = 0, next = 0; row < rows(); ++row) {
+    if (next < r && _independent[next] == row) {
+      ++next;
+      continue;
+    }
+    BigInt sum(0);
+    for (size_t j = 0; j < cols(); ++j) {
+      if (_matrix[row][j] != 0) { sum.add_mul(x[j], _matrix[row][j]); }
+    }
+    if (!(sum == BigInt(rhs[row]))) { return false; }
+  }
+
+  solution = std::move(x);
+  return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bigint.h"
+
+namespace mutils {
+
+  /**
+   * CompactInt class, a long long that turns into a BigInt only while its
+   * value does not fit, so matrices pay for BigInt in the entries that grow.
+   *
+   * The fast paths are overflow checked machine arithmetic, results that
+   * shrink back below 10^18 are stored as long long again.
+   */
+  class CompactInt {
+    private:
+      long long _small = 0;
+      std::unique_ptr<BigInt> _big;
+
+      void assign(BigInt&& value);
+
+    public:
+      CompactInt() : _big() {}
+      CompactInt(long long value) : _small(value), _big() {}
+      CompactInt(const BigInt& value) : _big() { assign(BigInt(value)); }
+      CompactInt(const CompactInt& other)
+        : _small(other._small), _big(other._big ? new BigInt(*other._big) : nullptr) {}
+      CompactInt(CompactInt&&) = default;
+      ~CompactInt() = default;
+
+      CompactInt& operator=(const CompactInt& other);
+      CompactInt& operator=(CompactInt&&) = default;
+
+      bool is_zero() const noexcept { return !_big && _small == 0; }
+      bool is_small() const noexcept { return !_big; }
+      // The value while is_small()
+      auto small_value() const noexcept -> long long { return _small; }
+      auto sign() const noexcept -> int;
+      auto to_bigint() const -> BigInt;
+
+      // this -= factor * rhs
+      void submul(const CompactInt& factor, const CompactInt& rhs);
+      void negate();
+
+      // Truncating division, as BigInt::divmod
+      static void divmod(const CompactInt& lhs, const CompactInt& rhs,
+                         CompactInt& quotient, CompactInt& remainder);
+      static bool abs_less(const CompactInt& lhs, const CompactInt& rhs);
+  };
+
+  /**
+   * HermiteNormalForm class that solves Ax = b over the integers for an
+   * integer m x n matrix A, and gives the kernel lattice of A and its column
+   * Hermite normal form H = AU with U unimodular.
+   *
+   * Eliminating with whole integer columns lets entries grow far past the
+   * minors of A, so the work is modular. The rank, the rows I independent of
+   * the rows above them and a non-singular r x r block B of those rows are
+   * found modulo a prime. d = det B comes from residues modulo enough primes
+   * to pass the Hadamard bound, and adj(B) y for the other columns N and for
+   * b from p-adic lifting over one LU factorization of B. Writing x as x_B
+   * and x_N, Ax = b is then
+   *
+   *   adj(B) N x_N = adj(B) b (mod d),  x_B = (adj(B) b - adj(B) N x_N) / d
+   *
+   * and the congruence is brought to echelon form modulo d, so none of its
+   * entries exceed d. They are CompactInt, BigInt only when d does not fit
+   * a long long. The kernel is the lattice of x_N with adj(B) N x_N = 0
+   * (mod d) completed the same way, and x_N of solve() is reduced against
+   * its Hermite basis so x is one canonical solution for every b. hermite()
+   * works modulo the gcd of two r x r minors (Domich, Kannan and Trotter).
+   *
+   * The rank is taken as the larger of two primes' ranks and certified by
+   * checking that the other rows are rational combinations of the rows I,
+   * more primes are tried while that fails.
+   *
+   * Usage:
+   *
+   *   mutils::HermiteNormalForm hnf(A);
+   *   std::vector<BigInt> x;
+   *   if (hnf.solve(b, x)) { ... x + any integer combination of hnf.kernel() ... }
+   */
+  class HermiteNormalForm {
+    private:
+      using Column = std::vector<CompactInt>;
+      using Matrix = std::vector<std::vector<long long>>;
+
+      Matrix _matrix;                   // A, zero padded
+      std::vector<size_t> _independent; // rows I
+      std::vector<size_t> _basis;       // columns of B
+      std::vector<size_t> _free;        // the other columns N
+      Matrix _square;                   // B
+      uint64_t _prime;                  // B is invertible modulo it
+      BigInt _det;
+      std::vector<std::vector<BigInt>> _adjugateFree;  // adj(B) N, a column each
+      std::vector<Column> _congruence;  // adj(B) N mod |d| in echelon form, x_N below
+      std::vector<Column> _lattice;     // Hermite basis of the kernel's x_N
+
+      bool spanned() const;
+      bool assemble(std::vector<BigInt> adjugate, const Column& free, std::vector<BigInt>& x) const;
+
+    public:
+      explicit HermiteNormalForm(const std::vector<std::vector<long long>>& matrix);
+
+      auto rows() const noexcept -> size_t { return _matrix.size(); }
+      auto cols() const noexcept -> size_t { return _basis.size() + _free.size(); }
+      auto rank() const noexcept -> size_t { return _independent.size(); }
+
+      // H as m rows of rank() entries
+      auto hermite() const -> std::vector<std::vector<BigInt>>;
+      // n - rank() kernel basis vectors of n entries, in Hermite form on the
+      // columns outside B
+      auto kernel() const -> std::vector<std::vector<BigInt>>;
+
+      // False if Ax = b has no integer solution or b is not m long
+      bool solve(const std::vector<long long>& rhs, std::vector<BigInt>& solution) const;
+  };
+}
@@ -0,0 +1,341 @@
+#include "instrument.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "memory.h"
+#include "output.h"
+
+namespace instrument = mutils::instrument;
+
+namespace {
+  const char* const COUNTER_NAMES[instrument::COUNTER_COUNT] = {
+    "bigint.mul.small",
+    "bigint.mul.schoolbook",
+    "bigint.mul.karatsuba",
+    "bigint.square.schoolbook",
+    "bigint.square.karatsuba",
+    "bigint.allocs",
+    "bigint.alloc_bytes",
+    "bigint.to_string",
+    "bigint.from_string",
+    "sieve.generators",
+    "sieve.segments",
+    "factor.calls",
+    "factor.trial_factors",
+    "factor.primality_tests",
+    "factor.rho_retries",
+    "partitions.table_rows",
+    "partitions.hrr_terms_double",
+    "partitions.hrr_terms_bigfloat",
+  };
+
+  const char* const HISTOGRAM_NAMES[instrument::HISTOGRAM_COUNT] = {
+    "bigint.mul.limbs",
+    "bigint.string.digits",
+    "factor.bits",
+  };
+
+  const char* const TIMER_NAMES[instrument::TIMER_COUNT] = {
+    "sieve.segment",
+    "factor.rho",
+    "partitions.table",
+    "partitions.hrr",
+  };
+
+  using instrument::detail::Block;
+  using instrument::detail::Word;
+
+  // A thread's memory state, which counts its limb buffers, and the counts
+  // at the last reset(). The state is only ever written by its thread.
+  struct MemoryCounts {
+    const mutils::memory::detail::State* state;
+    unsigned long long allocs;
+    unsigned long long allocated;
+  };
+
+  // The blocks and memory counts of the running threads and the sum of the
+  // exited ones. Never destroyed, threads may still exit after the static
+  // destructors ran.
+  struct Registry {
+    std::mutex mutex;
+    std::vector<Block*> live;
+    std::vector<MemoryCounts*> memory;
+    Block retired;
+
+    Registry() : mutex(), live(), memory(), retired() {}
+  };
+
+  auto registry() -> Registry&
+  {
+    static Registry* instance = new Registry();
+    return *instance;
+  }
+
+  template<size_t N>
+    void fold(Word (&into)[N], const Word (&from)[N])
+    {
+      for (size_t i = 0; i < N; ++i) { instrument::detail::add(into[i], from[i].load(std::memory_order_relaxed)); }
+    }
+
+  template<size_t N>
+    void fold_max(Word (&into)[N], const Word (&from)[N])
+    {
+      for (size_t i = 0; i < N; ++i) {
+        const unsigned long long value = from[i].load(std::memory_order_relaxed);
+        if (value > into[i].load(std::memory_order_relaxed)) { into[i].store(value, std::memory_order_relaxed); }
+      }
+    }
+
+  template<size_t N>
+    void sum(unsigned long long (&into)[N], const Word (&from)[N])
+    {
+      for (size_t i = 0; i < N; ++i) { into[i] += from[i].load(std::memory_order_relaxed); }
+    }
+
+  template<size_t N>
+    void zero(Word (&words)[N])
+    {
+      for (Word& word : words) { word.store(0, std::memory_order_relaxed); }
+    }
+
+  // Adds the buffers counted since the last reset to counters
+  template<typename Counters>
+    void add_memory(Counters& counters, const MemoryCounts& counts)
+    {
+      const unsigned long long allocs = counts.state->allocs.load(std::memory_order_relaxed) - counts.allocs;
+      const unsigned long long allocated = counts.state->allocated.load(std::memory_order_relaxed) - counts.allocated;
+      counters[instrument::COUNTER_BIGINT_ALLOCS] += allocs;
+      counters[instrument::COUNTER_BIGINT_ALLOC_BYTES] += allocated;
+    }
+
+  // Folds a thread's block into the retired totals when the thread exits.
+  // Buffers the thread allocates after that are not counted.
+  struct Owner {
+    Block block;
+    MemoryCounts memory;
+
+    Owner() : block(), memory{&mutils::memory::detail::Local<void>::state, 0, 0}
+    {
+      Registry& reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      reg.live.push_back(&block);
+      reg.memory.push_back(&memory);
+    }
+
+    ~Owner()
+    {
+      Registry& reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      fold(reg.retired.counters, block.counters);
+      for (size_t h = 0; h < instrument::HISTOGRAM_COUNT; ++h) {
+        fold(reg.retired.histograms[h], block.histograms[h]);
+      }
+      fold(reg.retired.calls, block.calls);
+      fold(reg.retired.nanos, block.nanos);
+      fold_max(reg.retired.slowest, block.slowest);
+      unsigned long long counts[instrument::COUNTER_COUNT] = {};
+      add_memory(counts, memory);
+      instrument::detail::add(reg.retired.counters[instrument::COUNTER_BIGINT_ALLOCS],
+                              counts[instrument::COUNTER_BIGINT_ALLOCS]);
+      instrument::detail::add(reg.retired.counters[instrument::COUNTER_BIGINT_ALLOC_BYTES],
+                              counts[instrument::COUNTER_BIGINT_ALLOC_BYTES]);
+      reg.live.erase(std::find(reg.live.begin(), reg.live.end(), &block));
+      reg.memory.erase(std::find(reg.memory.begin(), reg.memory.end(), &memory));
+
+      // Probes in thread_local destructors that run after this one count
+      // straight into the totals, racing with other exits at worst
+      instrument::detail::Local<void>::block = &reg.retired;
+    }
+
+    Owner(const Owner&) = delete;
+    Owner& operator=(const Owner&) = delete;
+  };
+
+  void add_block(instrument::Snapshot& snap, const Block& block)
+  {
+    sum(snap.counters, block.counters);
+    for (size_t h = 0; h < instrument::HISTOGRAM_COUNT; ++h) { sum(snap.histograms[h], block.histograms[h]); }
+    sum(snap.calls, block.calls);
+    sum(snap.nanos, block.nanos);
+    for (size_t t = 0; t < instrument::TIMER_COUNT; ++t) {
+      snap.slowest[t] = std::max(snap.slowest[t], block.slowest[t].load(std::memory_order_relaxed));
+    }
+  }
+
+  void append_seconds(std::string& out, unsigned long long nanos, int width)
+  {
+    char buf[32];
+    const int size = std::snprintf(buf, sizeof(buf), "%*.9f", width, (double)nanos / 1e9);
+    out.append(buf, (size_t)size);
+  }
+
+  void append_padded(std::string& out, const char* name, size_t width)
+  {
+    const size_t size = std::char_traits<char>::length(name);
+    out += name;
+    if (size < width) { out.append(width - size, ' '); }
+  }
+
+  void report_text(std::string& out, const instrument::Snapshot& snap)
+  {
+    out += "counter                              value\n";
+    for (size_t c = 0; c < instrument::COUNTER_COUNT; ++c) {
+      append_padded(out, COUNTER_NAMES[c], 30);
+      mutils::append_number(out, snap.counters[c], 11);
+      out += '\n';
+    }
+
+    out += "\ntimer                      calls          seconds        mean s     slowest s\n";
+    for (size_t t = 0; t < instrument::TIMER_COUNT; ++t) {
+      append_padded(out, TIMER_NAMES[t], 20);
+      mutils::append_number(out, snap.calls[t], 12);
+      append_seconds(out, snap.nanos[t], 17);
+      append_seconds(out, snap.calls[t] ? snap.nanos[t] / snap.calls[t] : 0, 14);
+      append_seconds(out, snap.slowest[t], 14);
+      out += '\n';
+    }
+
+    for (size_t h = 0; h < instrument::HISTOGRAM_COUNT; ++h) {
+      const unsigned long long* buckets = snap.histograms[h];
+      if (std::all_of(buckets, buckets + instrument::BUCKETS, [](unsigned long long n) { return n == 0; })) {
+        continue;
+      }
+      out += "\nhistogram ";
+      out += HISTOGRAM_NAMES[h];
+      out += "\n                  from       count\n";
+      for (size_t b = 0; b < instrument::BUCKETS; ++b) {
+        if (buckets[b] == 0) { continue; }
+        // [2^(b-1), 2^b) as its lower bound, 2^63 and up as the last
+        mutils::append_number(out, b == 0 ? 0ull : 1ull << (b - 1), 22);
+        mutils::append_number(out, buckets[b], 12);
+        out += '\n';
+      }
+    }
+  }
+
+  void report_json(std::string& out, const instrument::Snapshot& snap)
+  {
+    out += "{\"enabled\":true,\"counters\":{";
+    for (size_t c = 0; c < instrument::COUNTER_COUNT; ++c) {
+      if (c) { out += ','; }
+      out += '"';
+      out += COUNTER_NAMES[c];
+      out += "\":";
+      mutils::append_number(out, snap.counters[c]);
+    }
+
+    out += "},\"timers\":{";
+    for (size_t t = 0; t < instrument::TIMER_COUNT; ++t) {
+      if (t) { out += ','; }
+      out += '"';
+      out += TIMER_NAMES[t];
+      out += "\":{\"calls\":";
+      mutils::append_number(out, snap.calls[t]);
+      out += ",\"nanos\":";
+      mutils::append_number(out, snap.nanos[t]);
+      out += ",\"slowest_nanos\":";
+      mutils::append_number(out, snap.slowest[t]);
+      out += '}';
+    }
+
+    // Buckets as [from, count] pairs, the empty ones left out
+    out += "},\"histograms\":{";
+    for (size_t h = 0; h < instrument::HISTOGRAM_COUNT; ++h) {
+      if (h) { out += ','; }
+      out += '"';
+      out += HISTOGRAM_NAMES[h];
+      out += "\":[";
+      bool first = true;
+      for (size_t b = 0; b < instrument::BUCKETS; ++b) {
+        if (snap.histograms[h][b] == 0) { continue; }
+        if (!first) { out += ','; }
+        first = false;
+        out += '[';
+        mutils::append_number(out, b == 0 ? 0ull : 1ull << (b - 1));
+        out += ',';
+        mutils::append_number(out, snap.histograms[h][b]);
+        out += ']';
+      }
+      out += ']';
+    }
+    out += "}}\n";
+  }
+}
+
+
+auto instrument::detail::attach() -> Block&
+{
+  thread_local Owner owner;
+  Local<void>::block = &owner.block;
+  return owner.block;
+}
+
+
+auto instrument::counter_name(Counter counter) -> const char*
+{
+  return counter < COUNTER_COUNT ? COUNTER_NAMES[counter] : "";
+}
+
+
+auto instrument::histogram_name(Histogram histogram) -> const char*
+{
+  return histogram < HISTOGRAM_COUNT ? HISTOGRAM_NAMES[histogram] : "";
+}
+
+
+auto instrument::timer_name(Timer timer) -> const char*
+{
+  return timer < TIMER_COUNT ? TIMER_NAMES[timer] : "";
+}
+
+
+auto instrument::snapshot() -> Snapshot
+{
+  Snapshot snap = Snapshot();
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  add_block(snap, reg.retired);
+  for (const Block* block : reg.live) { add_block(snap, *block); }
+  for (const MemoryCounts* counts : reg.memory) { add_memory(snap.counters, *counts); }
+  return snap;
+}
+
+
+void instrument::reset()
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::vector<Block*> blocks(reg.live);
+  blocks.push_back(&reg.retired);
+  for (Block* block : blocks) {
+    zero(block->counters);
+    for (size_t h = 0; h < HISTOGRAM_COUNT; ++h) { zero(block->histograms[h]); }
+    zero(block->calls);
+    zero(block->nanos);
+    zero(block->slowest);
+  }
+  for (MemoryCounts* counts : reg.memory) {
+    counts->allocs = counts->state->allocs.load(std::memory_order_relaxed);
+    counts->allocated = counts->state->allocated.load(std::memory_order_relaxed);
+  }
+}
+
+
+void instrument::report(std::string& out, ReportFormat format)
+{
+  if (!enabled()) {
+    out += format == REPORT_JSON ? "{\"enabled\":false}\n"
+                                 : "instrumentation compiled out (MUTILS_INSTRUMENT=0)\n";
+    return;
+  }
+
+  const Snapshot snap = snapshot();
+  if (format == REPORT_JSON) {
+    report_json(out, snap);
+  } else {
+    report_text(out, snap);
+  }
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// 0 compiles every probe out, e.g. with make E_INSTRUMENT=0
+#ifndef MUTILS_INSTRUMENT
+#define MUTILS_INSTRUMENT 1
+#endif
+
+namespace mutils {
+
+  /**
+   * Counters, histograms and timers on the hot paths of BigInt, the sieve,
+   * factorization and the partition functions, to see where a production run
+   * spends its time without a profiling build.
+   *
+   * Every thread counts into a block of its own, so a probe is a load and a
+   * store of a thread local word, no lock and no shared cache line. The block
+   * of a thread is folded into the totals when the thread exits. Histograms
+   * count values by power of two, bucket b holds [2^(b-1), 2^b) and bucket 0
+   * the zeros. A timer reads steady_clock twice, so timers only go around
+   * work of a microsecond or more.
+   *
+   * With MUTILS_INSTRUMENT 0 the probes are empty inline functions and the
+   * report says so.
+   *
+   * Usage:
+   *
+   *   namespace instrument = mutils::instrument;
+   *   instrument::count(instrument::COUNTER_FACTOR_CALLS);
+   *   {
+   *     instrument::ScopedTimer timer(instrument::TIMER_FACTOR_RHO);
+   *     ...
+   *   }
+   *   std::string out;
+   *   instrument::report(out, instrument::REPORT_JSON);
+   */
+  namespace instrument {
+
+    enum Counter : unsigned char {
+      COUNTER_MUL_SMALL,           // products by a single limb
+      COUNTER_MUL_SCHOOLBOOK,      // schoolbook products, recursion leaves included
+      COUNTER_MUL_KARATSUBA,       // Karatsuba splits
+      COUNTER_SQUARE_SCHOOLBOOK,
+      COUNTER_SQUARE_KARATSUBA,
+      COUNTER_BIGINT_ALLOCS,       // limb buffers, counted in memory::detail::State
+      COUNTER_BIGINT_ALLOC_BYTES,
+      COUNTER_TO_STRING,
+      COUNTER_FROM_STRING,
+      COUNTER_SIEVE_GENERATORS,    // PrimeGenerators constructed
+      COUNTER_SIEVE_SEGMENTS,
+      COUNTER_FACTOR_CALLS,
+      COUNTER_FACTOR_TRIAL,        // factors found by trial division
+      COUNTER_FACTOR_PRIMALITY,    // Miller-Rabin tests
+      COUNTER_FACTOR_RHO_RETRIES,  // rho restarted with another polynomial
+      COUNTER_PARTITION_ROWS,      // p(m) entries of the pentagonal recurrence
+      COUNTER_HRR_TERMS_DOUBLE,    // Rademacher terms evaluated in double
+      COUNTER_HRR_TERMS_BIGFLOAT,  // and as BigFloat
+      COUNTER_COUNT,
+    };
+
+    enum Histogram : unsigned char {
+      HISTOGRAM_MUL_LIMBS,      // limbs of the longer operand of each product
+      HISTOGRAM_STRING_DIGITS,  // digits of each decimal conversion
+      HISTOGRAM_FACTOR_BITS,    // bits of each number factored
+      HISTOGRAM_COUNT,
+    };
+
+    enum Timer : unsigned char {
+      TIMER_SIEVE_SEGMENT,
+      TIMER_FACTOR_RHO,         // a split of a composite by Pollard's rho
+      TIMER_PARTITIONS_TABLE,
+      TIMER_PARTITIONS_HRR,
+      TIMER_COUNT,
+    };
+
+    enum ReportFormat : unsigned char {
+      REPORT_TEXT,
+      REPORT_JSON,
+    };
+
+    static const size_t BUCKETS = 65;
+
+    // Totals over every thread, the ones that exited included
+    struct Snapshot {
+      unsigned long long counters[COUNTER_COUNT];
+      unsigned long long histograms[HISTOGRAM_COUNT][BUCKETS];
+      unsigned long long calls[TIMER_COUNT];
+      unsigned long long nanos[TIMER_COUNT];
+      unsigned long long slowest[TIMER_COUNT];  // nanoseconds of the longest call
+    };
+
+    namespace detail {
+      using Word = std::atomic<unsigned long long>;
+
+      struct Block {
+        Word counters[COUNTER_COUNT] = {};
+        Word histograms[HISTOGRAM_COUNT][BUCKETS] = {};
+        Word calls[TIMER_COUNT] = {};
+        Word nanos[TIMER_COUNT] = {};
+        Word slowest[TIMER_COUNT] = {};
+      };
+
+      // A template so the constant initialized thread_local is defined in
+      // every translation unit and read directly, without a TLS wrapper call
+      template<typename T>
+        struct Local {
+          static thread_local Block* block;
+        };
+
+      template<typename T>
+        thread_local Block* Local<T>::block = nullptr;
+
+      // Registers the calling thread's block
+      auto attach() -> Block&;
+
+      inline auto block() -> Block&
+      {
+        Block* current = Local<void>::block;
+        return current ? *current : attach();
+      }
+
+      // Only the owning thread writes a block, a plain increment is enough
+      inline void add(Word& word, unsigned long long value)
+      {
+        word.store(word.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+      }
+
+      inline auto bucket(unsigned long long value) -> size_t
+      {
+        return value == 0 ? 0 : (size_t)(64 - __builtin_clzll(value));
+      }
+    }
+
+    constexpr bool enabled() { return MUTILS_INSTRUMENT != 0; }
+
+    inline void count(Counter counter, unsigned long long value = 1)
+    {
+#if MUTILS_INSTRUMENT
+      detail::add(detail::block().counters[counter], value);
+#else
+      (void)counter;
+      (void)value;
+#endif
+    }
+
+    inline void record(Histogram histogram, unsigned long long value)
+    {
+#if MUTILS_INSTRUMENT
+      detail::add(detail::block().histograms[histogram][detail::bucket(value)], 1);
+#else
+      (void)histogram;
+      (void)value;
+#endif
+    }
+
+    // Adds the time from construction to destruction to timer
+    class ScopedTimer {
+#if MUTILS_INSTRUMENT
+      private:
+        Timer _timer;
+        std::chrono::steady_clock::time_point _start;
+
+      public:
+        explicit ScopedTimer(Timer timer) : _timer(timer), _start(std::chrono::steady_clock::now()) {}
+
+        ~ScopedTimer()
+        {
+          const unsigned long long nanos = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - _start).count();
+          detail::Block& block = detail::block();
+          detail::add(block.calls[_timer], 1);
+          detail::add(block.nanos[_timer], nanos);
+          if (nanos > block.slowest[_timer].load(std::memory_order_relaxed)) {
+            block.slowest[_timer].store(nanos, std::memory_order_relaxed);
+          }
+        }
+#else
+      public:
+        explicit ScopedTimer(Timer) {}
+#endif
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+
+    auto counter_name(Counter counter) -> const char*;
+    auto histogram_name(Histogram histogram) -> const char*;
+    auto timer_name(Timer timer) -> const char*;
+
+    auto snapshot() -> Snapshot;
+    // Zeroes every block, counts made by other threads meanwhile may be lost
+    void reset();
+    // Appends the totals to out, the JSON one object on one line
+    void report(std::string& out, ReportFormat format);
+  }
+}
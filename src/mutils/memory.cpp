@@ -0,0 +1,133 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace memory = mutils::memory;
+
+namespace {
+  auto local() -> memory::detail::State& { return memory::detail::Local<void>::state; }
+
+#ifdef __linux__
+  // VmHWM of /proc/self/status in bytes, 0 if it cannot be read
+  size_t proc_peak_rss()
+  {
+    std::FILE* status = std::fopen("/proc/self/status", "r");
+    if (!status) { return 0; }
+
+    char line[256];
+    unsigned long long kilobytes = 0;
+    while (std::fgets(line, sizeof(line), status)) {
+      if (std::strncmp(line, "VmHWM:", 6) == 0) {
+        if (std::sscanf(line + 6, "%llu", &kilobytes) != 1) { kilobytes = 0; }
+        break;
+      }
+    }
+    std::fclose(status);
+    return (size_t)kilobytes * 1024;
+  }
+#endif
+}
+
+
+auto memory::BudgetExceeded::what() const noexcept -> const char*
+{
+  return "memory budget exceeded";
+}
+
+
+void memory::detail::exceeded()
+{
+  throw BudgetExceeded();
+}
+
+
+auto memory::usage() noexcept -> Usage
+{
+  const detail::State& state = local();
+  return Usage{detail::live(state), state.peak};
+}
+
+
+memory::Scope::Scope(size_t budget) noexcept
+  : _start(detail::live(local())), _outerPeak(local().peak), _outerLimit(local().limit)
+{
+  detail::State& state = local();
+  state.peak = _start;
+  if (budget != 0 && budget < (size_t)(LLONG_MAX - std::max(_start, 0LL))) {
+    state.limit = std::min(state.limit, _start + (long long)budget);
+  }
+}
+
+
+memory::Scope::~Scope()
+{
+  detail::State& state = local();
+  state.peak = std::max(state.peak, _outerPeak);
+  state.limit = _outerLimit;
+}
+
+
+auto memory::Scope::peak() const noexcept -> size_t
+{
+  const long long peak = local().peak;
+  return peak > _start ? (size_t)(peak - _start) : 0;
+}
+
+
+auto memory::peak_rss() -> size_t
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return 0; }
+  return (size_t)counters.PeakWorkingSetSize;
+#else
+#ifdef __linux__
+  const size_t proc = proc_peak_rss();
+  if (proc != 0) { return proc; }
+#endif
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+#ifdef __APPLE__
+  return (size_t)usage.ru_maxrss;         // bytes
+#else
+  return (size_t)usage.ru_maxrss * 1024;  // kilobytes
+#endif
+#endif
+}
+
+
+bool memory::parse_size(const char* str, size_t& bytes)
+{
+  if (*str < '0' || *str > '9') { return false; }
+
+  unsigned long long value = 0;
+  for (; *str >= '0' && *str <= '9'; ++str) {
+    const unsigned long long digit = (unsigned long long)(*str - '0');
+    if (value > (ULLONG_MAX - digit) / 10) { return false; }
+    value = value * 10 + digit;
+  }
+
+  int shift = 0;
+  switch (*str) {
+    case '\0': break;
+    case 'K': case 'k': shift = 10; ++str; break;
+    case 'M': case 'm': shift = 20; ++str; break;
+    case 'G': case 'g': shift = 30; ++str; break;
+    default: return false;
+  }
+  if (*str != '\0' || value > (SIZE_MAX >> shift)) { return false; }
+
+  bytes = (size_t)(value << shift);
+  return true;
+}
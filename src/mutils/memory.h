@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "instrument.h"
+
+namespace mutils {
+
+  /**
+   * Accounting of the memory BigInt limb buffers hold, a budget on it per
+   * operation and the resident set size of the process.
+   *
+   * BigInt allocates its limbs through CountingAllocator, which counts
+   * every buffer on the thread that allocates or frees it. A Scope starts
+   * the peak of the calling thread over and, with a budget, makes any
+   * allocation that would take the thread more than budget bytes above
+   * where the scope started throw BudgetExceeded instead. The operation
+   * unwinds with its buffers freed, and the caller can answer with an error
+   * or retry with an algorithm that holds less.
+   *
+   * Usage:
+   *
+   *   try {
+   *     mutils::memory::Scope scope(256 << 20);
+   *     value = mutils::bell_numbers(n).back();
+   *   } catch (const mutils::memory::BudgetExceeded&) {
+   *     value = mutils::bell(n);
+   *   }
+   */
+  namespace memory {
+
+    // An allocation over the budget of the innermost Scope
+    class BudgetExceeded : public std::bad_alloc {
+      public:
+        auto what() const noexcept -> const char* override;
+    };
+
+    namespace detail {
+      // Live, the bytes the thread holds, is allocated - freed. The
+      // instrument reads its limb buffer counters from allocated and allocs
+      // rather than from probes of their own.
+      struct State {
+        instrument::detail::Word allocated;
+        instrument::detail::Word allocs;
+        unsigned long long freed;
+        long long peak;   // of live
+        long long limit;  // live may not go past this
+      };
+
+      // A template so the constant initialized thread_local is defined in
+      // every translation unit and the allocator reads it inline
+      template<typename T>
+        struct Local {
+          static thread_local State state;
+        };
+
+      template<typename T>
+        thread_local State Local<T>::state = {{}, {}, 0, 0, LLONG_MAX};
+
+      inline auto live(const State& state) -> long long
+      {
+        return (long long)(state.allocated.load(std::memory_order_relaxed) - state.freed);
+      }
+
+      [[noreturn]] void exceeded();
+    }
+
+    // Counted ::operator new and delete, allocate throws BudgetExceeded
+    inline auto allocate(size_t bytes) -> void*
+    {
+      detail::State& state = detail::Local<void>::state;
+      const unsigned long long allocated = state.allocated.load(std::memory_order_relaxed) + bytes;
+      const long long live = (long long)(allocated - state.freed);
+      if (live > state.limit) { detail::exceeded(); }
+
+      void* pointer = ::operator new(bytes);
+      state.allocated.store(allocated, std::memory_order_relaxed);
+      if (live > state.peak) { state.peak = live; }
+#if MUTILS_INSTRUMENT
+      const unsigned long long allocs = state.allocs.load(std::memory_order_relaxed);
+      state.allocs.store(allocs + 1, std::memory_order_relaxed);
+      // The first allocation of the thread makes sure the report sees it
+      if (allocs == 0) { instrument::detail::block(); }
+#endif
+      return pointer;
+    }
+
+    inline void deallocate(void* pointer, size_t bytes) noexcept
+    {
+      detail::Local<void>::state.freed += bytes;
+      ::operator delete(pointer);
+    }
+
+    // True while a Scope budget limits the calling thread. The budget does
+    // not follow work onto other threads, so parallel code keeps to the
+    // calling thread then
+    inline bool limited() noexcept
+    {
+      return detail::Local<void>::state.limit != LLONG_MAX;
+    }
+
+    template<typename T>
+      class CountingAllocator {
+        public:
+          using value_type = T;
+          using propagate_on_container_move_assignment = std::true_type;
+          using is_always_equal = std::true_type;
+
+          CountingAllocator() noexcept = default;
+          template<typename U>
+            CountingAllocator(const CountingAllocator<U>&) noexcept {}
+
+          auto allocate(size_t count) -> T*
+          {
+            if (count > (size_t)-1 / sizeof(T)) { throw std::bad_alloc(); }
+            return static_cast<T*>(memory::allocate(count * sizeof(T)));
+          }
+
+          void deallocate(T* pointer, size_t count) noexcept { memory::deallocate(pointer, count * sizeof(T)); }
+      };
+
+    template<typename T, typename U>
+      bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept { return true; }
+
+    template<typename T, typename U>
+      bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept { return false; }
+
+    // Replaces the elements of to with [first, last), to unchanged if it
+    // throws. A vector copies element by element with any allocator but
+    // std::allocator, std::copy into the sized buffer is one memmove.
+    template<typename T, typename Allocator>
+      void assign(std::vector<T, Allocator>& to, const T* first, const T* last)
+      {
+        const size_t size = (size_t)(last - first);
+        if (size > to.capacity()) {
+          std::vector<T, Allocator> fresh(size);
+          std::copy(first, last, fresh.data());
+          to.swap(fresh);
+        } else {
+          to.resize(size);
+          std::copy(first, last, to.data());
+        }
+      }
+
+    struct Usage {
+      long long live;  // bytes allocated less bytes freed
+      long long peak;  // highest live since the innermost Scope began
+    };
+
+    // Bytes held by the calling thread, the instrument counters total the
+    // allocations of every thread
+    auto usage() noexcept -> Usage;
+
+    /**
+     * Scope class that tracks the calling thread's peak for one operation
+     * and, with a budget other than 0, limits it. Scopes nest, an inner
+     * budget never reaches past the outer one.
+     */
+    class Scope {
+      private:
+        long long _start;
+        long long _outerPeak;
+        long long _outerLimit;
+
+      public:
+        explicit Scope(size_t budget = 0) noexcept;
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+        // Highest bytes held above the start of the scope so far
+        auto peak() const noexcept -> size_t;
+    };
+
+    // Peak resident set size of the process in bytes, 0 if unknown. Linux
+    // reads VmHWM from /proc/self/status, Windows asks for the peak working
+    // set and other systems fall back to getrusage.
+    auto peak_rss() -> size_t;
+
+    // Parses a byte count with an optional K, M or G suffix (powers of
+    // 1024), false if malformed or it does not fit
+    bool parse_size(const char* str, size_t& bytes);
+  }
+}
@@ -0,0 +1,108 @@
+#include "output.h"
+
+#include <utility>
+
+namespace {
+  const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+  // Writes the digits of value to the end of buffer, two at a time, and
+  // returns where they start
+  char* format_unsigned(unsigned long long value, char* end)
+  {
+    while (value >= 100) {
+      const size_t pair = (size_t)(value % 100) * 2;
+      value /= 100;
+      *--end = DIGIT_PAIRS[pair + 1];
+      *--end = DIGIT_PAIRS[pair];
+    }
+    if (value >= 10) {
+      *--end = DIGIT_PAIRS[value * 2 + 1];
+      *--end = DIGIT_PAIRS[value * 2];
+    } else {
+      *--end = (char)('0' + value);
+    }
+    return end;
+  }
+
+  void append_padded(std::string& out, const char* begin, size_t size, int width)
+  {
+    if (width > 0 && (size_t)width > size) { out.append((size_t)width - size, ' '); }
+    out.append(begin, size);
+  }
+}
+
+
+void mutils::detail::append_unsigned(std::string& out, unsigned long long value, int width)
+{
+  char digits[24];
+  char* const end = digits + sizeof(digits);
+  const char* begin = format_unsigned(value, end);
+  append_padded(out, begin, (size_t)(end - begin), width);
+}
+
+
+void mutils::detail::append_signed(std::string& out, long long value, int width)
+{
+  char digits[24];
+  char* const end = digits + sizeof(digits);
+  const unsigned long long magnitude = value < 0 ? 0 - (unsigned long long)value : (unsigned long long)value;
+  char* begin = format_unsigned(magnitude, end);
+  if (value < 0) { *--begin = '-'; }
+  append_padded(out, begin, (size_t)(end - begin), width);
+}
+
+
+void mutils::append_number(std::string& out, const BigInt& value, int width)
+{
+  const std::string digits = value.to_string();
+  append_padded(out, digits.data(), digits.size(), width);
+}
+
+
+mutils::OutputSink::OutputSink(std::FILE* file, size_t limit)
+  : _file(file), _writer(), _buffer(), _limit(limit)
+{
+  _buffer.reserve(limit + limit / 2);
+}
+
+
+mutils::OutputSink::OutputSink(Writer writer, size_t limit)
+  : _file(nullptr), _writer(std::move(writer)), _buffer(), _limit(limit)
+{
+}
+
+
+auto mutils::OutputSink::standard() -> OutputSink&
+{
+  static OutputSink sink(stdout);
+  return sink;
+}
+
+
+void mutils::OutputSink::write_out()
+{
+  if (_buffer.empty()) { return; }
+  if (_writer) {
+    _writer(_buffer.data(), _buffer.size());
+  } else {
+    std::fwrite(_buffer.data(), 1, _buffer.size(), _file);
+  }
+  _buffer.clear();
+}
+
+
+void mutils::OutputSink::flush()
+{
+  write_out();
+  if (_file) { std::fflush(_file); }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#include "bigint.h"
+
+namespace mutils {
+
+  namespace detail {
+    void append_signed(std::string& out, long long value, int width);
+    void append_unsigned(std::string& out, unsigned long long value, int width);
+  }
+
+  // Appends value in decimal, right aligned in width characters as std::setw
+  // would, without a stream or a temporary string
+  template<typename T>
+    auto append_number(std::string& out, T value, int width = 0)
+      -> typename std::enable_if<std::is_integral<T>::value>::type
+    {
+      if (std::is_signed<T>::value) {
+        detail::append_signed(out, (long long)value, width);
+      } else {
+        detail::append_unsigned(out, (unsigned long long)value, width);
+      }
+    }
+
+  void append_number(std::string& out, const BigInt& value, int width = 0);
+
+  /**
+   * OutputSink class that formats into one reusable buffer and hands it to
+   * fwrite whenever it holds limit bytes, instead of a stream insertion and
+   * possibly a flush per value. flush() is the only point where the FILE is
+   * flushed as well.
+   *
+   * Anything else writing to the same FILE must wait for a flush() of the
+   * sink to keep the order. A sink made with a Writer hands the blocks to it
+   * instead of a FILE.
+   *
+   * Usage:
+   *
+   *   mutils::OutputSink& sink = mutils::OutputSink::standard();
+   *   sink.number(p(n)).put('\n');
+   *   sink.flush();
+   */
+  class OutputSink {
+    public:
+      using Writer = std::function<void(const char* data, size_t size)>;
+
+    private:
+      std::FILE* _file;
+      Writer _writer;
+      std::string _buffer;
+      size_t _limit;
+
+      void write_out();
+
+    public:
+      static const size_t BLOCK = 1 << 16;
+
+      explicit OutputSink(std::FILE* file, size_t limit = BLOCK);
+      // The buffer grows as needed instead of being reserved
+      explicit OutputSink(Writer writer, size_t limit = BLOCK);
+      OutputSink(const OutputSink&) = delete;
+      OutputSink& operator=(const OutputSink&) = delete;
+      ~OutputSink() { flush(); }
+
+      // The sink of stdout
+      static auto standard() -> OutputSink&;
+
+      // For formatting in place, commit() after
+      auto buffer() noexcept -> std::string& { return _buffer; }
+      // True if the buffer was written out
+      bool commit()
+      {
+        if (_buffer.size() < _limit) { return false; }
+        write_out();
+        return true;
+      }
+      void flush();
+
+      template<typename T>
+        OutputSink& number(const T& value, int width = 0)
+        {
+          append_number(_buffer, value, width);
+          commit();
+          return *this;
+        }
+
+      OutputSink& text(const char* data, size_t size)
+      {
+        _buffer.append(data, size);
+        commit();
+        return *this;
+      }
+
+      OutputSink& text(const std::string& str) { return text(str.data(), str.size()); }
+
+      OutputSink& put(char c)
+      {
+        _buffer += c;
+        commit();
+        return *this;
+      }
+  };
+
+  /**
+   * ColumnWriter class that lays out a stream of numbers in rows of columns
+   * fields (0 for one row), each right aligned in width characters or, with
+   * width 0, followed by a space. Values are taken one at a time so the
+   * source can be a generator as well as a container.
+   */
+  class ColumnWriter {
+    private:
+      OutputSink& _sink;
+      int _width;
+      int _columns;
+      bool _ignoreZero;
+      int _count = 0;
+
+    public:
+      ColumnWriter(OutputSink& sink, int width, int columns = 10, bool ignoreZero = false)
+        : _sink(sink), _width(width), _columns(columns), _ignoreZero(ignoreZero) {}
+
+      template<typename T>
+        void add(const T& value)
+        {
+          if (_count != 0 && _columns > 0 && _count % _columns == 0) { _sink.put('\n'); }
+          if (_ignoreZero && value == 0) { return; }
+
+          if (_width == 0) {
+            _sink.number(value).put(' ');
+          } else {
+            _sink.number(value, _width);
+          }
+          ++_count;
+        }
+
+      // Ends the last row and flushes
+      void finish()
+      {
+        _sink.put('\n');
+        _sink.flush();
+      }
+  };
+}
@@ -0,0 +1,217 @@
+#include "partition_generator.h"
+
+#include <algorithm>
+
+mutils::PartitionGenerator::PartitionGenerator(int n, int maxParts, int maxPart,
+                                               unsigned int restrictions)
+  : _parts(static_cast<size_t>(std::max(n, 1))), _n(n), _maxParts(maxParts),
+    _maxPart(maxPart > 0 ? std::min(maxPart, n) : n), _restrictions(restrictions)
+{
+}
+
+
+mutils::PartitionGenerator::PartitionGenerator(int n, const std::vector<int>& prefix,
+                                               int maxParts, int maxPart,
+                                               unsigned int restrictions)
+  : PartitionGenerator(n, maxParts, maxPart, restrictions)
+{
+  if (prefix.size() > _parts.size()) {
+    _n = -1;
+    return;
+  }
+
+  std::copy(prefix.begin(), prefix.end(), _parts.begin());
+  _fixed = prefix.size();
+  for (int part : prefix) { _n -= part; }
+  if (_fixed > 0) { _maxPart = std::min(_maxPart, cap_after(prefix.back())); }
+}
+
+
+/**
+ * Advances to the next partition, the first call yields the first one.
+ * Returns false once every partition has been visited.
+ */
+bool mutils::PartitionGenerator::next()
+{
+  if (_done) { return false; }
+
+  if (!_started) {
+    _started = true;
+    if (_n < 0 || !fill(_fixed, _n, _maxPart)) {
+      _done = true;
+      return false;
+    }
+    return true;
+  }
+
+  if (_maxParts <= 0 && _restrictions == PARTS_ANY) { return next_unrestricted(); }
+
+  // Find the rightmost part that can be lowered with the rest still
+  // completable, then refill everything after it greedily
+  const int step = (_restrictions & PARTS_ODD) ? 2 : 1;
+  int tail = 0;
+  for (size_t i = _size; i-- > _fixed;) {
+    tail += _parts[i];
+    for (int part = largest_allowed(_parts[i] - 1); part >= 1; part -= step) {
+      int state = feasible(tail - part, cap_after(part), slots_after(i));
+      if (state < 0) { break; }
+      if (state > 0) {
+        _parts[i] = part;
+        fill(i + 1, tail - part, cap_after(part));
+        return true;
+      }
+    }
+  }
+
+  _done = true;
+  return false;
+}
+
+
+// https://www.geeksforgeeks.org/generate-unique-partitions-of-an-integer/
+// Without part count or parity limits every lowered part is completable, so
+// the classic step is used. A bound on the largest part needs no check as
+// parts never grow.
+bool mutils::PartitionGenerator::next_unrestricted()
+{
+  int* p = _parts.data();
+  const int fixed = static_cast<int>(_fixed);
+  int k = static_cast<int>(_size) - 1;
+
+  // Find the rightmost non-one value and collect the ones after it
+  int rem_val = 0;
+  while (k >= fixed && p[k] == 1) {
+    rem_val += p[k];
+    k--;
+  }
+
+  if (k < fixed) {
+    _done = true;
+    return false;
+  }
+
+  p[k]--;
+  rem_val++;
+
+  // Spread rem_val in parts of size p[k] to keep the order descending
+  while (rem_val > p[k]) {
+    p[k+1] = p[k];
+    rem_val = rem_val - p[k];
+    k++;
+  }
+
+  p[k+1] = rem_val;
+  _size = static_cast<size_t>(k) + 2;
+  return true;
+}
+
+
+void mutils::PartitionGenerator::reset()
+{
+  _size = _fixed;
+  _started = false;
+  _done = false;
+}
+
+
+/*
+ *
+ * Helper functions
+ *
+ */
+
+auto mutils::PartitionGenerator::largest_allowed(int limit) const -> int
+{
+  if ((_restrictions & PARTS_ODD) && limit % 2 == 0) { return limit - 1; }
+  return limit;
+}
+
+
+auto mutils::PartitionGenerator::cap_after(int part) const -> int
+{
+  return (_restrictions & PARTS_DISTINCT) ? part - 1 : part;
+}
+
+
+// Parts still available after index, _n stands in for no limit
+auto mutils::PartitionGenerator::slots_after(size_t index) const -> int
+{
+  if (_maxParts <= 0) { return _n; }
+  return _maxParts - static_cast<int>(index) - 1;
+}
+
+
+/**
+ * Whether remainder can be written with at most slots parts no larger than
+ * cap under the restrictions. Returns 1 if it can, -1 if it cannot and no
+ * smaller cap could either (remainder is above the largest reachable sum),
+ * and 0 if it cannot but a smaller cap still might (parity of distinct odd
+ * parts).
+ *
+ * Reachable sums with j parts form a contiguous range (step 2 for odd parts),
+ * so each case is a bound check:
+ *   any parts           r <= j cap
+ *   odd parts           r <= j cap and j = r (mod 2)
+ *   distinct parts      r <= j cap - j(j - 1)/2
+ *   distinct odd parts  j^2 <= r <= j(cap + 1) - j^2 and j = r (mod 2)
+ */
+auto mutils::PartitionGenerator::feasible(int remainder, int cap, int slots) const -> int
+{
+  if (remainder == 0) { return 1; }
+  cap = largest_allowed(cap);
+  if (slots <= 0 || cap < 1) { return -1; }
+
+  const long long r = remainder;
+  const long long c = cap;
+  const bool distinct = _restrictions & PARTS_DISTINCT;
+  const bool odd = _restrictions & PARTS_ODD;
+
+  if (!distinct && !odd) {
+    return r <= c * slots ? 1 : -1;
+  }
+
+  if (!distinct) {
+    long long j = (r + c - 1) / c;
+    if ((r - j) % 2 != 0) { ++j; }
+    return j <= slots ? 1 : -1;
+  }
+
+  if (!odd) {
+    long long j = std::min<long long>(slots, c);
+    return r <= j * c - j * (j - 1) / 2 ? 1 : -1;
+  }
+
+  long long most = std::min<long long>(slots, (c + 1) / 2);
+  if (r > most * (c + 1) - most * most) { return -1; }
+  for (long long j = most; j >= 1; --j) {
+    if ((r - j) % 2 == 0 && j * j <= r && r <= j * (c + 1) - j * j) { return 1; }
+  }
+  return 0;
+}
+
+
+/**
+ * Greedily places the largest completable parts from index onward, which
+ * gives the first partition in reverse lexicographic order for that suffix.
+ */
+bool mutils::PartitionGenerator::fill(size_t from, int remainder, int cap)
+{
+  const int step = (_restrictions & PARTS_ODD) ? 2 : 1;
+  size_t i = from;
+  while (remainder > 0) {
+    int part = largest_allowed(std::min(cap, remainder));
+    for (; part >= 1; part -= step) {
+      int state = feasible(remainder - part, cap_after(part), slots_after(i));
+      if (state > 0) { break; }
+      if (state < 0) { part = 0; break; }
+    }
+    if (part < 1) { return false; }
+
+    _parts[i++] = part;
+    remainder -= part;
+    cap = cap_after(part);
+  }
+
+  _size = i;
+  return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace mutils {
+
+  // Restricted partition modes, combined with bitwise or
+  enum PartitionRestriction : unsigned int {
+    PARTS_ANY = 0,
+    PARTS_DISTINCT = 1 << 0,
+    PARTS_ODD = 1 << 1,
+  };
+
+  /**
+   * PartitionGenerator class that walks the partitions of n lazily in reverse
+   * lexicographic order, with every partition's parts in descending order.
+   *
+   * Optional restrictions are at most maxParts parts, parts no larger than
+   * maxPart (0 for no limit on either) and the PartitionRestriction modes.
+   * They are pruned during generation: a part is only placed if the remainder
+   * can still be completed, so no restricted partition is ever built and
+   * thrown away.
+   *
+   * The only allocation is the n element buffer made by the constructor, each
+   * call to next() rewrites its tail in place.
+   *
+   * Given a prefix, only the partitions starting with those (descending)
+   * parts are walked, which splits the work into independent subtrees.
+   *
+   * Usage:
+   *
+   *   mutils::PartitionGenerator gen(n, 0, 0, mutils::PARTS_DISTINCT);
+   *   while (gen.next()) {
+   *     for (int part : gen) { ... }
+   *   }
+   */
+  class PartitionGenerator {
+    private:
+      std::vector<int> _parts;
+      size_t _size = 0;
+      size_t _fixed = 0;
+      int _n;
+      int _maxParts;
+      int _maxPart;
+      unsigned int _restrictions;
+      bool _started = false;
+      bool _done = false;
+
+      auto largest_allowed(int limit) const -> int;
+      auto cap_after(int part) const -> int;
+      auto slots_after(size_t index) const -> int;
+      auto feasible(int remainder, int cap, int slots) const -> int;
+      bool fill(size_t from, int remainder, int cap);
+      bool next_unrestricted();
+
+    public:
+      PartitionGenerator(int n, int maxParts = 0, int maxPart = 0,
+                         unsigned int restrictions = PARTS_ANY);
+      PartitionGenerator(int n, const std::vector<int>& prefix, int maxParts = 0,
+                         int maxPart = 0, unsigned int restrictions = PARTS_ANY);
+
+      bool next();
+      void reset();
+
+      auto data() const noexcept -> const int* { return _parts.data(); }
+      auto size() const noexcept -> size_t { return _size; }
+      auto begin() const noexcept -> const int* { return _parts.data(); }
+      auto end() const noexcept -> const int* { return _parts.data() + _size; }
+      auto operator[](size_t i) const noexcept -> int { return _parts[i]; }
+  };
+
+}
@@ -0,0 +1,61 @@
+#include "prime_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "instrument.h"
+
+namespace instrument = mutils::instrument;
+
+mutils::PrimeGenerator::PrimeGenerator(int n, int from)
+  : _base(), _next(), _segment(SEGMENT), _half(n < 3 ? 1 : (size_t)(n - 1) / 2 + 1), _two(n >= 2 && from < 2)
+{
+  instrument::count(instrument::COUNTER_SIEVE_GENERATORS);
+
+  // Index of the first odd number past from, the walk starts there
+  const size_t start = from < 2 ? 1 : (size_t)from / 2 + (size_t)(from % 2);
+  _low = _high = _index = std::min(start, _half);
+  if (n < 9) { return; }
+
+  int root = (int)std::sqrt((double)n);
+  while ((long long)(root + 1) * (root + 1) <= n) { ++root; }
+
+  // Base primes, index i stands for 2i + 1
+  std::vector<char> composite((size_t)root / 2 + 1, 0);
+  for (size_t i = 1; 2 * i + 1 <= (size_t)root; ++i) {
+    if (composite[i]) { continue; }
+    const size_t p = 2 * i + 1;
+    _base.push_back((int)p);
+    for (size_t j = p * p / 2; j < composite.size(); j += p) { composite[j] = 1; }
+  }
+
+  _next.resize(_base.size());
+  for (size_t b = 0; b < _base.size(); ++b) {
+    const size_t p = (size_t)_base[b];
+    size_t j = p * p / 2;
+    if (j < _high) { j += (_high - j + p - 1) / p * p; }
+    _next[b] = j;
+  }
+}
+
+
+void mutils::PrimeGenerator::sieve_segment()
+{
+  instrument::count(instrument::COUNTER_SIEVE_SEGMENTS);
+  instrument::ScopedTimer timer(instrument::TIMER_SIEVE_SEGMENT);
+
+  const size_t low = _high;
+  const size_t high = std::min(low + SEGMENT, _half);
+  _low = low;
+  _high = high;
+
+  char* const flags = _segment.data();
+  std::fill(flags, flags + SEGMENT, 0);
+  for (size_t b = 0; b < _base.size(); ++b) {
+    const size_t p = (size_t)_base[b];
+    size_t j = _next[b];
+    for (; j < high; j += p) { flags[j - low] = 1; }
+    _next[b] = j;
+  }
+}
+
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace mutils {
+
+  /**
+   * PrimeGenerator class that walks the primes up to n, or those in
+   * (from, n], in increasing order with a segmented odd-only sieve of
+   * Eratosthenes.
+   *
+   * The primes up to sqrt(n) are sieved by the constructor, after that one
+   * SEGMENT of odd numbers is crossed off whenever the previous one runs
+   * out, so memory is O(sqrt(n)) however many primes are walked.
+   *
+   * Usage:
+   *
+   *   mutils::PrimeGenerator gen(n);
+   *   while (gen.next()) { ... gen.value() ... }
+   */
+  class PrimeGenerator {
+    private:
+      static const size_t SEGMENT = 1 << 15;
+
+      std::vector<int> _base;      // odd primes up to sqrt(n)
+      std::vector<size_t> _next;   // index of each one's next odd multiple
+      std::vector<char> _segment;  // composite flags of 2i + 1 for i in [low, high)
+      size_t _low = 1;
+      size_t _high = 1;
+      size_t _half;                // 2i + 1 <= n for i below this
+      size_t _index = 1;
+      int _value = 0;
+      bool _two;
+
+      void sieve_segment();
+
+    public:
+      explicit PrimeGenerator(int n, int from = 0);
+
+      // Advances to the next prime, false once past n
+      bool next()
+      {
+        if (_two) {
+          _two = false;
+          _value = 2;
+          return true;
+        }
+
+        while (true) {
+          // Scanned through locals, the flags are chars and may alias the members
+          const char* flags = _segment.data();
+          size_t index = _index;
+          const size_t low = _low;
+          const size_t high = _high;
+          while (index < high && flags[index - low]) { ++index; }
+          if (index < high) {
+            _value = (int)(2 * index + 1);
+            _index = index + 1;
+            return true;
+          }
+          _index = high;
+          if (high >= _half) { return false; }
+          sieve_segment();
+        }
+      }
+
+      auto value() const noexcept -> int { return _value; }
+
+      // Calls visit(p) for every prime not walked yet, a segment at a time
+      template<typename Visit>
+        void for_each(Visit visit)
+        {
+          if (_two) {
+            _two = false;
+            visit(2);
+          }
+
+          while (true) {
+            const char* flags = _segment.data();
+            const size_t low = _low;
+            const size_t high = _high;
+            for (size_t index = _index; index < high; ++index) {
+              if (!flags[index - low]) { visit((int)(2 * index + 1)); }
+            }
+            _index = high;
+            if (high >= _half) { return; }
+            sieve_segment();
+          }
+        }
+  };
+
+}
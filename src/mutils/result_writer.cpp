@@ -0,0 +1,256 @@
+#include "result_writer.h"
+
+#include "batch.h"
+#include "output.h"
+
+namespace {
+  void append_varint(std::string& out, unsigned long long value)
+  {
+    while (value >= 0x80) {
+      out += (char)(unsigned char)(value | 0x80);
+      value >>= 7;
+    }
+    out += (char)(unsigned char)value;
+  }
+}
+
+
+mutils::ResultWriter::ResultWriter(ResultFormat format, std::string& out, OutputSink* sink)
+  : _format(format), _out(&out), _sink(sink), _chunk()
+{
+}
+
+
+void mutils::ResultWriter::header(ResultFormat format, std::string& out)
+{
+  if (format == FORMAT_BINARY) { out.append("MUTB\x01", 5); }
+}
+
+
+void mutils::ResultWriter::commit()
+{
+  if (_sink && _sink->commit()) { _streamed = true; }
+}
+
+
+void mutils::ResultWriter::json_string(const char* data, size_t size)
+{
+  static const char HEX[] = "0123456789abcdef";
+
+  *_out += '"';
+  for (size_t i = 0; i < size; ++i) {
+    const unsigned char c = (unsigned char)data[i];
+    if (c == '"' || c == '\\') {
+      *_out += '\\';
+      *_out += (char)c;
+    } else if (c < 0x20) {
+      _out->append("\\u00");
+      *_out += HEX[c >> 4];
+      *_out += HEX[c & 0xF];
+    } else {
+      *_out += (char)c;
+    }
+  }
+  *_out += '"';
+}
+
+
+void mutils::ResultWriter::result()
+{
+  if (_format == FORMAT_JSON_LINES) { _out->append("\"result\":"); }
+}
+
+
+void mutils::ResultWriter::bigint(const BigInt& value)
+{
+  const BigInt::Limbs& limbs = value.limbs();
+  append_varint(*_out, 2 * (unsigned long long)limbs.size() + (value.is_positive() ? 0 : 1));
+  for (uint32_t limb : limbs) {
+    for (int shift = 0; shift < 32; shift += 8) { *_out += (char)(unsigned char)(limb >> shift); }
+  }
+}
+
+
+void mutils::ResultWriter::begin(size_t line, const Token* tokens, size_t count)
+{
+  _streamed = false;
+
+  switch (_format) {
+    case FORMAT_JSON_LINES:
+      _out->append("{\"line\":");
+      append_number(*_out, line);
+      if (count > 0) {
+        _out->append(",\"query\":");
+        json_string(tokens[0].data, tokens[0].size);
+        _out->append(",\"args\":[");
+        for (size_t i = 1; i < count; ++i) {
+          if (i > 1) { *_out += ','; }
+          json_string(tokens[i].data, tokens[i].size);
+        }
+        *_out += ']';
+      }
+      *_out += ',';
+      break;
+    case FORMAT_BINARY:
+      append_varint(*_out, line);
+      break;
+    case FORMAT_TEXT:
+      break;
+  }
+  _mark = _out->size();
+}
+
+
+void mutils::ResultWriter::end()
+{
+  switch (_format) {
+    case FORMAT_JSON_LINES: _out->append("}\n"); break;
+    case FORMAT_TEXT: *_out += '\n'; break;
+    case FORMAT_BINARY: break;
+  }
+  commit();
+}
+
+
+void mutils::ResultWriter::number(unsigned long long value)
+{
+  if (_format == FORMAT_BINARY) {
+    *_out += (char)KIND_UNSIGNED;
+    append_varint(*_out, value);
+    return;
+  }
+  result();
+  append_number(*_out, value);
+}
+
+
+void mutils::ResultWriter::number(const BigInt& value)
+{
+  if (_format == FORMAT_BINARY) {
+    *_out += (char)KIND_BIGINT;
+    bigint(value);
+    return;
+  }
+  result();
+  append_number(*_out, value);
+}
+
+
+void mutils::ResultWriter::begin_list()
+{
+  _items = 0;
+  _pending = 0;
+  _previous = 0;
+  _chunk.clear();
+
+  switch (_format) {
+    case FORMAT_JSON_LINES: _out->append("\"result\":["); break;
+    case FORMAT_BINARY: *_out += (char)KIND_LIST; break;
+    case FORMAT_TEXT: break;
+  }
+}
+
+
+void mutils::ResultWriter::flush_chunk()
+{
+  if (_pending == 0) { return; }
+  append_varint(*_out, _pending);
+  _out->append(_chunk);
+  _chunk.clear();
+  _pending = 0;
+  commit();
+}
+
+
+void mutils::ResultWriter::item(unsigned long long value)
+{
+  if (_format == FORMAT_BINARY) {
+    append_varint(_chunk, value - _previous);
+    _previous = value;
+    ++_items;
+    if (++_pending == CHUNK) { flush_chunk(); }
+    return;
+  }
+
+  if (_items++ != 0) { *_out += _format == FORMAT_TEXT ? ' ' : ','; }
+  append_number(*_out, value);
+  commit();
+}
+
+
+void mutils::ResultWriter::end_list()
+{
+  switch (_format) {
+    case FORMAT_JSON_LINES:
+      *_out += ']';
+      break;
+    case FORMAT_BINARY:
+      flush_chunk();
+      append_varint(*_out, 0);
+      break;
+    case FORMAT_TEXT:
+      break;
+  }
+}
+
+
+void mutils::ResultWriter::congruence(const BigInt& solution, const BigInt& modulus)
+{
+  switch (_format) {
+    case FORMAT_TEXT:
+      append_number(*_out, solution);
+      _out->append(" mod ");
+      append_number(*_out, modulus);
+      break;
+    case FORMAT_JSON_LINES:
+      _out->append("\"result\":{\"solution\":");
+      append_number(*_out, solution);
+      _out->append(",\"modulus\":");
+      append_number(*_out, modulus);
+      *_out += '}';
+      break;
+    case FORMAT_BINARY:
+      *_out += (char)KIND_CONGRUENCE;
+      bigint(solution);
+      bigint(modulus);
+      break;
+  }
+}
+
+
+void mutils::ResultWriter::none()
+{
+  switch (_format) {
+    case FORMAT_TEXT: _out->append("no solution"); break;
+    case FORMAT_JSON_LINES: _out->append("\"result\":null"); break;
+    case FORMAT_BINARY: *_out += (char)KIND_NONE; break;
+  }
+}
+
+
+void mutils::ResultWriter::error(const std::string& message)
+{
+  switch (_format) {
+    case FORMAT_TEXT:
+      _out->append("error: ").append(message);
+      break;
+    case FORMAT_JSON_LINES:
+      _out->append("\"error\":");
+      json_string(message.data(), message.size());
+      break;
+    case FORMAT_BINARY:
+      *_out += (char)KIND_ERROR;
+      append_varint(*_out, message.size());
+      _out->append(message);
+      break;
+  }
+}
+
+
+void mutils::ResultWriter::discard()
+{
+  if (!_streamed) { _out->resize(_mark); }
+  _chunk.clear();
+  _pending = 0;
+  _items = 0;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bigint.h"
+
+namespace mutils {
+
+  class OutputSink;
+  struct Token;
+
+  enum ResultFormat : unsigned char {
+    FORMAT_TEXT,         // one line per query, as the answers read
+    FORMAT_JSON_LINES,   // one JSON object per query
+    FORMAT_BINARY,       // see ResultWriter
+  };
+
+  /**
+   * ResultWriter class that encodes the answers of batch queries in one of
+   * the ResultFormats, appending to out. With a sink, out is the sink's
+   * buffer and long lists are committed while they are written, so no answer
+   * has to fit in memory whole.
+   *
+   * A record is begin(), one result or error(), end(). The JSON Lines record
+   * is
+   *
+   *   {"line":3,"query":"gcd","args":["12","18"],"result":6}
+   *
+   * with numbers, BigInts included, as JSON numbers, lists as arrays, a
+   * congruence as {"solution":x,"modulus":m} and no solution as null, or
+   * "error":"..." in place of "result".
+   *
+   * The binary stream starts with the 5 bytes "MUTB" 1. A varint is LEB128,
+   * seven bits at a time from the least significant with the high bit set on
+   * all but the last byte. A record is the varint input line, a Kind byte and
+   *
+   *   UNSIGNED    varint
+   *   BIGINT      varint 2 limbs + negative, then base 10^9 limbs as 4 byte
+   *               little-endian words, least significant first
+   *   LIST        chunks of a varint count and that many varint deltas from
+   *               the previous value (the first from 0), ended by count 0,
+   *               for lists in increasing order
+   *   CONGRUENCE  BIGINT solution, BIGINT modulus
+   *   NONE        nothing
+   *   ERROR       varint size, message bytes
+   */
+  class ResultWriter {
+    public:
+      enum Kind : unsigned char {
+        KIND_UNSIGNED = 1,
+        KIND_BIGINT = 2,
+        KIND_LIST = 3,
+        KIND_CONGRUENCE = 4,
+        KIND_NONE = 5,
+        KIND_ERROR = 0x7F,
+      };
+
+      static const size_t CHUNK = 1024;  // list items per binary chunk
+
+    private:
+      ResultFormat _format;
+      std::string* _out;
+      OutputSink* _sink;
+      size_t _mark = 0;         // where the result starts in out
+      bool _streamed = false;   // part of the result was already written out
+      size_t _items = 0;        // in the list so far
+      size_t _pending = 0;      // of them in _chunk
+      unsigned long long _previous = 0;
+      std::string _chunk;       // binary deltas not yet counted
+
+      void commit();
+      void flush_chunk();
+      void bigint(const BigInt& value);
+      void json_string(const char* data, size_t size);
+      void result();
+
+    public:
+      ResultWriter(ResultFormat format, std::string& out, OutputSink* sink = nullptr);
+      ResultWriter(const ResultWriter&) = delete;
+      ResultWriter& operator=(const ResultWriter&) = delete;
+
+      auto format() const noexcept -> ResultFormat { return _format; }
+
+      // What comes before any record of the format
+      static void header(ResultFormat format, std::string& out);
+
+      void begin(size_t line, const Token* tokens, size_t count);
+      void end();
+
+      void number(unsigned long long value);
+      void number(const BigInt& value);
+      void begin_list();
+      void item(unsigned long long value);
+      void end_list();
+      void congruence(const BigInt& solution, const BigInt& modulus);
+      void none();
+      void error(const std::string& message);
+
+      // Drops what was written since begin(), unless it was already written
+      // out
+      void discard();
+
+      template<typename T>
+        void list(const std::vector<T>& values)
+        {
+          begin_list();
+          for (const T& value : values) { item((unsigned long long)value); }
+          end_list();
+        }
+  };
+}
@@ -0,0 +1,504 @@
+#include "sequence_cache.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include "bigint_view.h"
+#include "prime_generator.h"
+#include "utils.h"
+
+namespace {
+  const char MAGIC[] = "MUSC";
+  const uint32_t VERSION = 2;
+  const size_t CHECKSUM_AT = 8;  // after the magic and version
+
+  // 32 bit FNV-1a of the bytes
+  uint32_t checksum(const char* data, size_t size)
+  {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+    return hash;
+  }
+
+  void append_word(std::string& out, uint32_t word)
+  {
+    const char bytes[4] = {
+      (char)(word & 0xFF),
+      (char)((word >> 8) & 0xFF),
+      (char)((word >> 16) & 0xFF),
+      (char)(word >> 24),
+    };
+    out.append(bytes, 4);
+  }
+
+  // Reads the next word at data, false if fewer than 4 bytes are left
+  bool read_word(const char*& data, const char* end, uint32_t& word)
+  {
+    if (end - data < 4) { return false; }
+    const unsigned char* bytes = (const unsigned char*)data;
+    word = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+      (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    data += 4;
+    return true;
+  }
+
+  // The values are viewed in place and their limbs copied out in one block,
+  // BigInt::deserialize() reads the ones a view refuses (error flagged
+  // values, big-endian hosts)
+  bool read_values(const char*& data, const char* end, uint32_t count, std::vector<BigInt>& values)
+  {
+    // Every value takes at least 12 bytes, so a corrupt count fails here
+    // instead of reserving gigabytes
+    if ((size_t)(end - data) / 12 < count) { return false; }
+    values.resize(count);
+    BigIntView view;
+    for (BigInt& value : values) {
+      if (BigIntView::view(data, end, view)) {
+        value = view.to_bigint();
+      } else if (!BigInt::deserialize(data, end, value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+
+mutils::SequenceCache::SequenceCache(size_t limit)
+  : _mutex(), _recent(), _entries(), _limit(limit)
+{
+}
+
+
+auto mutils::SequenceCache::global() -> SequenceCache&
+{
+  static SequenceCache cache;
+  return cache;
+}
+
+
+auto mutils::SequenceCache::bell(int n) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+  return prefix(SEQ_BELL, std::max(n, 1))->values[(size_t)n];
+}
+
+
+auto mutils::SequenceCache::bell_numbers(int n) -> std::vector<BigInt>
+{
+  if (n < 0) { return std::vector<BigInt>(); }
+  const EntryPtr entry = prefix(SEQ_BELL, std::max(n, 1));
+  return std::vector<BigInt>(entry->values.begin(), entry->values.begin() + n + 1);
+}
+
+
+// The table below PARTITIONS_HRR_FROM or as far as it was extended, the
+// Rademacher series past it, as partitions_count. The series runs on the
+// calling thread, batch mode already calls from a thread per core.
+auto mutils::SequenceCache::partitions_count(int n) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+  if (n < PARTITIONS_HRR_FROM) { return prefix(SEQ_PARTITION_TABLE, n)->values[(size_t)n]; }
+
+  EntryPtr cached = find(SEQ_PARTITION_TABLE, n);
+  if (cached && cached->n >= n) {
+    count(&Stats::hits);
+    return cached->values[(size_t)n];
+  }
+
+  cached = find(SEQ_PARTITION, n);
+  if (cached && cached->n == n) {
+    count(&Stats::hits);
+    return cached->values[0];
+  }
+
+  count(&Stats::misses);
+  Entry entry(SEQ_PARTITION, n);
+  entry.values.push_back(partitions_hrr(n, 1));
+  return insert(std::move(entry))->values[0];
+}
+
+
+auto mutils::SequenceCache::partitions_table(int n) -> std::vector<BigInt>
+{
+  if (n < 0) { return std::vector<BigInt>(); }
+  const EntryPtr entry = prefix(SEQ_PARTITION_TABLE, n);
+  return std::vector<BigInt>(entry->values.begin(), entry->values.begin() + n + 1);
+}
+
+
+auto mutils::SequenceCache::factorial(int n) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+
+  const EntryPtr cached = find(SEQ_FACTORIAL, n);
+  if (cached && cached->n == n) {
+    count(&Stats::hits);
+    return cached->values[0];
+  }
+
+  Entry entry(SEQ_FACTORIAL, n);
+  // Past a quarter of n the product of (m, n] costs more than the prime
+  // swing does for all of n!
+  if (cached && n - cached->n <= n / 4) {
+    count(&Stats::resumed);
+    entry.values.push_back(cached->values[0] *
+                           product_range((unsigned long long)cached->n + 1, (unsigned long long)n));
+  } else {
+    count(&Stats::misses);
+    entry.values.push_back(factorial_prime_swing(n, prefix(SEQ_PRIMES, n)->primes));
+  }
+  return insert(std::move(entry))->values[0];
+}
+
+
+// From the row of n itself, or a rolling column of S(., 0..k) resumed from
+// the closest cached row when k is under half the row, which is cheaper than
+// a whole row and not kept
+auto mutils::SequenceCache::stirling2(int n, int k) -> BigInt
+{
+  if (n < 0 || k < 0 || k > n) { return BigInt(0); }
+  if (2 * k >= n) { return stirling2_entry(n)->values[(size_t)k]; }
+
+  const EntryPtr cached = find(SEQ_STIRLING2, n);
+  if (cached && cached->n == n) {
+    count(&Stats::hits);
+    return cached->values[(size_t)k];
+  }
+
+  std::vector<BigInt> columns((size_t)k + 1, BigInt(0));
+  int m = 0;
+  if (cached) {
+    count(&Stats::resumed);
+    m = cached->n;
+    std::copy(cached->values.begin(), cached->values.begin() + std::min(k, m) + 1, columns.begin());
+  } else {
+    count(&Stats::misses);
+    columns[0] = 1;
+  }
+  stirling2_columns_extend(columns, m, n);
+  return columns[(size_t)k];
+}
+
+
+auto mutils::SequenceCache::stirling2_row(int n) -> std::vector<BigInt>
+{
+  if (n < 0) { return std::vector<BigInt>(); }
+  return stirling2_entry(n)->values;
+}
+
+
+auto mutils::SequenceCache::prime_table(int n) -> std::vector<int>
+{
+  const EntryPtr entry = prefix(SEQ_PRIMES, std::max(n, 0));
+  return std::vector<int>(entry->primes.begin(),
+                          std::upper_bound(entry->primes.begin(), entry->primes.end(), n));
+}
+
+
+void mutils::SequenceCache::set_limit(size_t limit)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _limit = limit;
+  evict();
+}
+
+
+auto mutils::SequenceCache::bytes() const -> size_t
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _bytes;
+}
+
+
+auto mutils::SequenceCache::stats() const -> Stats
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+
+void mutils::SequenceCache::clear()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.clear();
+  _recent.clear();
+  _bytes = 0;
+}
+
+
+// Least recently used first, so loading the file back keeps the order
+bool mutils::SequenceCache::save(const std::string& path) const
+{
+  std::string out(MAGIC, 4);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    append_word(out, VERSION);
+    append_word(out, 0);
+    append_word(out, (uint32_t)_recent.size());
+    for (auto it = _recent.rbegin(); it != _recent.rend(); ++it) {
+      const Entry& entry = **it;
+      append_word(out, entry.sequence);
+      append_word(out, (uint32_t)entry.n);
+      append_word(out, (uint32_t)entry.values.size());
+      append_word(out, (uint32_t)entry.state.size());
+      append_word(out, (uint32_t)entry.primes.size());
+      for (const BigInt& value : entry.values) { value.serialize(out); }
+      for (const BigInt& value : entry.state) { value.serialize(out); }
+      for (int p : entry.primes) { append_word(out, (uint32_t)p); }
+    }
+  }
+
+  std::string sum;
+  append_word(sum, checksum(out.data() + CHECKSUM_AT + 4, out.size() - CHECKSUM_AT - 4));
+  out.replace(CHECKSUM_AT, 4, sum);
+
+  // Written next to path and renamed over it, so a crash or a full disk
+  // leaves the previous file rather than a truncated one
+  const std::string temp = path + ".tmp";
+  std::FILE* file = std::fopen(temp.c_str(), "wb");
+  if (file == nullptr) { return false; }
+  const bool written = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+  if (std::fclose(file) != 0 || !written || std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+bool mutils::SequenceCache::load(const std::string& path)
+{
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) { return false; }
+
+  // Read straight into words so every value in the file lands 4 byte
+  // aligned, which is what lets read_values() view them in place
+  std::vector<uint32_t> words;
+  size_t size = 0;
+  for (size_t read = 1; read > 0; size += read) {
+    if (size == words.size() * 4) { words.resize(std::max(words.size() * 2, (size_t)1 << 14)); }
+    read = std::fread((char*)words.data() + size, 1, words.size() * 4 - size, file);
+  }
+  const bool failed = std::ferror(file) != 0;
+  std::fclose(file);
+  const char* const in = (const char*)words.data();
+  if (failed || size < 4 || std::memcmp(in, MAGIC, 4) != 0) { return false; }
+
+  const char* data = in + 4;
+  const char* const end = in + size;
+  uint32_t version, sum, count;
+  if (!read_word(data, end, version) || version != VERSION || !read_word(data, end, sum) ||
+      sum != checksum(data, (size_t)(end - data)) || !read_word(data, end, count)) {
+    return false;
+  }
+
+  std::vector<Entry> entries;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t sequence, n, values, state, primes;
+    if (!read_word(data, end, sequence) || !read_word(data, end, n) ||
+        !read_word(data, end, values) || !read_word(data, end, state) ||
+        !read_word(data, end, primes) || sequence >= SEQ_COUNT || n > INT_MAX) {
+      return false;
+    }
+
+    entries.emplace_back((Sequence)sequence, (int)n);
+    Entry& entry = entries.back();
+    if (!read_values(data, end, values, entry.values) || !read_values(data, end, state, entry.state) ||
+        (size_t)(end - data) / 4 < primes) {
+      return false;
+    }
+    entry.primes.resize(primes);
+    for (int& p : entry.primes) {
+      uint32_t word = 0;
+      read_word(data, end, word);
+      p = (int)std::min(word, (uint32_t)INT_MAX);
+    }
+    if (!is_valid(entry)) { return false; }
+  }
+  if (data != end) { return false; }
+
+  for (Entry& entry : entries) { insert(std::move(entry)); }
+  return true;
+}
+
+
+bool mutils::SequenceCache::is_prefix(Sequence sequence)
+{
+  return sequence == SEQ_BELL || sequence == SEQ_PARTITION_TABLE || sequence == SEQ_PRIMES;
+}
+
+
+// The shape each sequence is kept in. The values themselves are not
+// checked, the checksum in the header catches a file damaged since save()
+bool mutils::SequenceCache::is_valid(const Entry& entry)
+{
+  const size_t n = (size_t)entry.n;
+  for (const BigInt& value : entry.values) {
+    if (!value.is_valid()) { return false; }
+  }
+
+  switch (entry.sequence) {
+    case SEQ_BELL:
+      return n >= 1 && entry.values.size() == n + 1 && entry.state.size() == n && entry.primes.empty();
+    case SEQ_PARTITION_TABLE:
+    case SEQ_STIRLING2:
+      return entry.values.size() == n + 1 && entry.state.empty() && entry.primes.empty();
+    case SEQ_PARTITION:
+    case SEQ_FACTORIAL:
+      return entry.values.size() == 1 && entry.state.empty() && entry.primes.empty();
+    case SEQ_PRIMES:
+      for (size_t i = 0; i < entry.primes.size(); ++i) {
+        if (entry.primes[i] < 2 || (i > 0 && entry.primes[i] <= entry.primes[i - 1])) { return false; }
+      }
+      return entry.values.empty() && entry.state.empty() &&
+        (entry.primes.empty() || entry.primes.back() <= entry.n);
+    default:
+      return false;
+  }
+}
+
+
+auto mutils::SequenceCache::size_of(const Entry& entry) -> size_t
+{
+  size_t bytes = sizeof(Entry) + entry.primes.size() * sizeof(int);
+  for (const BigInt& value : entry.values) { bytes += sizeof(BigInt) + value.limbs().size() * 4; }
+  for (const BigInt& value : entry.state) { bytes += sizeof(BigInt) + value.limbs().size() * 4; }
+  return bytes;
+}
+
+
+auto mutils::SequenceCache::find(Sequence sequence, int n) -> EntryPtr
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto it = is_prefix(sequence)
+    ? _entries.lower_bound(Key(sequence, INT_MIN))
+    : _entries.upper_bound(Key(sequence, n));
+  if (!is_prefix(sequence)) {
+    if (it == _entries.begin()) { return nullptr; }
+    --it;
+  }
+  if (it == _entries.end() || it->first.first != sequence) { return nullptr; }
+
+  _recent.splice(_recent.begin(), _recent, it->second);
+  return *it->second;
+}
+
+
+auto mutils::SequenceCache::insert(Entry&& entry) -> EntryPtr
+{
+  entry.bytes = size_of(entry);
+  const EntryPtr shared = std::make_shared<const Entry>(std::move(entry));
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (shared->bytes > _limit) { return shared; }
+
+  const Key key(shared->sequence, shared->n);
+  if (is_prefix(shared->sequence)) {
+    auto it = _entries.lower_bound(Key(shared->sequence, INT_MIN));
+    if (it != _entries.end() && it->first.first == shared->sequence) {
+      // Another thread got further
+      if (it->first.second >= shared->n) { return shared; }
+      erase(it);
+    }
+  } else {
+    auto it = _entries.find(key);
+    if (it != _entries.end()) { erase(it); }
+  }
+
+  _recent.push_front(shared);
+  _entries[key] = _recent.begin();
+  _bytes += shared->bytes;
+  evict();
+  return shared;
+}
+
+
+void mutils::SequenceCache::erase(std::map<Key, std::list<EntryPtr>::iterator>::iterator it)
+{
+  _bytes -= (*it->second)->bytes;
+  _recent.erase(it->second);
+  _entries.erase(it);
+}
+
+
+void mutils::SequenceCache::evict()
+{
+  while (_bytes > _limit && !_recent.empty()) {
+    const Entry& last = *_recent.back();
+    erase(_entries.find(Key(last.sequence, last.n)));
+  }
+}
+
+
+void mutils::SequenceCache::count(size_t Stats::*counter)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  ++(_stats.*counter);
+}
+
+
+auto mutils::SequenceCache::prefix(Sequence sequence, int n) -> EntryPtr
+{
+  const EntryPtr cached = find(sequence, n);
+  if (cached && cached->n >= n) {
+    count(&Stats::hits);
+    return cached;
+  }
+  count(cached ? &Stats::resumed : &Stats::misses);
+
+  Entry entry(sequence, n);
+  if (cached) {
+    entry.values = cached->values;
+    entry.state = cached->state;
+    entry.primes = cached->primes;
+  }
+
+  switch (sequence) {
+    case SEQ_BELL:
+      if (!cached) {
+        entry.values = {1, 1};
+        entry.state = {1};
+      }
+      bell_numbers_extend(entry.values, entry.state, n);
+      break;
+    case SEQ_PARTITION_TABLE:
+      if (!cached) { entry.values = {1}; }
+      partitions_table_extend(entry.values, n);
+      break;
+    case SEQ_PRIMES:
+      PrimeGenerator(n, cached ? cached->n : 0).for_each([&entry](int p) { entry.primes.push_back(p); });
+      break;
+    default:
+      break;
+  }
+  return insert(std::move(entry));
+}
+
+
+// Rows are advanced on the calling thread, batch queries already run on a
+// pool of their own
+auto mutils::SequenceCache::stirling2_entry(int n) -> EntryPtr
+{
+  const EntryPtr cached = find(SEQ_STIRLING2, n);
+  if (cached && cached->n == n) {
+    count(&Stats::hits);
+    return cached;
+  }
+
+  Entry entry(SEQ_STIRLING2, n);
+  if (cached) {
+    count(&Stats::resumed);
+    entry.values = cached->values;
+  } else {
+    count(&Stats::misses);
+    entry.values = {1};
+  }
+  stirling2_row_extend(entry.values, n, 1);
+  return insert(std::move(entry));
+}
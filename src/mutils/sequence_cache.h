@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bigint.h"
+
+namespace mutils {
+
+  /**
+   * SequenceCache class that keeps the sequences computed so far, Bell
+   * numbers, partition numbers, factorials, Stirling rows and prime tables,
+   * and answers later requests from them.
+   *
+   * Sequences built from a prefix (the Bell numbers with their triangle row,
+   * the p(n) table and the primes) keep one entry, the longest, which answers
+   * everything below it and is extended from its end for anything above.
+   * Factorials and Stirling rows keep an entry per n, a larger n resumes from
+   * the closest smaller one: n! from m! times (m, n] once n - m <= n / 4, a
+   * row by advancing the cached one.
+   *
+   * Entries are dropped least recently used first once they hold more than
+   * limit bytes, an entry larger than the limit is not kept at all. The
+   * members are safe to call from several threads, computations run outside
+   * the lock so two threads may compute the same entry once each.
+   *
+   * save() and load() persist the entries in a binary file:
+   *
+   *   "MUSC", then 4 byte little-endian words version (2), checksum and
+   *   entry count, per entry the words sequence, n, value count, state count
+   *   and prime count, then the values and state as BigInt::serialize()
+   *   writes them and the primes as words. The checksum is the 32 bit FNV-1a
+   *   of everything after it, load() refuses a file where it differs.
+   *
+   * save() writes path + ".tmp" and renames it over path, so the file is
+   * either the old one or the new one.
+   *
+   * Usage:
+   *
+   *   mutils::SequenceCache& cache = mutils::SequenceCache::global();
+   *   cache.load("sequences.bin");
+   *   BigInt b = cache.bell(n);
+   *   cache.save("sequences.bin");
+   */
+  class SequenceCache {
+    public:
+      enum Sequence : unsigned char {
+        SEQ_BELL,             // B(0..n), state the Bell triangle row n - 1
+        SEQ_PARTITION_TABLE,  // p(0..n)
+        SEQ_PARTITION,        // p(n) alone, from the Rademacher series
+        SEQ_FACTORIAL,        // n!
+        SEQ_STIRLING2,        // S(n, 0..n)
+        SEQ_PRIMES,           // the primes up to n
+        SEQ_COUNT,
+      };
+
+      struct Stats {
+        size_t hits;      // answered from an entry
+        size_t resumed;   // computed from a smaller entry
+        size_t misses;    // computed from scratch
+      };
+
+      static const size_t DEFAULT_LIMIT = (size_t)64 << 20;  // bytes
+
+    private:
+      struct Entry {
+        Sequence sequence;
+        int n;
+        std::vector<BigInt> values;
+        std::vector<BigInt> state;
+        std::vector<int> primes;
+        size_t bytes;
+
+        Entry(Sequence seq, int num) : sequence(seq), n(num), values(), state(), primes(), bytes(0) {}
+      };
+
+      using EntryPtr = std::shared_ptr<const Entry>;
+      using Key = std::pair<int, int>;  // sequence, n
+
+      mutable std::mutex _mutex;
+      std::list<EntryPtr> _recent;  // most recently used first
+      std::map<Key, std::list<EntryPtr>::iterator> _entries;
+      size_t _limit;
+      size_t _bytes = 0;
+      Stats _stats = Stats();
+
+      static bool is_prefix(Sequence sequence);
+      static bool is_valid(const Entry& entry);
+      static auto size_of(const Entry& entry) -> size_t;
+
+      // The entry of sequence with the largest n, at most n unless the
+      // sequence is a prefix one, or null
+      auto find(Sequence sequence, int n) -> EntryPtr;
+      // Keeps entry unless it is larger than the limit or a longer prefix is
+      // kept already, returns it either way
+      auto insert(Entry&& entry) -> EntryPtr;
+      void erase(std::map<Key, std::list<EntryPtr>::iterator>::iterator it);
+      void evict();
+      void count(size_t Stats::*counter);
+      // The entry of a prefix sequence covering n
+      auto prefix(Sequence sequence, int n) -> EntryPtr;
+      auto stirling2_entry(int n) -> EntryPtr;
+
+    public:
+      explicit SequenceCache(size_t limit = DEFAULT_LIMIT);
+      SequenceCache(const SequenceCache&) = delete;
+      SequenceCache& operator=(const SequenceCache&) = delete;
+
+      // The cache of the interactive and batch modes
+      static auto global() -> SequenceCache&;
+
+      auto bell(int n) -> BigInt;
+      auto bell_numbers(int n) -> std::vector<BigInt>;
+      auto partitions_count(int n) -> BigInt;
+      auto partitions_table(int n) -> std::vector<BigInt>;
+      auto factorial(int n) -> BigInt;
+      auto stirling2(int n, int k) -> BigInt;
+      auto stirling2_row(int n) -> std::vector<BigInt>;
+      auto prime_table(int n) -> std::vector<int>;
+
+      auto limit() const noexcept -> size_t { return _limit; }
+      void set_limit(size_t limit);
+      auto bytes() const -> size_t;
+      auto stats() const -> Stats;
+      void clear();
+
+      // False if the file cannot be written
+      bool save(const std::string& path) const;
+      // Adds the entries of a file written by save(). False, with nothing
+      // added, if it cannot be read or is not such a file
+      bool load(const std::string& path);
+  };
+}
@@ -0,0 +1,171 @@
+#include "thread_pool.h"
+
+namespace {
+  // Pool and worker index of the calling thread, if it is a pool worker
+  thread_local const mutils::ThreadPool* currentPool = nullptr;
+  thread_local unsigned int currentWorker = 0;
+}
+
+
+mutils::ThreadPool::ThreadPool(unsigned int threads)
+  : _queues(), _workers(), _mutex(), _wake(), _idle(), _error()
+{
+  if (threads == 0) { threads = default_threads(); }
+
+  for (unsigned int id = 0; id < threads; ++id) {
+    _queues.emplace_back(new Queue());
+  }
+  for (unsigned int id = 0; id < threads; ++id) {
+    _workers.emplace_back(&ThreadPool::run, this, id);
+  }
+}
+
+
+// An error no wait() picked up is dropped, a destructor must not throw
+mutils::ThreadPool::~ThreadPool()
+{
+  wait_idle();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (auto& worker : _workers) { worker.join(); }
+}
+
+
+void mutils::ThreadPool::submit(Task task)
+{
+  unsigned int id = currentPool == this
+    ? currentWorker
+    : static_cast<unsigned int>(_next++ % _queues.size());
+
+  ++_pending;
+  {
+    // Counted under the lock so a worker about to sleep cannot miss it
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_queued;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_queues[id]->mutex);
+    _queues[id]->tasks.push_back(std::move(task));
+  }
+  _wake.notify_one();
+}
+
+
+// Blocks until every submitted task, including ones they submit, has
+// finished, then rethrows the first exception one of them ended with
+void mutils::ThreadPool::wait()
+{
+  wait_idle();
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    error.swap(_error);
+  }
+  if (error) { std::rethrow_exception(error); }
+}
+
+
+void mutils::ThreadPool::wait_idle() noexcept
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle.wait(lock, [this] { return _pending == 0; });
+}
+
+
+auto mutils::ThreadPool::default_threads() -> unsigned int
+{
+  unsigned int threads = std::thread::hardware_concurrency();
+  return threads == 0 ? 1 : threads;
+}
+
+
+bool mutils::ThreadPool::pop_or_steal(unsigned int id, Task& task)
+{
+  {
+    Queue& own = *_queues[id];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < _queues.size(); ++i) {
+    Queue& victim = *_queues[(id + i) % _queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void mutils::ThreadPool::run(unsigned int id)
+{
+  currentPool = this;
+  currentWorker = id;
+
+  Task task;
+  while (true) {
+    if (pop_or_steal(id, task)) {
+      --_queued;
+      try {
+        task(id);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_error) { _error = std::current_exception(); }
+      }
+      task = nullptr;
+
+      if (--_pending == 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _idle.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wake.wait(lock, [this] { return _stop || _queued > 0; });
+    if (_stop && _queued == 0) { return; }
+  }
+}
+
+
+void mutils::ThreadGroup::spawn(std::function<void()> task)
+{
+  _threads.emplace_back([this, task] {
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _errors.push_back(std::current_exception());
+    }
+  });
+}
+
+
+void mutils::ThreadGroup::join()
+{
+  join_all();
+  if (!_errors.empty()) {
+    std::exception_ptr error = _errors.front();
+    _errors.clear();
+    std::rethrow_exception(error);
+  }
+}
+
+
+void mutils::ThreadGroup::join_all() noexcept
+{
+  for (auto& thread : _threads) {
+    if (thread.joinable()) { thread.join(); }
+  }
+  _threads.clear();
+}
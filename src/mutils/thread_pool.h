@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mutils {
+
+  /**
+   * ThreadPool class with one task deque per worker and work stealing.
+   *
+   * A worker pops its own deque from the back (newest first, cache warm) and
+   * when that is empty steals from the front of the others (oldest first,
+   * usually the largest remaining pieces of work). Tasks submitted from inside
+   * a task go to the submitting worker's deque, outside submissions are dealt
+   * round robin.
+   *
+   * Every task receives the index of the worker running it, in
+   * [0, size()), so callers can keep per-worker state without locking.
+   *
+   * A task that throws ends the task, not the worker: the first exception is
+   * kept and wait() rethrows it once every task has finished.
+   */
+  class ThreadPool {
+    public:
+      using Task = std::function<void(unsigned int)>;
+
+    private:
+      struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+
+        Queue() : mutex(), tasks() {}
+      };
+
+      std::vector<std::unique_ptr<Queue>> _queues;
+      std::vector<std::thread> _workers;
+      std::mutex _mutex;
+      std::condition_variable _wake;
+      std::condition_variable _idle;
+      std::atomic<size_t> _queued{0};
+      std::atomic<size_t> _pending{0};
+      std::atomic<size_t> _next{0};
+      std::exception_ptr _error;
+      bool _stop = false;
+
+      bool pop_or_steal(unsigned int id, Task& task);
+      void run(unsigned int id);
+      void wait_idle() noexcept;
+
+    public:
+      explicit ThreadPool(unsigned int threads = 0);
+      ThreadPool(const ThreadPool&) = delete;
+      ThreadPool& operator=(const ThreadPool&) = delete;
+      ~ThreadPool();
+
+      void submit(Task task);
+      void wait();
+      auto size() const noexcept -> unsigned int { return static_cast<unsigned int>(_workers.size()); }
+
+      static auto default_threads() -> unsigned int;
+  };
+
+
+  /**
+   * ThreadGroup class for a few threads forked around work the caller does
+   * itself. The threads are joined on every way out of the scope, so an
+   * exception on the calling thread unwinds instead of terminating, and
+   * join() rethrows the first exception a thread ended with.
+   *
+   * Usage:
+   *
+   *   mutils::ThreadGroup group;
+   *   group.spawn([&] { low = low_half(); });
+   *   high = high_half();
+   *   group.join();
+   */
+  class ThreadGroup {
+    private:
+      std::vector<std::thread> _threads;
+      std::vector<std::exception_ptr> _errors;
+      std::mutex _mutex;
+
+      void join_all() noexcept;
+
+    public:
+      ThreadGroup() : _threads(), _errors(), _mutex() {}
+      ThreadGroup(const ThreadGroup&) = delete;
+      ThreadGroup& operator=(const ThreadGroup&) = delete;
+      ~ThreadGroup() { join_all(); }
+
+      void spawn(std::function<void()> task);
+      void join();
+  };
+
+}
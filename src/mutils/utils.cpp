@@ -1,19 +1,30 @@
 #include "utils.h"
 
-#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+
+#include "bigfloat.h"
+#include "console.h"
+#include "instrument.h"
+#include "memory.h"
+
+namespace instrument = mutils::instrument;
 
 void mutils::sieve_of_eratosthenes(int n, std::set<int>& primes, bool verbose)
 {
-  // Colors
-  HANDLE hStdout;
-  hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
+  OutputSink& sink = OutputSink::standard();
 
   for (int i = 1; i <= n; ++i) {
 
     if (i == 1) {
       if (verbose) {
-        SetConsoleTextAttribute(hStdout, 0);
-        std::cout << std::setw(10) << i;
+        console::set_color(sink, console::BLACK);
+        sink.number(i, 10);
       }
       continue;
     }
@@ -36,163 +47,1234 @@ void mutils::sieve_of_eratosthenes(int n, std::set<int>& primes, bool verbose)
     if (verbose)
     {
       // New line after 10 numbers in a row
-      if (i % 10 == 0) { std::cout << std::endl; }
+      if (i % 10 == 0) { sink.put('\n'); }
       if (newPrime) { // Colored
-        SetConsoleTextAttribute(hStdout, 10);
+        console::set_color(sink, console::GREEN);
       } else { // Gray color
-        SetConsoleTextAttribute(hStdout, 8);
+        console::set_color(sink, console::GRAY);
       }
-      std::cout << std::setw(10) << i;
+      sink.number(i, 10);
     }
   }
-  // Reset color to white
-  if (verbose) { SetConsoleTextAttribute(hStdout, 15); }
+  if (verbose) {
+    console::reset_color(sink);
+    sink.flush();
+  }
 }
 
 
 // Extended Euclidean algorithm
+// Iterative extended Euclid, (x, y) with ax + by = gcd(a, b) >= 0
 auto mutils::extended_gcd(int a, int b) -> std::tuple<int, int>
 {
-  if (a == 0) {
-    return std::make_tuple(0, 1);
+  long long r0 = a, r1 = b;
+  long long x0 = 1, x1 = 0;
+  long long y0 = 0, y1 = 1;
+
+  while (r1 != 0) {
+    long long q = r0 / r1;
+    std::tie(r0, r1) = std::make_tuple(r1, r0 - q * r1);
+    std::tie(x0, x1) = std::make_tuple(x1, x0 - q * x1);
+    std::tie(y0, y1) = std::make_tuple(y1, y0 - q * y1);
   }
 
-  int x, y;
-
-  // unpack tuple returned by function into variables
-  std::tie(x, y) = extended_gcd(b % a, a);
-
-  return std::make_tuple((y - (b/a) * x), x);
+  if (r0 < 0) { x0 = -x0; y0 = -y0; }
+  return std::make_tuple((int)x0, (int)y0);
 }
 
 
-// https://www.techiedelight.com/find-general-solution-linear-diophantine-equation/
 void mutils::linear_diophantine(int a, int b, int g)
 {
-  int a1, b1, g1;
-  int x, y, x1, y1;
-
   std::printf("\nEquation: %dx + %dy = %d\n\n", a, b, g);
 
-  int d = gcd(a, b, false);
-  std::printf("GCD(%d, %d) = %d\n\n", a, b, d);
+  const long long d = gcd(a, b, false);
+  std::printf("GCD(%d, %d) = %lld\n\n", a, b, d);
 
-  if (d % g != 0) {
-    std::cout << "The given equation has INFINITE SOLUTIONS\n" << std::endl;
-  } else {
+  // Solvable iff the gcd divides g, solved in long long as x0 can outgrow int
+  LinearDiophantine<long long> eq(a, b, g);
+  if (!eq.solvable()) {
     std::cout << "The given equation has NO SOLUTION\n" << std::endl;
     return;
   }
+  std::cout << "The given equation has INFINITE SOLUTIONS\n" << std::endl;
+  if (d == 0) { return; }
 
-  a1 = a / d;
-  b1 = b / d;
-  g1 = g / d;
+  std::printf("Reduced Diophantine Equation: %lldx + %lldy = %lld\n\n", a / d, b / d, g / d);
 
-  std::printf("Reduced Diophantine Equation: %dx + %dy = %d\n\n", a1, b1, g1);
+  std::cout << "General solution:" << std::endl;
+  std::printf("\tx = %lld + %lldk\n", eq.x0(), eq.step_x());
+  std::printf("\ty = %lld - %lldk   for any integer k\n\n", eq.y0(), -eq.step_y());
 
-  std::tie(x1, y1) = extended_gcd(a1, b1);
-  x = (g / d) * x1;
-  y = (g / d) * y1;
+  long long count = eq.count_nonnegative();
+  if (count < 0) {
+    std::cout << "Non-negative solutions: infinitely many\n" << std::endl;
+  } else {
+    std::printf("Non-negative solutions: %lld\n\n", count);
+  }
+}
 
-  std::cout << "General solution:" << std::endl;
-  std::printf("\tx = %d + %dk\n", x, b / d);
-  std::printf("\ty = %d - %dk   for any integer k\n\n", y, a / d);
+
+// Prints every partition of n, see PartitionGenerator for consuming them
+// without printing
+auto mutils::partitions(int n) -> unsigned long long
+{
+  PartitionGenerator gen(n);
+  unsigned long long parts = 0;
+  while (gen.next()) {
+    print_array(gen.data(), static_cast<int>(gen.size()));
+    ++parts;
+  }
+  OutputSink::standard().flush();
+  return parts;
 }
 
 
-// https://www.geeksforgeeks.org/generate-unique-partitions-of-an-integer/
-auto mutils::partitions(int n) -> int
+// Splits the partitions of n into subtrees by their largest part, and by
+// their second largest part when a subtree is much bigger than an even share,
+// returned as the prefixes of those subtrees. Sizes are estimated with the
+// restricted partition counts P(m, k) (parts of m no larger than k) and the
+// largest come first so the pool finishes evenly.
+auto mutils::partitions_tasks(int n, unsigned int workers) -> std::vector<std::vector<int>>
 {
-  int p[(size_t)n];
-  int k = 0;
-  p[k] = n;
+  std::vector<std::vector<int>> tasks;
+  if (n <= 0) {
+    tasks.push_back(std::vector<int>());
+    return tasks;
+  }
+
+  // P(m, k) = P(m, k - 1) + P(m - k, k), in double as only ratios matter
+  const size_t size = (size_t)n + 1;
+  std::vector<double> restricted(size * size, 0.0);
+  for (size_t k = 0; k < size; ++k) { restricted[k] = 1.0; }
+  for (size_t m = 1; m < size; ++m) {
+    for (size_t k = 1; k < size; ++k) {
+      restricted[m * size + k] = restricted[m * size + k - 1] +
+        (m >= k ? restricted[(m - k) * size + k] : 0.0);
+    }
+  }
+  auto count = [&](int m, int k) {
+    return restricted[(size_t)m * size + (size_t)std::min(m, k)];
+  };
 
-  int parts = 0;
-  // This loop first prints current partition then generates next
-  // partition. The loop stops when the current partition has all 1s
-  while (true)
+  const double share = count(n, n) / (16.0 * std::max(workers, 1u));
+
+  std::vector<std::pair<double, std::vector<int>>> weighted;
+  for (int first = n; first >= 1; --first) {
+    int rest = n - first;
+    if (count(rest, first) <= share || rest == 0) {
+      weighted.push_back(std::make_pair(count(rest, first), std::vector<int>{first}));
+      continue;
+    }
+    for (int second = std::min(first, rest); second >= 1; --second) {
+      weighted.push_back(std::make_pair(count(rest - second, second),
+                                        std::vector<int>{first, second}));
+    }
+  }
+
+  std::stable_sort(weighted.begin(), weighted.end(),
+                   [](const std::pair<double, std::vector<int>>& lhs,
+                      const std::pair<double, std::vector<int>>& rhs) {
+                     return lhs.first > rhs.first;
+                   });
+  for (auto& task : weighted) { tasks.push_back(std::move(task.second)); }
+  return tasks;
+}
+
+
+auto mutils::partitions_parallel_count(int n, unsigned int threads) -> unsigned long long
+{
+  if (n < 0) { return 0; }
+  return partitions_parallel(
+      n, 0ULL,
+      [](unsigned long long& count, const int*, size_t) { ++count; },
+      [](unsigned long long& into, const unsigned long long& from) { into += from; },
+      threads);
+}
+
+
+// Euler's pentagonal number theorem
+//   p(m) = sum_{k >= 1} (-1)^(k+1) [p(m - k(3k-1)/2) + p(m - k(3k+1)/2)]
+// Positive and negative terms are summed separately so every BigInt addition
+// works on magnitudes only, and the whole table costs O(n^1.5) additions.
+// https://en.wikipedia.org/wiki/Pentagonal_number_theorem
+auto mutils::partitions_table(int n) -> std::vector<BigInt>
+{
+  if (n < 0) { return std::vector<BigInt>(); }
+
+  std::vector<BigInt> p{1};
+  partitions_table_extend(p, n);
+  return p;
+}
+
+
+// Table p(0..m) to p(0..n), the recurrence only reads earlier entries
+void mutils::partitions_table_extend(std::vector<BigInt>& p, int n)
+{
+  if (n < 0 || (size_t)n < p.size()) { return; }
+
+  const int first = (int)p.size();
+  p.resize((size_t)n + 1);
+  instrument::count(instrument::COUNTER_PARTITION_ROWS, (unsigned long long)(n + 1 - first));
+  instrument::ScopedTimer timer(instrument::TIMER_PARTITIONS_TABLE);
+
+  BigInt add;
+  BigInt sub;
+  for (int m = first; m <= n; ++m) {
+    add = 0;
+    sub = 0;
+    for (int k = 1; ; ++k) {
+      int g1 = k * (3 * k - 1) / 2;
+      if (g1 > m) { break; }
+      int g2 = g1 + k;  // k(3k+1)/2
+
+      BigInt& acc = (k % 2 == 1) ? add : sub;
+      acc += p[(size_t)(m - g1)];
+      if (g2 <= m) { acc += p[(size_t)(m - g2)]; }
+    }
+    add -= sub;
+    p[(size_t)m] = std::move(add);
+  }
+}
+
+
+// Past a few thousand the Rademacher series beats the O(n^1.5) recurrence,
+// bench_partitions checks the two agree up to n = 20000.
+auto mutils::partitions_count(int n) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+  if (n >= PARTITIONS_HRR_FROM) { return partitions_hrr(n); }
+  return partitions_table(n).back();
+}
+
+
+namespace {
+  // Rademacher's bound on the error after N terms of the series, see
+  // D. H. Lehmer, "On the series for the partition function" (1938).
+  double hrr_remainder_bound(double n, double N)
   {
-    print_array(p, k+1);
-    ++parts;
+    const double pi = 3.14159265358979323846;
+    return 44.0 * pi * pi / (225.0 * std::sqrt(3.0)) / std::sqrt(N) +
+      pi * std::sqrt(2.0) / 75.0 * std::sqrt(N / (n - 1.0)) *
+      std::sinh(pi / N * std::sqrt(2.0 * n / 3.0));
+  }
+
+  // Values of l in [0, 2k) with (3l^2 + l)/2 = -n (mod k), the only
+  // contributions to A_k(n) in Selberg's formula
+  //   A_k(n) = sqrt(k/3) sum_l (-1)^l cos(pi(6l + 1)/(6k)).
+  // Each l is returned as r in [0, 6k] with cos(pi r/(6k)) signed by (-1)^l.
+  std::vector<std::pair<long long, int>> hrr_selberg_terms(int n, int k)
+  {
+    std::vector<std::pair<long long, int>> terms;
+    const long long kk = k;
+    long long target = (kk - n % kk) % kk;
+    long long pentagonal = 0;  // (3l^2 + l)/2 mod k, stepped by 3l + 2
+    for (long long l = 0; l < 2 * kk; ++l) {
+      if (pentagonal == target) {
+        long long r = (6 * l + 1) % (12 * kk);
+        if (r > 6 * kk) { r = 12 * kk - r; }
+        terms.push_back(std::make_pair(r, l % 2 == 0 ? 1 : -1));
+      }
+      pentagonal = (pentagonal + 3 * l + 2) % kk;
+    }
+    return terms;
+  }
+}
+
+
+// Hardy-Ramanujan-Rademacher formula
+//   p(n) = sum_{k=1}^{N} A_k(n) k (mu cosh(mu) - sinh(mu)) / (2 sqrt(6) pi lambda^3)
+// where lambda = sqrt(n - 1/24) and mu = pi sqrt(2/3) lambda / k. N is the
+// fewest terms whose remainder bound is below 1/4, and each term is evaluated
+// with just enough digits for its own magnitude: the leading terms as BigFloat,
+// the long tail in double. Terms are claimed from a shared counter by up to
+// `threads` workers (0 for all cores, 1 under a memory::Scope budget) and the
+// partial sums merged at the end.
+// https://en.wikipedia.org/wiki/Partition_function_(number_theory)
+auto mutils::partitions_hrr(int n, unsigned int threads) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+  if (n < 2) { return BigInt(1); }
+  instrument::ScopedTimer timer(instrument::TIMER_PARTITIONS_HRR);
+
+  const double pi = 3.14159265358979323846;
+  const double nd = static_cast<double>(n);
+  const double lambda = std::sqrt(nd - 1.0 / 24.0);
+  const double muScale = pi * std::sqrt(2.0 / 3.0) * lambda;
+  const double log10Scale = -std::log10(2.0 * std::sqrt(6.0) * pi * lambda * lambda * lambda);
+
+  int terms = 1;
+  while (hrr_remainder_bound(nd, terms) >= 0.25) { ++terms; }
+
+  // Digits needed for term k to stay within 10^-guard of its true value
+  const int guard = static_cast<int>(std::ceil(std::log10(static_cast<double>(terms)))) + 6;
+  auto term_digits = [&](int k) -> int {
+    double mu = muScale / k;
+    double log10Bound = 2.0 * std::log10(static_cast<double>(k)) + std::log10(mu) +
+      mu / std::log(10.0) + log10Scale;
+    return std::max(static_cast<int>(std::ceil(log10Bound)), 0) + guard;
+  };
+  auto extra_digits = [&](int k) -> int {
+    return static_cast<int>(std::ceil(std::log10(std::max(muScale / k, 1.0)))) + 2;
+  };
+
+  // Shared constants at the precision of the first, largest term
+  const size_t maxPrecision = static_cast<size_t>(term_digits(1) + extra_digits(1) + 5);
+  const BigFloat piHigh = BigFloat::pi(maxPrecision);
+  const BigFloat lambdaHigh = BigFloat::sqrt(
+      BigFloat(BigInt(24LL * n - 1), 0, maxPrecision) / BigFloat(BigInt(24), 0, maxPrecision));
+  const BigFloat muScaleHigh = piHigh * lambdaHigh *
+    BigFloat::sqrt(BigFloat(BigInt(2), 0, maxPrecision) / BigFloat(BigInt(3), 0, maxPrecision));
+  const BigFloat scaleHigh = BigFloat(BigInt(1), 0, maxPrecision) /
+    (BigFloat(BigInt(2), 0, maxPrecision) * BigFloat::sqrt(BigFloat(BigInt(6), 0, maxPrecision)) *
+     piHigh * lambdaHigh * lambdaHigh * lambdaHigh);
+
+  if (threads == 0) { threads = std::max(std::thread::hardware_concurrency(), 1u); }
+  if (memory::limited()) { threads = 1; }
+  threads = std::min(threads, static_cast<unsigned int>(terms));
+
+  std::atomic<int> next(1);
+  std::vector<BigFloat> partialHigh(threads, BigFloat(maxPrecision));
+  std::vector<double> partialLow(threads, 0.0);
+
+  auto worker = [&](unsigned int id) {
+    for (int k = next++; k <= terms; k = next++) {
+      const std::vector<std::pair<long long, int>> selberg = hrr_selberg_terms(n, k);
+      if (selberg.empty()) { continue; }
+
+      const int digits = term_digits(k);
+      const double denom = 6.0 * k;
+
+      // Low precision tail
+      if (digits + static_cast<int>(std::ceil(std::log10(static_cast<double>(k)))) + 1 <= 15) {
+        instrument::count(instrument::COUNTER_HRR_TERMS_DOUBLE);
+        double cosSum = 0.0;
+        for (const auto& term : selberg) {
+          cosSum += term.second * std::cos(pi * static_cast<double>(term.first) / denom);
+        }
+        double mu = muScale / k;
+        partialLow[id] += cosSum * (mu * std::cosh(mu) - std::sinh(mu)) * k *
+          std::pow(10.0, log10Scale);
+        continue;
+      }
+
+      instrument::count(instrument::COUNTER_HRR_TERMS_BIGFLOAT);
+      const size_t precision = static_cast<size_t>(digits + extra_digits(k));
+      const BigFloat piK = BigFloat(piHigh).set_precision(precision);
+      const BigFloat kFloat(BigInt(k), 0, precision);
+
+      BigFloat cosSum(precision);
+      for (const auto& term : selberg) {
+        BigFloat angle = piK * BigFloat(BigInt(term.first), 0, precision) /
+          BigFloat(BigInt(6LL * k), 0, precision);
+        if (term.second > 0) {
+          cosSum += BigFloat::cos(angle);
+        } else {
+          cosSum -= BigFloat::cos(angle);
+        }
+      }
+
+      const BigFloat mu = BigFloat(muScaleHigh).set_precision(precision) / kFloat;
+      const BigFloat expMu = BigFloat::exp(mu);
+      const BigFloat expNegMu = BigFloat(BigInt(1), 0, precision) / expMu;
+      const BigFloat half(BigInt(5), -1, precision);
+      const BigFloat coshMu = (expMu + expNegMu) * half;
+      const BigFloat sinhMu = (expMu - expNegMu) * half;
 
-    // Find the rightmost non-one value in p[]. Also, update the
-    // rem_val to know how much value can be accommodated
-    int rem_val = 0;
-    while (k >= 0 && p[k] == 1) {
-        rem_val += p[k];
-        k--;
+      partialHigh[id] += cosSum * (mu * coshMu - sinhMu) * kFloat *
+        BigFloat(scaleHigh).set_precision(precision);
     }
+  };
 
-    if (k < 0) break;
+  ThreadGroup group;
+  for (unsigned int id = 1; id < threads; ++id) {
+    group.spawn([&worker, id] { worker(id); });
+  }
+  worker(0);
+  group.join();
+
+  BigFloat sum(maxPrecision);
+  for (unsigned int id = 0; id < threads; ++id) {
+    sum += partialHigh[id];
+    sum += BigFloat(partialLow[id], maxPrecision);
+  }
+  return sum.to_bigint();
+}
 
-    // Decrease the p[k] found above and adjust the rem_val
-    p[k]--;
-    rem_val++;
 
-    // If rem_val is more, then the sorted order is violated. Divide
-    // rem_val in different values of size p[k] and copy these values at
-    // different positions after p[k]
-    while (rem_val > p[k]) {
-      p[k+1] = p[k];
-      rem_val = rem_val - p[k];
-      k++;
+// Returns the first m in [0, n] where partitions_hrr(m) disagrees with the
+// pentagonal recurrence, or -1 if they all agree.
+auto mutils::verify_partitions_hrr(int n, unsigned int threads) -> int
+{
+  std::vector<BigInt> table = partitions_table(n);
+  for (int m = 0; m <= n; ++m) {
+    if (partitions_hrr(m, threads) != table[(size_t)m]) { return m; }
+  }
+  return -1;
+}
+
+
+namespace {
+  // Advances a Bell (Aitken) triangle row of length i to row i in place. The
+  // new row starts with the old row's last entry and every following entry
+  // is its left neighbour plus the old entry above-left, carried in `above`
+  // so entries are moved rather than copied.
+  void bell_next_row(std::vector<BigInt>& row)
+  {
+    BigInt above(row.back());
+    std::swap(above, row[0]);
+    row.emplace_back();
+
+    for (size_t j = 1; j < row.size(); ++j) {
+      BigInt next(std::move(row[j]));
+      above += row[j - 1];
+      row[j] = std::move(above);
+      above = std::move(next);
     }
+  }
+}
+
+
+// Bell numbers B(0..n) from a single rolling row of the Bell triangle,
+// O(n^2) BigInt additions with O(n) live BigInts. B(i) is the last entry of
+// row i - 1.
+// https://en.wikipedia.org/wiki/Bell_triangle
+auto mutils::bell_numbers(int n) -> std::vector<BigInt>
+{
+  if (n < 0) { return std::vector<BigInt>(); }
+
+  std::vector<BigInt> bells{1, 1};
+  std::vector<BigInt> row{1};
+  bells.reserve((size_t)n + 1);
+  row.reserve((size_t)n);
+  bell_numbers_extend(bells, row, n);
+  bells.resize((size_t)n + 1);
+  return bells;
+}
 
-    // Copy rem_val to next position and increment position
-    p[k+1] = rem_val;
-    k++;
+
+// Bell numbers B(0..m), m >= 1, with the Bell triangle row m - 1 they end
+// with, to B(0..n) and row n - 1
+void mutils::bell_numbers_extend(std::vector<BigInt>& bells, std::vector<BigInt>& row, int n)
+{
+  for (int i = (int)bells.size(); i <= n; ++i) {
+    bell_next_row(row);
+    bells.push_back(row.back());
   }
+}
 
-  return parts;
+
+auto mutils::bell(int n) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+
+  std::vector<BigInt> row;
+  row.reserve((size_t)n);
+  row.push_back(1);
+  for (int i = 1; i < n; ++i) { bell_next_row(row); }
+  return row.back();
 }
 
 
-// https://www.geeksforgeeks.org/bell-numbers-number-of-ways-to-partition-a-set/
-auto mutils::partitions_bell(int n) -> BigInt
+namespace {
+  // Rows shorter than this are cheaper to advance on the calling thread
+  const size_t PARALLEL_ROW_MIN = 256;
+
+  // Runs body(block, begin, end) over [0, count) split into contiguous blocks,
+  // one per pool worker, and returns once all of them are done. A pool of one
+  // runs it on the calling thread, where a memory::Scope counts it.
+  void parallel_blocks(mutils::ThreadPool& pool, size_t count,
+                       const std::function<void(size_t, size_t, size_t)>& body)
+  {
+    const size_t blocks = pool.size();
+    if (blocks == 1) {
+      body(0, 0, count);
+      return;
+    }
+    for (size_t block = 0; block < blocks; ++block) {
+      size_t begin = count * block / blocks;
+      size_t end = count * (block + 1) / blocks;
+      pool.submit([&body, block, begin, end](unsigned int) { body(block, begin, end); });
+    }
+    pool.wait();
+  }
+
+  // Bell triangle row i - 1 (in row) to row i (into next) as a blocked scan:
+  // next[j] = row.back() + row[0] + ... + row[j - 1]. Each block sums its
+  // slice of row, the block offsets are scanned serially, then each block
+  // writes its running sums starting from its offset.
+  void bell_next_row_parallel(mutils::ThreadPool& pool, const std::vector<BigInt>& row,
+                              std::vector<BigInt>& next, std::vector<BigInt>& offsets)
+  {
+    const size_t count = row.size();
+    next.resize(count + 1);
+    offsets.assign(pool.size() + 1, BigInt(0));
+
+    parallel_blocks(pool, count, [&](size_t block, size_t begin, size_t end) {
+      BigInt total(0);
+      for (size_t j = begin; j < end; ++j) { total += row[j]; }
+      offsets[block + 1] = std::move(total);
+    });
+
+    offsets[0] = row.back();
+    for (size_t block = 1; block < offsets.size(); ++block) {
+      offsets[block] += offsets[block - 1];
+    }
+
+    parallel_blocks(pool, count, [&](size_t block, size_t begin, size_t end) {
+      BigInt sum(offsets[block]);
+      if (block == 0) { next[0] = sum; }
+      for (size_t j = begin; j < end; ++j) {
+        sum += row[j];
+        next[j + 1] = sum;
+      }
+    });
+  }
+
+  // Stirling numbers of the second kind, row i - 1 to row i:
+  // S(i, k) = k S(i - 1, k) + S(i - 1, k - 1). Entries are independent so
+  // blocks of k need no coordination.
+  void stirling2_next_row(mutils::ThreadPool* pool, const std::vector<BigInt>& row,
+                          std::vector<BigInt>& next)
+  {
+    const size_t count = row.size() + 1;
+    next.resize(count);
+
+    auto body = [&](size_t, size_t begin, size_t end) {
+      for (size_t k = begin; k < end; ++k) {
+        if (k == 0) { next[k] = 0; continue; }
+        if (k == count - 1) { next[k] = row[k - 1]; continue; }
+        next[k] = row[k];
+        next[k] *= BigInt(static_cast<unsigned long long>(k));
+        next[k] += row[k - 1];
+      }
+    };
+
+    if (pool == nullptr || count < PARALLEL_ROW_MIN) {
+      body(0, 0, count);
+    } else {
+      parallel_blocks(*pool, count, body);
+    }
+  }
+}
+
+
+// Bell numbers B(0..n) like bell_numbers, with every row of the Bell triangle
+// from PARALLEL_ROW_MIN entries on advanced by a blocked parallel scan on
+// threads workers (0 for all cores). A scan does two additions per entry, so
+// it pays off from three cores on.
+auto mutils::bell_numbers_parallel(int n, unsigned int threads) -> std::vector<BigInt>
 {
-  BigInt bell[n + 1][n + 1];
-  bell[0][0] = 1;
-  for (int i = 1; i <= n; i++) {
-    bell[i][0] = bell[i - 1][i-1];
+  if (n < 0) { return std::vector<BigInt>(); }
+  if (memory::limited()) { threads = 1; }
 
-    for (int j = 1; j <= i; j++) {
-      bell[i][j] = bell[i - 1][j - 1] + bell[i][j - 1];
+  ThreadPool pool(threads);
+  std::vector<BigInt> bells;
+  bells.reserve((size_t)n + 1);
+  bells.push_back(1);
+
+  std::vector<BigInt> row{1};
+  std::vector<BigInt> next;
+  std::vector<BigInt> offsets;
+  for (int i = 1; i <= n; ++i) {
+    bells.push_back(row.back());
+    if (i == n) { break; }
+
+    if (pool.size() == 1 || row.size() < PARALLEL_ROW_MIN) {
+      bell_next_row(row);
+    } else {
+      bell_next_row_parallel(pool, row, next, offsets);
+      row.swap(next);
     }
   }
-  return bell[n][0];
+  return bells;
+}
+
+
+auto mutils::bell_parallel(int n, unsigned int threads) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+  return bell_numbers_parallel(n, threads).back();
+}
+
+
+// Row S(n, 0..n) of the Stirling numbers of the second kind, rows advanced in
+// parallel on threads workers (0 for all cores).
+// https://en.wikipedia.org/wiki/Stirling_numbers_of_the_second_kind
+auto mutils::stirling2_row(int n, unsigned int threads) -> std::vector<BigInt>
+{
+  if (n < 0) { return std::vector<BigInt>(); }
+
+  std::vector<BigInt> row{1};
+  stirling2_row_extend(row, n, threads);
+  return row;
+}
+
+
+// Row S(m, 0..m) to S(n, 0..n)
+void mutils::stirling2_row_extend(std::vector<BigInt>& row, int n, unsigned int threads)
+{
+  if (n < 0 || (size_t)n < row.size()) { return; }
+  if (memory::limited()) { threads = 1; }
+
+  ThreadPool pool(threads);
+  std::vector<BigInt> next;
+  for (int i = (int)row.size(); i <= n; ++i) {
+    stirling2_next_row(pool.size() > 1 ? &pool : nullptr, row, next);
+    row.swap(next);
+  }
+}
+
+
+// Single S(n, k), only columns 0..k of each row are needed
+auto mutils::stirling2(int n, int k) -> BigInt
+{
+  if (n < 0 || k < 0 || k > n) { return BigInt(0); }
+
+  std::vector<BigInt> columns((size_t)k + 1, BigInt(0));
+  columns[0] = 1;
+  stirling2_columns_extend(columns, 0, n);
+  return columns[(size_t)k];
+}
+
+
+// Columns S(m, 0..k) to S(n, 0..k)
+void mutils::stirling2_columns_extend(std::vector<BigInt>& columns, int m, int n)
+{
+  const size_t k = columns.size() - 1;
+  for (int i = m + 1; i <= n; ++i) {
+    for (size_t j = std::min((size_t)i, k); j >= 1; --j) {
+      columns[j] *= BigInt(static_cast<unsigned long long>(j));
+      columns[j] += columns[j - 1];
+    }
+    columns[0] = 0;
+  }
+}
+
+
+// Kept for existing callers, same as bell(n)
+auto mutils::partitions_bell(int n) -> BigInt
+{
+  return bell(n);
 }
 
 
 // GCD or GCF using Euclidian Algorithm
-auto mutils::gcd(int a, int b, bool verbose) -> int
+// Euclid on the absolute values, printing every division step if verbose.
+// gcd(a, 0) = |a| and gcd(0, 0) = 0. Returned as long long since
+// gcd(INT_MIN, 0) and gcd(INT_MIN, INT_MIN) are 2^31, which int cannot hold.
+auto mutils::gcd(int a, int b, bool verbose) -> long long
 {
-  int big;
-  int small;
-  if (a > b) {
-    big = a; small = b;
+  long long big = std::max(std::llabs(a), std::llabs(b));
+  long long small = std::min(std::llabs(a), std::llabs(b));
+  if (!verbose) { return (long long)binary_gcd((unsigned long long)big, (unsigned long long)small); }
+
+  while (small != 0) {
+    long long remainder = big % small;
+    std::printf("%10lld = %lld(%lld) + %lld\n", big, small, big / small, remainder);
+    big = small;
+    small = remainder;
+  }
+  return big;
+}
+
+
+// Stein's binary gcd, subtractions and shifts only
+auto mutils::binary_gcd(unsigned long long a, unsigned long long b) -> unsigned long long
+{
+  if (a == 0) { return b; }
+  if (b == 0) { return a; }
+
+  // Min and absolute difference through a sign mask, as compilers tend to
+  // branch on a ternary here and the branch is unpredictable. b - a has the
+  // trailing zeros of |b - a|, so the shift does not wait on the mask.
+  const int shift = __builtin_ctzll(a | b);
+  a >>= __builtin_ctzll(a);
+  b >>= __builtin_ctzll(b);
+  while (a != b) {
+    const unsigned long long diff = b - a;
+    const unsigned long long mask = 0ULL - (unsigned long long)(a > b);
+    const int zeros = __builtin_ctzll(diff);
+    a += diff & mask;
+    b = ((diff ^ mask) - mask) >> zeros;
+  }
+  return a << shift;
+}
+
+
+namespace {
+  // Decimal digits of the 64 bit leading words in Lehmer's algorithm
+  const size_t LEHMER_DIGITS = 18;
+
+  // num / 10^shift for a quotient below 10^18, read off the three limbs it
+  // can span
+  long long leading_digits(const BigInt& num, size_t shift)
+  {
+    const BigInt::Limbs& limbs = num.limbs();
+    const size_t whole = shift / 9;
+    unsigned long long pow = 1;
+    for (size_t i = 0; i < shift % 9; ++i) { pow *= 10; }
+    auto limb = [&](size_t i) -> unsigned long long {
+      return whole + i < limbs.size() ? limbs[whole + i] : 0;
+    };
+
+    const unsigned long long high = limb(2) * 1000000000 + limb(1);
+    return (long long)(high / pow * 1000000000 + (high % pow * 1000000000 + limb(0)) / pow);
+  }
+
+  /**
+   * Knuth's Algorithm L (TAOCP 4.5.2) on the non-negative a >= b. The
+   * quotients of Euclid on the leading words are collected into the matrix
+   * (A B; C D) for as long as they provably match the quotients of the full
+   * numbers, then applied in one step. When no quotient is certain a full
+   * division step is taken. If x0 and x1 are given they are carried along
+   * as the Bezout coefficients of the original a. With stopAtWord the loop
+   * stops once a fits the leading word, for a native finish.
+   */
+  void lehmer_reduce(BigInt& a, BigInt& b, BigInt* x0, BigInt* x1, bool stopAtWord)
+  {
+    BigInt q, r;
+    while (!b.is_zero()) {
+      const size_t digits = a.digit_count();
+      if (stopAtWord && digits <= LEHMER_DIGITS) { return; }
+
+      const size_t shift = digits > LEHMER_DIGITS ? digits - LEHMER_DIGITS : 0;
+      long long ah = leading_digits(a, shift);
+      long long bh = leading_digits(b, shift);
+      long long A = 1, B = 0, C = 0, D = 1;
+
+      while (bh + C != 0 && bh + D != 0) {
+        const long long quot = (ah + A) / (bh + C);
+        if (quot != (ah + B) / (bh + D)) { break; }
+        long long t = A - quot * C; A = C; C = t;
+        t = B - quot * D; B = D; D = t;
+        t = ah - quot * bh; ah = bh; bh = t;
+      }
+
+      if (B == 0) {
+        BigInt::divmod(a, b, q, r);
+        a = std::move(b);
+        b = std::move(r);
+        if (x0 != nullptr) {
+          BigInt next = *x0 - q * *x1;
+          *x0 = std::move(*x1);
+          *x1 = std::move(next);
+        }
+      } else {
+        BigInt nextA = a * BigInt(A) + b * BigInt(B);
+        b = a * BigInt(C) + b * BigInt(D);
+        a = std::move(nextA);
+        if (x0 != nullptr) {
+          BigInt next0 = *x0 * BigInt(A) + *x1 * BigInt(B);
+          *x1 = *x0 * BigInt(C) + *x1 * BigInt(D);
+          *x0 = std::move(next0);
+        }
+      }
+    }
+  }
+}
+
+
+// Lehmer's gcd, the last 64 bits finished by binary_gcd
+auto mutils::lehmer_gcd(const BigInt& m, const BigInt& n) -> BigInt
+{
+  BigInt a = BigInt::abs(m);
+  BigInt b = BigInt::abs(n);
+  if (a < b) { std::swap(a, b); }
+
+  lehmer_reduce(a, b, nullptr, nullptr, true);
+  if (b.is_zero()) { return a; }
+  return BigInt(binary_gcd((unsigned long long)leading_digits(a, 0), (unsigned long long)leading_digits(b, 0)));
+}
+
+
+// (g, x, y) with mx + ny = g = gcd(m, n), g >= 0
+auto mutils::extended_lehmer_gcd(const BigInt& m, const BigInt& n) -> std::tuple<BigInt, BigInt, BigInt>
+{
+  const bool swapped = BigInt::abs(m) < BigInt::abs(n);
+  BigInt a = BigInt::abs(swapped ? n : m);
+  BigInt b = BigInt::abs(swapped ? m : n);
+  const BigInt origA = a;
+  const BigInt origB = b;
+
+  BigInt x0(1), x1(0);
+  lehmer_reduce(a, b, &x0, &x1, false);
+
+  // a = origA x0 + origB y
+  BigInt y, rem;
+  if (origB.is_zero()) {
+    y = BigInt(0);
   } else {
-    small = a; big = b;
+    BigInt::divmod(a - origA * x0, origB, y, rem);
   }
 
-  int remainder = big % small;
-  if (verbose) {
-    std::printf("%10d = %d(%d) + %d\n", big, small, big / small, remainder);
+  BigInt x = x0;
+  if (swapped) { std::swap(x, y); }
+  if (!m.is_positive()) { x *= -1; }
+  if (!n.is_positive()) { y *= -1; }
+  return std::make_tuple(a, x, y);
+}
+
+
+namespace {
+  // Runs body(i, share) for every node of a tree level on the pool. Wide
+  // levels go in contiguous blocks, near the root there are fewer nodes
+  // than workers and share is how many threads each node may use.
+  void tree_level(mutils::ThreadPool& pool, size_t count,
+                  const std::function<void(size_t, unsigned int)>& body)
+  {
+    if (count >= pool.size()) {
+      parallel_blocks(pool, count, [&body](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) { body(i, 1); }
+      });
+      return;
+    }
+
+    const unsigned int share = pool.size() / (unsigned int)count;
+    for (size_t i = 0; i < count; ++i) {
+      pool.submit([&body, i, share](unsigned int) { body(i, share); });
+    }
+    pool.wait();
+  }
+}
+
+
+/**
+ * Bernstein's batch gcd: gcd(x_i, product of all x_j with j != i) for every
+ * element, in quasi-linear time instead of n^2 pairwise gcds.
+ *
+ * A product tree gives P = x_1 ... x_n, a remainder tree walks P mod x_i^2
+ * back down to the leaves (reducing modulo the squared node at every level),
+ * and then gcd(x_i, (P mod x_i^2) / x_i) is the wanted gcd. Every level of
+ * both trees runs on a thread pool.
+ *
+ * Signs are ignored. A zero makes the product zero, so with one zero every
+ * other result is |x_i| and the zero's result is the product of the rest.
+ */
+auto mutils::batch_gcd(const std::vector<BigInt>& values, unsigned int threads) -> std::vector<BigInt>
+{
+  const size_t count = values.size();
+  std::vector<BigInt> res(count);
+  if (count == 0) { return res; }
+  if (threads == 0) { threads = ThreadPool::default_threads(); }
+  if (memory::limited()) { threads = 1; }
+
+  std::vector<std::vector<BigInt>> tree(1);
+  size_t zeros = 0;
+  for (const auto& value : values) {
+    tree[0].push_back(BigInt::abs(value));
+    if (value.is_zero()) { ++zeros; }
+  }
+
+  if (zeros > 0) {
+    std::vector<BigInt> rest;
+    for (const auto& value : tree[0]) {
+      if (!value.is_zero()) { rest.push_back(value); }
+    }
+    const BigInt others = zeros == 1 ? product_tree(std::move(rest)) : BigInt(0);
+    for (size_t i = 0; i < count; ++i) { res[i] = tree[0][i].is_zero() ? others : tree[0][i]; }
+    return res;
   }
+  if (count == 1) {
+    res[0] = BigInt(1);
+    return res;
+  }
+
+  ThreadPool pool(threads);
+  while (tree.back().size() > 1) {
+    const std::vector<BigInt>& level = tree.back();
+    std::vector<BigInt> next((level.size() + 1) / 2);
+    tree_level(pool, level.size() / 2, [&level, &next](size_t i, unsigned int share) {
+      next[i] = parallel_multiply(level[2 * i], level[2 * i + 1], share);
+    });
+    if (level.size() % 2 == 1) { next.back() = level.back(); }
+    tree.push_back(std::move(next));
+  }
+
+  // P mod P^2 is P itself
+  std::vector<BigInt> rems(1, tree.back().front());
+  tree.pop_back();
+  while (!tree.empty()) {
+    const std::vector<BigInt>& level = tree.back();
+    std::vector<BigInt> next(level.size());
+    tree_level(pool, level.size(), [&level, &next, &rems](size_t i, unsigned int share) {
+      BigInt quotient;
+      BigInt::divmod(rems[i / 2], parallel_multiply(level[i], level[i], share), quotient, next[i]);
+    });
+    rems.swap(next);
+    if (tree.size() == 1) { break; }
+    tree.pop_back();
+  }
+
+  const std::vector<BigInt>& leaves = tree.front();
+  tree_level(pool, count, [&](size_t i, unsigned int) {
+    BigInt quotient, rem;
+    BigInt::divmod(rems[i], leaves[i], quotient, rem);
+    res[i] = lehmer_gcd(leaves[i], quotient);
+  });
+  return res;
+}
 
-  if (remainder == 0) { return small; }
-  return gcd(small, remainder, verbose);
+
+// 64 bit form. A zero's result is left 0, the product of the others need
+// not fit.
+auto mutils::batch_gcd(const std::vector<unsigned long long>& values, unsigned int threads)
+  -> std::vector<unsigned long long>
+{
+  std::vector<BigInt> wide;
+  wide.reserve(values.size());
+  for (unsigned long long value : values) { wide.emplace_back(value); }
+  const std::vector<BigInt> gcds = batch_gcd(wide, threads);
+
+  std::vector<unsigned long long> res(values.size(), 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (values[i] != 0) { res[i] = std::stoull(gcds[i].to_string()); }
+  }
+  return res;
 }
 
 
-// LCM using GCD
-auto mutils::lcm(int a, int b, bool verbose) -> int
+// |ab| / gcd(a, b), dividing first so nothing overflows. lcm(a, 0) = 0.
+auto mutils::lcm(int a, int b, bool verbose) -> long long
 {
-  int _gcd = gcd(a, b, false);
-  int lcm = (a * b) / _gcd;
   if (verbose) {
     std::printf("(%d * %d)/GCD(%d, %d) = LCM\n", a, b, a, b);
   }
-  return lcm;
+  if (a == 0 || b == 0) { return 0; }
+  const long long _gcd = gcd(a, b, false);
+  return std::llabs(a) / _gcd * std::llabs(b);
+}
+
+
+namespace {
+  unsigned long long magnitude(long long value)
+  {
+    return value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+  }
+
+  // gcd of values[begin, end), halves first so partial results stay small.
+  // Stops early once a half is coprime.
+  unsigned long long gcd_tree(const long long* values, size_t begin, size_t end)
+  {
+    if (end - begin == 1) { return magnitude(values[begin]); }
+    const size_t mid = begin + (end - begin) / 2;
+    const unsigned long long left = gcd_tree(values, begin, mid);
+    if (left == 1) { return 1; }
+    return mutils::binary_gcd(left, gcd_tree(values, mid, end));
+  }
+
+  // Partial lcm, native until a product overflows
+  struct LcmPartial {
+    unsigned long long small = 1;
+    BigInt wide;
+    bool promoted = false;
+
+    LcmPartial() : wide() {}
+    BigInt value() const { return promoted ? wide : BigInt(small); }
+  };
+
+  LcmPartial lcm_combine(const LcmPartial& lhs, const LcmPartial& rhs)
+  {
+    LcmPartial res;
+    if (!lhs.promoted && !rhs.promoted) {
+      if (lhs.small == 0 || rhs.small == 0) {
+        res.small = 0;
+        return res;
+      }
+      const unsigned long long reduced = lhs.small / mutils::binary_gcd(lhs.small, rhs.small);
+      if (!__builtin_mul_overflow(reduced, rhs.small, &res.small)) { return res; }
+      res.wide = BigInt(reduced) * BigInt(rhs.small);
+      res.promoted = true;
+      return res;
+    }
+
+    const BigInt a = lhs.value();
+    const BigInt b = rhs.value();
+    if (a.is_zero() || b.is_zero()) {
+      res.small = 0;
+      return res;
+    }
+    BigInt quotient, rem;
+    BigInt::divmod(a, mutils::lehmer_gcd(a, b), quotient, rem);
+    res.wide = quotient * b;
+    res.promoted = true;
+    return res;
+  }
+
+  LcmPartial lcm_tree(const long long* values, size_t begin, size_t end)
+  {
+    if (end - begin == 1) {
+      LcmPartial leaf;
+      leaf.small = magnitude(values[begin]);
+      return leaf;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    return lcm_combine(lcm_tree(values, begin, mid), lcm_tree(values, mid, end));
+  }
+}
+
+
+// gcd of the magnitudes, 0 for no values. Reduced in a balanced tree.
+auto mutils::gcd_of(const long long* values, size_t count) -> unsigned long long
+{
+  if (count == 0) { return 0; }
+  return gcd_tree(values, 0, count);
+}
+
+
+/**
+ * lcm of the magnitudes, 1 for no values and 0 if any value is 0.
+ *
+ * Reduced in a balanced tree so the operands of every step are of similar
+ * size. Partial results stay in 64 bits as long as __builtin_mul_overflow
+ * says the product fits and are promoted to BigInt from the first overflow
+ * on.
+ */
+auto mutils::lcm_of(const long long* values, size_t count) -> BigInt
+{
+  if (count == 0) { return BigInt(1); }
+  return lcm_tree(values, 0, count).value();
+}
+
+
+auto mutils::gcd_of(const std::vector<int>& values) -> unsigned long long
+{
+  const std::vector<long long> wide(values.begin(), values.end());
+  return gcd_of(wide.data(), wide.size());
+}
+
+
+auto mutils::lcm_of(const std::vector<int>& values) -> BigInt
+{
+  const std::vector<long long> wide(values.begin(), values.end());
+  return lcm_of(wide.data(), wide.size());
+}
+
+
+namespace {
+  __extension__ typedef __int128 Wide;
+  __extension__ typedef unsigned __int128 UnsignedWide;
+
+  // a mod m in [0, m) for m > 0
+  BigInt floor_mod(const BigInt& a, const BigInt& m)
+  {
+    BigInt quotient, rem;
+    BigInt::divmod(a, m, quotient, rem);
+    if (!rem.is_positive()) { rem += m; }
+    return rem;
+  }
+
+  // Inverse of a modulo m > 1, 0 if there is none
+  unsigned long long inverse_mod(unsigned long long a, unsigned long long m)
+  {
+    Wide g, x, y;
+    mutils::detail::extended_gcd((Wide)(a % m), (Wide)m, g, x, y);
+    if (g != 1) { return 0; }
+    x %= (Wide)m;
+    return (unsigned long long)(x < 0 ? x + (Wide)m : x);
+  }
+
+  BigInt inverse_mod(const BigInt& a, const BigInt& m)
+  {
+    auto result = mutils::extended_lehmer_gcd(floor_mod(a, m), m);
+    if (!(std::get<0>(result) == BigInt(1))) { return BigInt(0); }
+    return floor_mod(std::get<1>(result), m);
+  }
+
+  // Partial solution x = residue (mod modulus), native until the modulus
+  // overflows
+  struct CrtPartial {
+    unsigned long long residue = 0;
+    unsigned long long modulus = 1;
+    BigInt wideResidue;
+    BigInt wideModulus;
+    bool promoted = false;
+    bool consistent = true;
+
+    CrtPartial() : wideResidue(), wideModulus() {}
+    BigInt value() const { return promoted ? wideResidue : BigInt(residue); }
+    BigInt period() const { return promoted ? wideModulus : BigInt(modulus); }
+  };
+
+  /**
+   * x = a1 (mod m1) and x = a2 (mod m2) agree iff g = gcd(m1, m2) divides
+   * a2 - a1, and then x = a1 + m1 t (mod lcm) with
+   * t = (a2 - a1)/g (m1/g)^-1 (mod m2/g).
+   */
+  CrtPartial crt_combine(const CrtPartial& lhs, const CrtPartial& rhs)
+  {
+    CrtPartial res;
+    if (!lhs.consistent || !rhs.consistent) {
+      res.consistent = false;
+      return res;
+    }
+
+    if (!lhs.promoted && !rhs.promoted) {
+      const unsigned long long g = mutils::binary_gcd(lhs.modulus, rhs.modulus);
+      const unsigned long long step = rhs.modulus / g;
+      const Wide diff = (Wide)rhs.residue - (Wide)lhs.residue;
+      if (diff % (Wide)g != 0) {
+        res.consistent = false;
+        return res;
+      }
+      if (!__builtin_mul_overflow(lhs.modulus, step, &res.modulus)) {
+        Wide t = diff / (Wide)g % (Wide)step;
+        if (t < 0) { t += (Wide)step; }
+        const UnsignedWide product = (UnsignedWide)t * inverse_mod(lhs.modulus / g, step);
+        res.residue = lhs.residue + lhs.modulus * (unsigned long long)(product % step);
+        return res;
+      }
+    }
+
+    const BigInt m1 = lhs.period(), m2 = rhs.period();
+    const BigInt g = mutils::lehmer_gcd(m1, m2);
+    BigInt quotient, rem, step, reduced;
+    BigInt::divmod(rhs.value() - lhs.value(), g, quotient, rem);
+    if (!rem.is_zero()) {
+      res.consistent = false;
+      return res;
+    }
+    BigInt::divmod(m2, g, step, rem);
+    BigInt::divmod(m1, g, reduced, rem);
+    const BigInt t = floor_mod(floor_mod(quotient, step) * inverse_mod(reduced, step), step);
+    res.wideResidue = lhs.value() + m1 * t;
+    res.wideModulus = m1 * step;
+    res.promoted = true;
+    return res;
+  }
+
+  CrtPartial crt_tree(const std::pair<long long, long long>* congruences, size_t begin, size_t end)
+  {
+    if (end - begin == 1) {
+      CrtPartial leaf;
+      const long long a = congruences[begin].first;
+      const long long m = congruences[begin].second;
+      if (m <= 0) {
+        leaf.consistent = false;
+        return leaf;
+      }
+      leaf.residue = (unsigned long long)(a % m < 0 ? a % m + m : a % m);
+      leaf.modulus = (unsigned long long)m;
+      return leaf;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    CrtPartial left = crt_tree(congruences, begin, mid);
+    if (!left.consistent) { return left; }
+    return crt_combine(left, crt_tree(congruences, mid, end));
+  }
+}
+
+
+/**
+ * Solves x = a (mod m) for every (a, m) pair of congruences, the moduli
+ * positive but not necessarily coprime. On success solution is the one x
+ * in [0, modulus) with modulus the lcm of the moduli. False if two of the
+ * congruences contradict each other or a modulus is not positive.
+ *
+ * Reduced in a balanced tree like lcm_of, so the moduli of every merge are
+ * of similar size and the few BigInt merges sit near the root. A merge
+ * stays in 64 bits while the lcm fits, and a contradiction anywhere stops
+ * the reduction.
+ */
+bool mutils::crt(const std::pair<long long, long long>* congruences, size_t count,
+                 BigInt& solution, BigInt& modulus)
+{
+  if (count == 0) {
+    solution = BigInt(0);
+    modulus = BigInt(1);
+    return true;
+  }
+  const CrtPartial result = crt_tree(congruences, 0, count);
+  if (!result.consistent) { return false; }
+  solution = result.value();
+  modulus = result.period();
+  return true;
+}
+
+
+bool mutils::crt(const std::vector<std::pair<long long, long long>>& congruences,
+                 BigInt& solution, BigInt& modulus)
+{
+  return crt(congruences.data(), congruences.size(), solution, modulus);
+}
+
+
+/**
+ * Inverse of every value modulo modulus by Montgomery's trick: one pass of
+ * prefix products, a single extended gcd inversion of the whole product
+ * and a pass back that peels the values off it one at a time, 3N
+ * multiplications in all.
+ *
+ * Values without an inverse get 0, which is no value's inverse for a
+ * modulus above 1. Only when the product turns out not to be invertible is
+ * every value checked by gcd, and those without an inverse are left out.
+ */
+auto mutils::mod_inverses(const std::vector<unsigned long long>& values, unsigned long long modulus)
+  -> std::vector<unsigned long long>
+{
+  std::vector<unsigned long long> inverses(values.size(), 0);
+  if (modulus <= 1) { return inverses; }
+
+  auto mul = [modulus](unsigned long long a, unsigned long long b) {
+    return (unsigned long long)((UnsignedWide)a * b % modulus);
+  };
+  std::vector<char> skip(values.size(), 0);
+  std::vector<unsigned long long> prefix(values.size());
+  unsigned long long inverse = 0;
+  for (int pass = 0; pass < 2 && inverse == 0; ++pass) {
+    if (pass == 1) {
+      for (size_t i = 0; i < values.size(); ++i) {
+        skip[i] = binary_gcd(values[i] % modulus, modulus) != 1;
+      }
+    }
+    unsigned long long product = 1;
+    for (size_t i = 0; i < values.size(); ++i) {
+      prefix[i] = product;
+      if (!skip[i]) { product = mul(product, values[i] % modulus); }
+    }
+    inverse = inverse_mod(product, modulus);
+  }
+
+  for (size_t i = values.size(); i-- > 0;) {
+    if (skip[i]) { continue; }
+    inverses[i] = mul(inverse, prefix[i]);
+    inverse = mul(inverse, values[i] % modulus);
+  }
+  return inverses;
+}
+
+
+auto mutils::mod_inverses(const std::vector<BigInt>& values, const BigInt& modulus) -> std::vector<BigInt>
+{
+  std::vector<BigInt> inverses(values.size(), BigInt(0));
+  if (!(BigInt(1) < modulus)) { return inverses; }
+
+  std::vector<BigInt> reduced;
+  reduced.reserve(values.size());
+  for (const BigInt& value : values) { reduced.push_back(floor_mod(value, modulus)); }
+
+  std::vector<char> skip(values.size(), 0);
+  std::vector<BigInt> prefix(values.size());
+  BigInt inverse(0);
+  for (int pass = 0; pass < 2 && inverse.is_zero(); ++pass) {
+    if (pass == 1) {
+      for (size_t i = 0; i < values.size(); ++i) {
+        skip[i] = !(lehmer_gcd(reduced[i], modulus) == BigInt(1));
+      }
+    }
+    BigInt product(1);
+    for (size_t i = 0; i < values.size(); ++i) {
+      prefix[i] = product;
+      if (!skip[i]) { product = floor_mod(product * reduced[i], modulus); }
+    }
+    inverse = inverse_mod(product, modulus);
+  }
+
+  for (size_t i = values.size(); i-- > 0;) {
+    if (skip[i]) { continue; }
+    inverses[i] = floor_mod(inverse * prefix[i], modulus);
+    inverse = floor_mod(inverse * reduced[i], modulus);
+  }
+  return inverses;
 }
 
 
@@ -222,13 +1304,626 @@ void mutils::prime_factors(int n, std::vector<int>& primeFactors)
 }
 
 
-auto mutils::factorial(BigInt n) -> BigInt
+namespace {
+  // Miller-Rabin with these bases is exact for every n < 2^64 (Sinclair)
+  const unsigned long long MILLER_RABIN_BASES[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+  // Cofactors are trial divided up to this before Pollard's rho
+  const unsigned long long TRIAL_DIVISION_LIMIT = 1 << 10;
+
+  unsigned long long mul_mod(unsigned long long a, unsigned long long b, unsigned long long m)
+  {
+    return (unsigned long long)((UnsignedWide)a * b % m);
+  }
+
+  bool is_prime_u64(unsigned long long n)
+  {
+    instrument::count(instrument::COUNTER_FACTOR_PRIMALITY);
+    if (n < 2) { return false; }
+    for (unsigned long long p : {2ULL, 3ULL, 5ULL, 7ULL, 11ULL, 13ULL, 17ULL, 19ULL, 23ULL, 29ULL, 31ULL, 37ULL}) {
+      if (n % p == 0) { return n == p; }
+    }
+
+    unsigned long long odd = n - 1;
+    int shift = 0;
+    for (; (odd & 1) == 0; odd >>= 1) { ++shift; }
+
+    for (unsigned long long base : MILLER_RABIN_BASES) {
+      base %= n;
+      if (base == 0) { continue; }
+
+      unsigned long long x = 1;
+      for (unsigned long long exp = odd; exp > 0; exp >>= 1) {
+        if (exp & 1) { x = mul_mod(x, base, n); }
+        base = mul_mod(base, base, n);
+      }
+      if (x == 1 || x == n - 1) { continue; }
+
+      for (int i = 1; i < shift && x != n - 1; ++i) { x = mul_mod(x, x, n); }
+      if (x != n - 1) { return false; }
+    }
+    return true;
+  }
+
+  // Brent's variant of Pollard's rho, a proper factor of the odd composite n.
+  // The differences are multiplied together BATCH at a time so there is one
+  // gcd per batch instead of one per step.
+  unsigned long long pollard_brent(unsigned long long n)
+  {
+    instrument::ScopedTimer timer(instrument::TIMER_FACTOR_RHO);
+    const size_t BATCH = 128;
+    for (unsigned long long c = 1;; ++c) {
+      auto step = [n, c](unsigned long long v) {
+        return (unsigned long long)(((UnsignedWide)v * v + c) % n);
+      };
+
+      unsigned long long x = 2, y = 2, saved = 2, product = 1, g = 1;
+      for (size_t length = 1; g == 1; length <<= 1) {
+        x = y;
+        for (size_t i = 0; i < length; ++i) { y = step(y); }
+        for (size_t done = 0; done < length && g == 1; done += BATCH) {
+          saved = y;
+          for (size_t i = 0; i < std::min(BATCH, length - done); ++i) {
+            y = step(y);
+            product = mul_mod(product, x > y ? x - y : y - x, n);
+          }
+          g = mutils::binary_gcd(product, n);
+        }
+      }
+
+      // The batch overshot, redo its steps one gcd at a time
+      if (g == n) {
+        do {
+          saved = step(saved);
+          g = mutils::binary_gcd(x > saved ? x - saved : saved - x, n);
+        } while (g == 1);
+      }
+      if (g != n) { return g; }
+      instrument::count(instrument::COUNTER_FACTOR_RHO_RETRIES);
+    }
+  }
+
+  void factor_rho(unsigned long long n, std::vector<unsigned long long>& factors)
+  {
+    if (n == 1) { return; }
+    if (is_prime_u64(n)) {
+      factors.push_back(n);
+      return;
+    }
+    const unsigned long long factor = pollard_brent(n);
+    factor_rho(factor, factors);
+    factor_rho(n / factor, factors);
+  }
+}
+
+
+/**
+ * Prime factors of n with multiplicity in increasing order, none for n < 2.
+ *
+ * Trial division takes the factors below TRIAL_DIVISION_LIMIT, what is left
+ * is split by Pollard's rho until deterministic Miller-Rabin says prime, so a
+ * 64-bit n costs O(n^1/4) expected steps instead of a sieve up to n.
+ */
+auto mutils::prime_factors(unsigned long long n) -> std::vector<unsigned long long>
+{
+  instrument::count(instrument::COUNTER_FACTOR_CALLS);
+  instrument::record(instrument::HISTOGRAM_FACTOR_BITS, n == 0 ? 0 : (unsigned long long)(64 - __builtin_clzll(n)));
+
+  std::vector<unsigned long long> factors;
+  for (unsigned long long p = 2; p < TRIAL_DIVISION_LIMIT && p * p <= n; p += p == 2 ? 1 : 2) {
+    for (; n % p == 0; n /= p) { factors.push_back(p); }
+  }
+  instrument::count(instrument::COUNTER_FACTOR_TRIAL, factors.size());
+  if (n > 1) {
+    const size_t small = factors.size();
+    factor_rho(n, factors);
+    std::sort(factors.begin() + (std::ptrdiff_t)small, factors.end());
+  }
+  return factors;
+}
+
+
+// The primes up to n in increasing order, see PrimeGenerator
+auto mutils::prime_table(int n) -> std::vector<int>
+{
+  std::vector<int> primes;
+  // pi(n) < 1.25506 n / ln n (Rosser and Schoenfeld)
+  if (n > 16) { primes.reserve((size_t)(1.25506 * n / std::log((double)n)) + 1); }
+
+  PrimeGenerator(n).for_each([&primes](int p) { primes.push_back(p); });
+  return primes;
+}
+
+
+void mutils::print_primes_by_column(int n, int width, int columns)
 {
-  if (n == 0) {
-    return BigInt(1);
+  ColumnWriter writer(OutputSink::standard(), width, columns);
+  PrimeGenerator(n).for_each([&writer](int p) { writer.add(p); });
+  writer.finish();
+}
+
+
+// Multiplies values pairwise level by level so every multiplication is
+// between operands of similar size, which is what Karatsuba pays off on
+auto mutils::product_tree(std::vector<BigInt> values) -> BigInt
+{
+  if (values.empty()) { return BigInt(1); }
+
+  while (values.size() > 1) {
+    size_t half = 0;
+    for (size_t i = 0; i + 1 < values.size(); i += 2) {
+      values[half++] = values[i] * values[i + 1];
+    }
+    if (values.size() % 2 == 1) { values[half++] = std::move(values.back()); }
+    values.resize(half);
   }
+  return values.front();
+}
+
+
+namespace {
+  // Below this n the prime swing recursion stops and the product tree is used
+  const int SWING_CUTOFF = 32;
+  // Fewer factors than this are multiplied on the calling thread
+  const size_t PARALLEL_PRODUCT_MIN = 4096;
+  // Operands shorter than this are multiplied on a single thread
+  const size_t PARALLEL_MULTIPLY_DIGITS = 50000;
+
+  // Packs factor(first) .. factor(last - 1) into 64 bit leaves for a product
+  // tree, so the tree starts from two limb numbers instead of single factors
+  std::vector<BigInt> pack_leaves(size_t first, size_t last,
+                                  const std::function<unsigned long long(size_t)>& factor)
+  {
+    std::vector<BigInt> leaves;
+    unsigned long long leaf = 1;
+    for (size_t i = first; i < last; ++i) {
+      unsigned long long value = factor(i);
+      if (value == 0) { return std::vector<BigInt>(1, BigInt(0)); }
+      if (leaf > std::numeric_limits<unsigned long long>::max() / value) {
+        leaves.emplace_back(leaf);
+        leaf = 1;
+      }
+      leaf *= value;
+    }
+    leaves.emplace_back(leaf);
+    return leaves;
+  }
+
+  /**
+   * Factors of the swing number n! / (floor(n/2)!)^2 from its factorization.
+   * The exponent of a prime p is the number of odd floor(n / p^i), so primes
+   * in (n/2, n] appear once, those in (n/3, n/2] not at all, and those above
+   * sqrt(n) once if floor(n/p) is odd.
+   */
+  std::vector<unsigned long long> swing_factors(int n, const std::vector<int>& primes)
+  {
+    std::vector<unsigned long long> factors;
+    for (int p : primes) {
+      if (p > n) { break; }
+      if (p > n / 2) {
+        factors.push_back((unsigned long long)p);
+      } else if (p > n / 3) {
+        continue;
+      } else if ((long long)p * p > n) {
+        if ((n / p) % 2 == 1) { factors.push_back((unsigned long long)p); }
+      } else {
+        unsigned long long power = 1;
+        for (int q = n / p; q > 0; q /= p) {
+          if (q % 2 == 1) { power *= (unsigned long long)p; }
+        }
+        if (power > 1) { factors.push_back(power); }
+      }
+    }
+    return factors;
+  }
+
+  // Splits a non-negative value at 10^digits into high and low parts
+  void split_pow10(const BigInt& value, size_t digits, BigInt& high, BigInt& low)
+  {
+    high = value;
+    high.div_pow10(digits);
+    BigInt shifted(high);
+    shifted.mul_pow10(digits);
+    low = value - shifted;
+  }
+}
+
+
+// Product of the integers in [lo, hi], packed into 64 bit leaves first
+auto mutils::product_range(unsigned long long lo, unsigned long long hi) -> BigInt
+{
+  if (lo > hi) { return BigInt(1); }
+  if (lo == 0) { return BigInt(0); }
+  return product_tree(pack_leaves(0, (size_t)(hi - lo) + 1,
+                                  [lo](size_t i) { return lo + i; }));
+}
+
+
+auto mutils::factorial_product_tree(int n) -> BigInt
+{
+  if (n < 0) { return BigInt(0); }
+  return product_range(2, (unsigned long long)std::max(n, 1));
+}
+
+
+// https://oeis.org/A056040
+// n! = (floor(n/2)!)^2 * swing(n), unrolled from the smallest n upward. Only
+// O(log n) large multiplications remain and the swing numbers are products
+// of prime powers, about half the size of the product tree's operands.
+auto mutils::factorial_prime_swing(int n) -> BigInt
+{
+  if (n < SWING_CUTOFF) { return factorial_product_tree(n); }
+  return factorial_prime_swing(n, prime_table(n));
+}
+
+
+// With primes holding at least the primes up to n, e.g. a cached table
+auto mutils::factorial_prime_swing(int n, const std::vector<int>& primes) -> BigInt
+{
+  if (n < SWING_CUTOFF) { return factorial_product_tree(n); }
+
+  std::vector<int> levels;
+  int m = n;
+  for (; m >= SWING_CUTOFF; m /= 2) { levels.push_back(m); }
+
+  BigInt res = factorial_product_tree(m);
+  for (size_t i = levels.size(); i-- > 0;) {
+    std::vector<unsigned long long> factors = swing_factors(levels[i], primes);
+    res = res * res * product_tree(pack_leaves(0, factors.size(),
+                                               [&factors](size_t j) { return factors[j]; }));
+  }
+  return res;
+}
+
+
+/**
+ * One Karatsuba step on decimal halves, with the three half size products on
+ * their own threads and each given a third of the thread budget, the calling
+ * thread included so no more than `threads` run at once. Operands below
+ * PARALLEL_MULTIPLY_DIGITS go straight to BigInt multiplication.
+ */
+auto mutils::parallel_multiply(const BigInt& lhs, const BigInt& rhs, unsigned int threads) -> BigInt
+{
+  if (threads == 0) { threads = ThreadPool::default_threads(); }
+  if (memory::limited()) { threads = 1; }
+  const size_t lhsDigits = lhs.digit_count();
+  const size_t rhsDigits = rhs.digit_count();
+  if (threads < 2 || std::min(lhsDigits, rhsDigits) < PARALLEL_MULTIPLY_DIGITS) { return lhs * rhs; }
+
+  const bool positive = lhs.is_positive() == rhs.is_positive();
+  const BigInt a = BigInt::abs(lhs);
+  const BigInt b = BigInt::abs(rhs);
+
+  // Split on a limb boundary so the shifts only move whole limbs
+  size_t half = std::max(lhsDigits, rhsDigits) / 2;
+  half -= half % 9;
+
+  BigInt res;
+  if (std::min(lhsDigits, rhsDigits) <= half) {
+    // Unbalanced, split only the longer operand
+    const BigInt& longer = lhsDigits >= rhsDigits ? a : b;
+    const BigInt& shorter = lhsDigits >= rhsDigits ? b : a;
+    BigInt high, low, z0;
+    split_pow10(longer, half, high, low);
+    ThreadGroup group;
+    group.spawn([&] { z0 = parallel_multiply(low, shorter, threads / 2); });
+    res = parallel_multiply(high, shorter, threads - threads / 2);
+    group.join();
+    res.mul_pow10(half);
+    res += z0;
+  } else {
+    BigInt a1, a0, b1, b0, z0, z2;
+    split_pow10(a, half, a1, a0);
+    split_pow10(b, half, b1, b0);
+    // A third of the threads for each product. With two threads z2 follows
+    // the middle product on the calling thread instead of a thread of its own.
+    const unsigned int share = threads / 3;
+    const unsigned int lowShare = std::max(share, 1u);
+    ThreadGroup group;
+    group.spawn([&] { z0 = parallel_multiply(a0, b0, lowShare); });
+    if (share > 0) { group.spawn([&] { z2 = parallel_multiply(a1, b1, share); }); }
+    res = parallel_multiply(a0 + a1, b0 + b1, threads - lowShare - share);
+    if (share == 0) { z2 = a1 * b1; }
+    group.join();
+
+    res -= z0;
+    res -= z2;
+    res.mul_pow10(half);
+    z2.mul_pow10(2 * half);
+    res += z2;
+    res += z0;
+  }
+
+  if (!positive) { res *= -1; }
+  return res;
+}
+
+
+/**
+ * Product tree whose levels run on a thread pool. Near the root there are
+ * fewer pairs than threads, so each pair also gets a share of the threads for
+ * parallel_multiply.
+ */
+auto mutils::parallel_product_tree(std::vector<BigInt> values, unsigned int threads) -> BigInt
+{
+  if (values.empty()) { return BigInt(1); }
+  if (threads == 0) { threads = ThreadPool::default_threads(); }
+  if (memory::limited()) { threads = 1; }
+  if (threads == 1) { return product_tree(std::move(values)); }
+
+  ThreadPool pool(threads);
+  while (values.size() > 1) {
+    const size_t pairs = values.size() / 2;
+    const unsigned int share = std::max(threads / (unsigned int)std::min<size_t>(pairs, threads), 1u);
+    std::vector<BigInt> next(pairs + values.size() % 2);
+    for (size_t i = 0; i < pairs; ++i) {
+      pool.submit([&values, &next, i, share](unsigned int) {
+        next[i] = parallel_multiply(values[2 * i], values[2 * i + 1], share);
+      });
+    }
+    if (values.size() % 2 == 1) { next.back() = std::move(values.back()); }
+    pool.wait();
+    values.swap(next);
+  }
+  return values.front();
+}
+
+
+/**
+ * Product of factor(0) .. factor(count - 1), e.g. a range of integers for a
+ * rising factorial or binomial numerator, or a prime table for a primorial.
+ * The factors are cut into chunks multiplied on worker threads, which are
+ * then combined by parallel_product_tree. factor is called concurrently.
+ */
+auto mutils::parallel_product(size_t count, const std::function<unsigned long long(size_t)>& factor,
+                              unsigned int threads) -> BigInt
+{
+  if (threads == 0) { threads = ThreadPool::default_threads(); }
+  if (memory::limited()) { threads = 1; }
+  if (threads == 1 || count < PARALLEL_PRODUCT_MIN) { return product_tree(pack_leaves(0, count, factor)); }
+
+  // More chunks than threads so uneven chunks even out
+  const size_t chunks = std::min<size_t>(count, 4 * (size_t)threads);
+  std::vector<BigInt> partial(chunks);
+  {
+    ThreadPool pool(threads);
+    for (size_t c = 0; c < chunks; ++c) {
+      pool.submit([&, c](unsigned int) {
+        partial[c] = product_tree(pack_leaves(count * c / chunks, count * (c + 1) / chunks, factor));
+      });
+    }
+    pool.wait();
+  }
+  return parallel_product_tree(std::move(partial), threads);
+}
+
+
+// Product of the integers in [lo, hi] on threads
+auto mutils::parallel_product_range(unsigned long long lo, unsigned long long hi,
+                                    unsigned int threads) -> BigInt
+{
+  if (lo > hi) { return BigInt(1); }
+  if (lo == 0) { return BigInt(0); }
+  return parallel_product((size_t)(hi - lo) + 1, [lo](size_t i) { return lo + i; }, threads);
+}
+
+
+// Prime swing with every swing number from parallel_product and the
+// squarings and products from parallel_multiply
+auto mutils::factorial_parallel(int n, unsigned int threads) -> BigInt
+{
+  if (threads == 0) { threads = ThreadPool::default_threads(); }
+  if (memory::limited()) { threads = 1; }
+  if (n < SWING_CUTOFF || threads == 1) { return factorial_prime_swing(n); }
+
+  const std::vector<int> primes = prime_table(n);
+  std::vector<int> levels;
+  int m = n;
+  for (; m >= SWING_CUTOFF; m /= 2) { levels.push_back(m); }
+
+  BigInt res = factorial_product_tree(m);
+  for (size_t i = levels.size(); i-- > 0;) {
+    std::vector<unsigned long long> factors = swing_factors(levels[i], primes);
+    BigInt swing = parallel_product(factors.size(), [&factors](size_t j) { return factors[j]; }, threads);
+    res = parallel_multiply(parallel_multiply(res, res, threads), swing, threads);
+  }
+  return res;
+}
+
+
+namespace {
+  // Binomials with min(k, n - k) up to this are n(n-1)...(n-k+1) / k!
+  const int BINOMIAL_DIRECT_K = 64;
+  // Lucas' theorem tabulates factorials mod p for primes up to this
+  const unsigned int LUCAS_TABLE_MAX = 1 << 20;
+
+  // Legendre's formula, the exponent of the prime p in n!
+  long long legendre(long long n, long long p)
+  {
+    long long e = 0;
+    while (n > 0) {
+      n /= p;
+      e += n;
+    }
+    return e;
+  }
+
+  // Product of p^exponent(p) over the primes up to n
+  BigInt prime_power_product(int n, const std::function<long long(int)>& exponent)
+  {
+    std::vector<unsigned long long> factors;
+    for (int p : mutils::prime_table(n)) {
+      for (long long e = exponent(p); e > 0; --e) { factors.push_back((unsigned long long)p); }
+    }
+    return mutils::product_tree(pack_leaves(0, factors.size(),
+                                            [&factors](size_t i) { return factors[i]; }));
+  }
+
+  auto pow_mod(unsigned long long base, unsigned long long exp, unsigned long long mod) -> unsigned long long
+  {
+    unsigned long long res = 1 % mod;
+    base %= mod;
+    for (; exp > 0; exp >>= 1) {
+      if (exp & 1) { res = res * base % mod; }
+      base = base * base % mod;
+    }
+    return res;
+  }
+}
+
+
+/**
+ * Binomial coefficient C(n, k), 0 outside 0 <= k <= n.
+ *
+ * By Kummer's theorem the exponent of p in C(n, k) is the number of carries
+ * when adding k and n - k in base p, which Legendre's formula counts as
+ * e(n) - e(k) - e(n - k). Every prime power is at most n, so the product is
+ * one product tree over small factors and needs no division. Small k skips
+ * the sieve and divides the falling factorial by k! instead.
+ */
+auto mutils::binomial(int n, int k) -> BigInt
+{
+  if (n < 0 || k < 0 || k > n) { return BigInt(0); }
+  k = std::min(k, n - k);
+  if (k == 0) { return BigInt(1); }
+
+  if (k <= BINOMIAL_DIRECT_K) {
+    BigInt res, rem;
+    BigInt::divmod(product_range((unsigned long long)(n - k) + 1, (unsigned long long)n),
+                   factorial_product_tree(k), res, rem);
+    return res;
+  }
+
+  return prime_power_product(n, [n, k](int p) {
+    return legendre(n, p) - legendre(k, p) - legendre(n - k, p);
+  });
+}
+
+
+// Multinomial coefficient (k1 + ... + km)! / (k1! ... km!), 0 if any ki < 0
+auto mutils::multinomial(const std::vector<int>& ks) -> BigInt
+{
+  long long total = 0;
+  for (int k : ks) {
+    if (k < 0) { return BigInt(0); }
+    total += k;
+  }
+  if (total > std::numeric_limits<int>::max()) { return BigInt(0); }
+
+  const int n = (int)total;
+  return prime_power_product(n, [n, &ks](int p) {
+    long long e = legendre(n, p);
+    for (int k : ks) { e -= legendre(k, p); }
+    return e;
+  });
+}
+
+
+// Catalan number C(2n, n) / (n + 1), the n + 1 taken off the exponents
+auto mutils::catalan(int n) -> BigInt
+{
+  if (n < 0 || n > std::numeric_limits<int>::max() / 2) { return BigInt(0); }
+  if (n < 2) { return BigInt(1); }
+
+  return prime_power_product(2 * n, [n](int p) {
+    long long e = legendre(2LL * n, p) - 2 * legendre(n, p);
+    for (long long m = (long long)n + 1; m % p == 0; m /= p) { --e; }
+    return e;
+  });
+}
+
+
+// lcm(1, ..., n), the product of the largest power of every prime up to n
+auto mutils::lcm_upto(int n) -> BigInt
+{
+  if (n < 2) { return BigInt(1); }
+  return prime_power_product(n, [n](int p) {
+    long long e = 0;
+    for (long long power = p; power <= n; power *= p) { ++e; }
+    return e;
+  });
+}
+
+
+// Row n of Pascal's triangle from C(n, k + 1) = C(n, k) (n - k) / (k + 1),
+// one single limb multiplication and division per entry, mirrored after the
+// middle
+auto mutils::pascal_row(int n) -> std::vector<BigInt>
+{
+  if (n < 0) { return std::vector<BigInt>(); }
+
+  std::vector<BigInt> row((size_t)n + 1);
+  row[0] = BigInt(1);
+  BigInt rem;
+  for (int k = 0; k < n / 2; ++k) {
+    BigInt& entry = row[(size_t)k + 1];
+    entry = row[(size_t)k] * BigInt(n - k);
+    BigInt::divmod(entry, BigInt(k + 1), entry, rem);
+  }
+  for (int k = n / 2 + 1; k <= n; ++k) { row[(size_t)k] = row[(size_t)(n - k)]; }
+  return row;
+}
+
+
+/**
+ * C(n, k) mod p for a prime p by Lucas' theorem: the product over the base p
+ * digits of C(n_i, k_i) mod p. The digit binomials come from a running
+ * product with one Fermat inverse per digit, or from a factorial table when p
+ * is at most LUCAS_TABLE_MAX and the products would take more than the p
+ * steps of filling it. 0 when p is not prime.
+ */
+auto mutils::binomial_mod(long long n, long long k, unsigned int p) -> unsigned int
+{
+  if (p < 2 || n < 0 || k < 0 || k > n || !is_prime_u64(p)) { return 0; }
+  const unsigned long long mod = p;
+
+  unsigned long long steps = 0;
+  for (long long nd = n, kd = k; kd > 0; nd /= (long long)p, kd /= (long long)p) {
+    const unsigned long long ni = (unsigned long long)(nd % (long long)p);
+    const unsigned long long ki = (unsigned long long)(kd % (long long)p);
+    if (ki <= ni) { steps += std::min(ki, ni - ki); }
+  }
+
+  std::vector<unsigned int> fact;
+  if (p <= LUCAS_TABLE_MAX && steps > mod) {
+    fact.resize(p);
+    fact[0] = 1;
+    for (unsigned int i = 1; i < p; ++i) { fact[i] = (unsigned int)(fact[i - 1] * (unsigned long long)i % mod); }
+  }
+
+  unsigned long long res = 1 % mod;
+  for (; k > 0 && res != 0; n /= (long long)p, k /= (long long)p) {
+    const unsigned long long ni = (unsigned long long)(n % (long long)p);
+    unsigned long long ki = (unsigned long long)(k % (long long)p);
+    if (ki > ni) { return 0; }
+
+    unsigned long long num = 1, den = 1;
+    if (!fact.empty()) {
+      num = fact[ni];
+      den = (unsigned long long)fact[ki] * fact[ni - ki] % mod;
+    } else {
+      ki = std::min(ki, ni - ki);
+      for (unsigned long long j = 0; j < ki; ++j) {
+        num = num * (ni - j) % mod;
+        den = den * (j + 1) % mod;
+      }
+    }
+    res = res * num % mod * pow_mod(den, mod - 2, mod) % mod;
+  }
+  return (unsigned int)res;
+}
+
+
+// Negative n gives 0. n past INT_MAX, whose factorial would not fit in
+// memory anyway, gives a domain error.
+auto mutils::factorial(BigInt n) -> BigInt
+{
+  if (!n.is_positive()) { return BigInt(0); }
+  if (!n.is_valid() || BigInt(INT_MAX) < n) { return BigInt::domain_error(); }
 
-  return n * factorial(n - 1);
+  const BigInt::Limbs& limbs = n.limbs();
+  long long value = limbs[0];
+  if (limbs.size() > 1) { value += (long long)limbs[1] * 1000000000; }
+  return factorial_prime_swing((int)value);
 }
 
 
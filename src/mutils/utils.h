@@ -1,27 +1,93 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <tuple>
+#include <utility>
 #include <set>
 #include <iomanip>
 #include <limits>
 #include <unistd.h>
 
 #include "bigint.h"
+#include "diophantine.h"
+#include "hermite.h"
+#include "memory.h"
+#include "output.h"
+#include "partition_generator.h"
+#include "prime_generator.h"
+#include "thread_pool.h"
 
 namespace mutils {
+  // partitions_count uses the Rademacher series from here on
+  const int PARTITIONS_HRR_FROM = 2000;
+
   void sieve_of_eratosthenes(int n, std::set<int>& primes, bool verbose);
   void linear_diophantine(int a, int b, int c);
-  auto partitions(int n) -> int;
+  auto partitions(int n) -> unsigned long long;
+  auto partitions_count(int n) -> BigInt;
+  auto partitions_table(int n) -> std::vector<BigInt>;
+  void partitions_table_extend(std::vector<BigInt>& p, int n);
+  auto partitions_tasks(int n, unsigned int workers) -> std::vector<std::vector<int>>;
+  auto partitions_parallel_count(int n, unsigned int threads = 0) -> unsigned long long;
+  auto partitions_hrr(int n, unsigned int threads = 0) -> BigInt;
+  auto verify_partitions_hrr(int n, unsigned int threads = 0) -> int;
   auto partitions_bell(int n) -> BigInt;
+  auto bell(int n) -> BigInt;
+  auto bell_numbers(int n) -> std::vector<BigInt>;
+  void bell_numbers_extend(std::vector<BigInt>& bells, std::vector<BigInt>& row, int n);
+  auto bell_parallel(int n, unsigned int threads = 0) -> BigInt;
+  auto bell_numbers_parallel(int n, unsigned int threads = 0) -> std::vector<BigInt>;
+  auto stirling2(int n, int k) -> BigInt;
+  auto stirling2_row(int n, unsigned int threads = 0) -> std::vector<BigInt>;
+  void stirling2_row_extend(std::vector<BigInt>& row, int n, unsigned int threads = 0);
+  void stirling2_columns_extend(std::vector<BigInt>& columns, int m, int n);
   void divisors(int n, std::vector<int>& divisors);
-  auto gcd(int m, int n, bool verbose) -> int;
-  auto lcm(int m, int n, bool verbose) -> int;
+  auto gcd(int m, int n, bool verbose) -> long long;
+  auto binary_gcd(unsigned long long a, unsigned long long b) -> unsigned long long;
+  auto lehmer_gcd(const BigInt& m, const BigInt& n) -> BigInt;
+  auto extended_lehmer_gcd(const BigInt& m, const BigInt& n) -> std::tuple<BigInt, BigInt, BigInt>;
+  auto batch_gcd(const std::vector<BigInt>& values, unsigned int threads = 0) -> std::vector<BigInt>;
+  auto batch_gcd(const std::vector<unsigned long long>& values, unsigned int threads = 0)
+    -> std::vector<unsigned long long>;
+  auto lcm(int m, int n, bool verbose) -> long long;
+  auto gcd_of(const long long* values, size_t count) -> unsigned long long;
+  auto gcd_of(const std::vector<int>& values) -> unsigned long long;
+  auto lcm_of(const long long* values, size_t count) -> BigInt;
+  auto lcm_of(const std::vector<int>& values) -> BigInt;
+  auto lcm_upto(int n) -> BigInt;
+  bool crt(const std::pair<long long, long long>* congruences, size_t count,
+           BigInt& solution, BigInt& modulus);
+  bool crt(const std::vector<std::pair<long long, long long>>& congruences,
+           BigInt& solution, BigInt& modulus);
+  auto mod_inverses(const std::vector<unsigned long long>& values, unsigned long long modulus)
+    -> std::vector<unsigned long long>;
+  auto mod_inverses(const std::vector<BigInt>& values, const BigInt& modulus) -> std::vector<BigInt>;
   void prime_factors(int n, std::vector<int>& primeFactors);
+  auto prime_factors(unsigned long long n) -> std::vector<unsigned long long>;
   auto factorial(BigInt n) -> BigInt;
+  auto factorial_product_tree(int n) -> BigInt;
+  auto factorial_prime_swing(int n) -> BigInt;
+  auto factorial_prime_swing(int n, const std::vector<int>& primes) -> BigInt;
+  auto product_range(unsigned long long lo, unsigned long long hi) -> BigInt;
+  auto product_tree(std::vector<BigInt> values) -> BigInt;
+  auto parallel_multiply(const BigInt& lhs, const BigInt& rhs, unsigned int threads = 0) -> BigInt;
+  auto parallel_product_tree(std::vector<BigInt> values, unsigned int threads = 0) -> BigInt;
+  auto parallel_product(size_t count, const std::function<unsigned long long(size_t)>& factor,
+                        unsigned int threads = 0) -> BigInt;
+  auto parallel_product_range(unsigned long long lo, unsigned long long hi,
+                              unsigned int threads = 0) -> BigInt;
+  auto factorial_parallel(int n, unsigned int threads = 0) -> BigInt;
+  auto prime_table(int n) -> std::vector<int>;
+  auto binomial(int n, int k) -> BigInt;
+  auto multinomial(const std::vector<int>& ks) -> BigInt;
+  auto catalan(int n) -> BigInt;
+  auto pascal_row(int n) -> std::vector<BigInt>;
+  // C(n, k) mod p, p must be prime (0 otherwise)
+  auto binomial_mod(long long n, long long k, unsigned int p) -> unsigned int;
 
   auto extended_gcd(int m, int n) -> std::tuple<int, int>;
   bool is_string_ints(const std::string& str);
@@ -36,44 +102,58 @@ namespace mutils {
     void print_set_by_column(const std::set<T>& set, int width,
                              int columns = 10, bool ignoreZero = false)
     {
-      int i = 0;
-      for (const auto& val : set) {
-        if (i != 0 && columns > 0 && i % columns == 0) {
-          std::cout << std::endl;
-        }
-        if (ignoreZero && val == 0) {
-          continue;
-        }
-        if (width == 0) {
-          std::cout << val << " ";
-        } else {
-          std::cout << std::setw(width) << val;
-        }
-        ++i;
-      }
-      std::cout << std::endl;
+      ColumnWriter writer(OutputSink::standard(), width, columns, ignoreZero);
+      for (const auto& val : set) { writer.add(val); }
+      writer.finish();
     }
 
   template<typename T>
     void print_vector_by_column(const std::vector<T>& vec, int width,
                                 int columns = 10, bool ignoreZero = false)
     {
-      int i = 0;
-      for (const auto& val : vec) {
-        if (i != 0 && columns > 0 && i % columns == 0) {
-          std::cout << std::endl;
-        }
-        if (ignoreZero && val == 0) {
-          continue;
-        }
-        if (width == 0) {
-          std::cout << val << " ";
-        } else {
-          std::cout << std::setw(width) << val;
-        }
-        ++i;
+      ColumnWriter writer(OutputSink::standard(), width, columns, ignoreZero);
+      for (const auto& val : vec) { writer.add(val); }
+      writer.finish();
+    }
+
+  // Streams the primes up to n in columns without storing them
+  void print_primes_by_column(int n, int width, int columns = 10);
+
+  // Visits every partition of n on a work-stealing pool of threads (0 for all
+  // cores), split into tasks by partitions_tasks. Each task folds its
+  // partitions into a fresh copy of init with visit(state, parts, size) and is
+  // merged into its worker's state with merge(into, from), the worker states
+  // are merged into the result at the end. init must be the identity of merge.
+  // One thread, or a memory::Scope with a budget, visits them all on the
+  // calling thread.
+  template<typename State, typename Visit, typename Merge>
+    State partitions_parallel(int n, const State& init, Visit visit, Merge merge,
+                              unsigned int threads = 0)
+    {
+      if (memory::limited()) { threads = 1; }
+      if (threads == 1) {
+        PartitionGenerator gen(n);
+        State result(init);
+        while (gen.next()) { visit(result, gen.data(), gen.size()); }
+        return result;
       }
-      std::cout << std::endl;
+
+      ThreadPool pool(threads);
+      std::vector<State> states(pool.size(), init);
+
+      for (const auto& prefix : partitions_tasks(n, pool.size())) {
+        pool.submit([&, prefix](unsigned int worker) {
+          PartitionGenerator gen(n, prefix);
+          State local(init);
+          while (gen.next()) { visit(local, gen.data(), gen.size()); }
+          merge(states[worker], local);
+        });
+      }
+      pool.wait();
+
+      State result(init);
+      for (const auto& state : states) { merge(result, state); }
+      return result;
     }
 
   template<typename T>
@@ -110,13 +190,16 @@ namespace mutils {
       return prod;
     }
 
+  // Buffered in OutputSink::standard(), flush it before writing to stdout
+  // any other way
   template<typename T>
     void print_array(T p[], int n)
     {
+      OutputSink& sink = OutputSink::standard();
       for (int i = 0; i < n; i++) {
-        std::cout << p[i] << " ";
+        sink.number(p[i]).put(' ');
       }
-      std::cout << std::endl;
+      sink.put('\n');
     }
 }
 